@@ -4,5 +4,5 @@
 
 USER_OBJS :=
 
-LIBS := -lSDL -lGLU
+LIBS := -lSDL -lGL -lGLU -lm -lz
 
@@ -4,19 +4,73 @@
 
 # Add inputs and outputs from these tool invocations to the build variables 
 C_SRCS += \
+../collision.c \
 ../main.c \
+../renderer_anim.c \
+../renderer_batch.c \
+../renderer_materials.c \
 ../renderer_model_ASE.c \
-../system_files.c 
+../renderer_particles.c \
+../renderer_profile.c \
+../renderer_queue.c \
+../renderer_sky.c \
+../renderer_terrain.c \
+../renderer_textures.c \
+../system_files.c \
+../system_hotreload.c \
+../system_jobs.c \
+../system_memory.c \
+../system_pack.c \
+../system_replay.c \
+../system_sync.c \
+../vmath.c \
+../world.c 
 
 OBJS += \
+./collision.o \
 ./main.o \
+./renderer_anim.o \
+./renderer_batch.o \
+./renderer_materials.o \
 ./renderer_model_ASE.o \
-./system_files.o 
+./renderer_particles.o \
+./renderer_profile.o \
+./renderer_queue.o \
+./renderer_sky.o \
+./renderer_terrain.o \
+./renderer_textures.o \
+./system_files.o \
+./system_hotreload.o \
+./system_jobs.o \
+./system_memory.o \
+./system_pack.o \
+./system_replay.o \
+./system_sync.o \
+./vmath.o \
+./world.o 
 
 C_DEPS += \
+./collision.d \
 ./main.d \
+./renderer_anim.d \
+./renderer_batch.d \
+./renderer_materials.d \
 ./renderer_model_ASE.d \
-./system_files.d 
+./renderer_particles.d \
+./renderer_profile.d \
+./renderer_queue.d \
+./renderer_sky.d \
+./renderer_terrain.d \
+./renderer_textures.d \
+./system_files.d \
+./system_hotreload.d \
+./system_jobs.d \
+./system_memory.d \
+./system_pack.d \
+./system_replay.d \
+./system_sync.d \
+./vmath.d \
+./world.d 
 
 
 # Each subdirectory must supply rules for building sources it contributes
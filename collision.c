@@ -0,0 +1,760 @@
+/*
+===========================================================================
+File:		collision.c
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+Description:	Swept box collision against a static set of triangles.
+				A sweep moves an axis aligned box along a segment and
+				returns the time of impact with the first triangle in
+				its way, so a fast move can't step over a thin surface
+				the way testing only the end position does.
+
+				The narrow phase is the separating axis test: the box
+				and a triangle are projected onto the box axes, the
+				triangle normal and the nine edge cross products, and
+				each axis gives the interval of the move during which
+				their projections overlap. They touch when all of those
+				intervals do, from the latest entry onwards.
+
+				Triangles are binned into a uniform grid over X and Z,
+				at most COLLISION_GRID_MAX cells a side, so a sweep only
+				tests the triangles near the cells its path covers.
+				Owned by the simulation thread.
+===========================================================================
+*/
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "collision.h"
+#include "system_memory.h"
+
+#define COLLISION_GRID_MAX	32
+#define COLLISION_MIN_CELL	4.0f
+
+//A hit stops the box this far short of the surface, measured along the
+//normal, so the next sweep starts clear of it instead of just inside
+#define COLLISION_EPSILON	(1.0f / 32.0f)
+
+typedef struct
+{
+	vec3_t			verts[3];
+	vec3_t			mins, maxs;
+	int				surface;
+	unsigned int	stamp;			//last sweep that tested it
+}
+collision_tri_t;
+
+static collision_tri_t	*triList = NULL;
+static int				numTris = 0, trisAllocated = 0;
+
+//Cell (x, z) holds cellTris[cellStart[c]] .. cellTris[cellStart[c+1]-1],
+//where c = z * gridW + x
+static int				gridW = 0, gridH = 0;
+static float			gridOrigin[2], gridCell = 1.0f;
+static int				*cellStart = NULL, *cellTris = NULL;
+static unsigned int		sweepStamp = 0;
+
+static unsigned int		statSweeps = 0, statHits = 0;
+static double			statTested = 0;
+
+static const vec3_t		boxAxes[3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+
+/*
+ * collision_clear
+ * Forgets every triangle. Sweeps hit nothing until the next collision_build.
+ */
+void collision_clear()
+{
+	numTris = 0;
+	gridW = gridH = 0;
+}
+
+/*
+ * collision_addTriangle
+ * surface is handed back in the trace of a sweep that hits this triangle.
+ */
+void collision_addTriangle(const vec3_t a, const vec3_t b, const vec3_t c, int surface)
+{
+	collision_tri_t	*tri;
+	int				i;
+
+	if(numTris >= trisAllocated)
+	{
+		trisAllocated = trisAllocated ? trisAllocated * 2 : 16;
+		triList = (collision_tri_t *)memory_realloc(MEMORY_TAG_COLLISION, triList, sizeof(collision_tri_t) * trisAllocated);
+	}
+
+	tri = &triList[numTris++];
+	VectorCopy(a, tri->verts[0]);
+	VectorCopy(b, tri->verts[1]);
+	VectorCopy(c, tri->verts[2]);
+	tri->surface = surface;
+	tri->stamp	 = 0;
+
+	for(i = 0; i < 3; i++)
+	{
+		tri->mins[i] = fminf(a[i], fminf(b[i], c[i]));
+		tri->maxs[i] = fmaxf(a[i], fmaxf(b[i], c[i]));
+	}
+}
+
+/*
+ * collision_addQuad
+ * Same winding as renderer_batch_addQuad.
+ */
+void collision_addQuad(vec3_t verts[4], int surface)
+{
+	collision_addTriangle(verts[0], verts[1], verts[2], surface);
+	collision_addTriangle(verts[0], verts[2], verts[3], surface);
+}
+
+/*
+ * collision_cellRange
+ * Grid cells overlapped by the X/Z extent of mins/maxs, clamped to the
+ * grid. Returns efalse if the extent misses the grid entirely.
+ */
+static eboolean collision_cellRange(const vec3_t mins, const vec3_t maxs, int *x0, int *z0, int *x1, int *z1)
+{
+	float	fx0 = (mins[_X] - gridOrigin[0]) / gridCell, fx1 = (maxs[_X] - gridOrigin[0]) / gridCell;
+	float	fz0 = (mins[_Z] - gridOrigin[1]) / gridCell, fz1 = (maxs[_Z] - gridOrigin[1]) / gridCell;
+
+	if(fx1 < 0 || fz1 < 0 || fx0 >= gridW || fz0 >= gridH)
+		return efalse;
+
+	*x0 = fx0 < 0 ? 0 : (int)fx0;
+	*z0 = fz0 < 0 ? 0 : (int)fz0;
+	*x1 = fx1 >= gridW ? gridW - 1 : (int)fx1;
+	*z1 = fz1 >= gridH ? gridH - 1 : (int)fz1;
+
+	return etrue;
+}
+
+/*
+ * collision_build
+ * Bins the triangles into the grid. Call after adding them, before sweeping.
+ */
+void collision_build()
+{
+	vec3_t	mins, maxs;
+	float	extentX, extentZ;
+	int		i, x, z, x0, z0, x1, z1, numCells;
+	int		*cursor;
+
+	gridW = gridH = 0;
+
+	if(numTris == 0)
+		return;
+
+	VectorCopy(triList[0].mins, mins);
+	VectorCopy(triList[0].maxs, maxs);
+
+	for(i = 1; i < numTris; i++)
+	{
+		mins[_X] = fminf(mins[_X], triList[i].mins[_X]);
+		mins[_Z] = fminf(mins[_Z], triList[i].mins[_Z]);
+		maxs[_X] = fmaxf(maxs[_X], triList[i].maxs[_X]);
+		maxs[_Z] = fmaxf(maxs[_Z], triList[i].maxs[_Z]);
+	}
+
+	extentX = maxs[_X] - mins[_X];
+	extentZ = maxs[_Z] - mins[_Z];
+
+	gridCell = fmaxf(extentX, extentZ) / COLLISION_GRID_MAX;
+	if(gridCell < COLLISION_MIN_CELL)
+		gridCell = COLLISION_MIN_CELL;
+
+	gridOrigin[0] = mins[_X];
+	gridOrigin[1] = mins[_Z];
+	gridW = (int)(extentX / gridCell) + 1;
+	gridH = (int)(extentZ / gridCell) + 1;
+	if(gridW > COLLISION_GRID_MAX) gridW = COLLISION_GRID_MAX;
+	if(gridH > COLLISION_GRID_MAX) gridH = COLLISION_GRID_MAX;
+	numCells = gridW * gridH;
+
+	//Count, prefix sum, then fill, so the cells share one flat list
+	memory_free(cellStart);
+	cellStart = (int *)memory_calloc(MEMORY_TAG_COLLISION, numCells + 1, sizeof(int));
+
+	for(i = 0; i < numTris; i++)
+	{
+		collision_cellRange(triList[i].mins, triList[i].maxs, &x0, &z0, &x1, &z1);
+
+		for(z = z0; z <= z1; z++)
+			for(x = x0; x <= x1; x++)
+				cellStart[z * gridW + x + 1]++;
+	}
+
+	for(i = 0; i < numCells; i++)
+		cellStart[i + 1] += cellStart[i];
+
+	memory_free(cellTris);
+	cellTris = (int *)memory_alloc(MEMORY_TAG_COLLISION, sizeof(int) * (cellStart[numCells] ? cellStart[numCells] : 1));
+	cursor	 = (int *)memory_alloc(MEMORY_TAG_COLLISION, sizeof(int) * numCells);
+	memcpy(cursor, cellStart, sizeof(int) * numCells);
+
+	for(i = 0; i < numTris; i++)
+	{
+		collision_cellRange(triList[i].mins, triList[i].maxs, &x0, &z0, &x1, &z1);
+
+		for(z = z0; z <= z1; z++)
+			for(x = x0; x <= x1; x++)
+				cellTris[cursor[z * gridW + x]++] = i;
+	}
+
+	memory_free(cursor);
+}
+
+/*
+ * collision_testAxis
+ * Narrows [first, last], the part of the move during which the box and
+ * triangle overlap, to what the projections onto axis allow. The box is
+ * centred on the origin and v holds the triangle relative to it. Returns
+ * efalse once the interval is empty or starts after the move ends.
+ */
+static eboolean collision_testAxis(const vec3_t axis, const vec3_t half, vec3_t v[3], const vec3_t delta,
+		float *first, float *last, vec3_t normal)
+{
+	float	r, p, triMin, triMax, speed, enter, leave;
+	int		i;
+
+	r = half[0] * fabsf(axis[0]) + half[1] * fabsf(axis[1]) + half[2] * fabsf(axis[2]);
+
+	triMin = triMax = vec3_dot(v[0], axis);
+	for(i = 1; i < 3; i++)
+	{
+		p = vec3_dot(v[i], axis);
+		triMin = fminf(triMin, p);
+		triMax = fmaxf(triMax, p);
+	}
+
+	speed = vec3_dot(delta, axis);
+
+	//Touching counts as apart, so a box resting on a surface can leave it
+	if(triMin >= r)
+	{
+		if(speed <= 0)
+			return efalse;
+
+		enter = (triMin - r) / speed;
+		leave = (triMax + r) / speed;
+	}
+	else if(triMax <= -r)
+	{
+		if(speed >= 0)
+			return efalse;
+
+		enter = (triMax + r) / speed;
+		leave = (triMin - r) / speed;
+	}
+	else
+	{
+		//Already overlapping on this axis, so it only limits the exit
+		if(speed == 0)
+			return etrue;
+
+		enter = -FLT_MAX;
+		leave = speed > 0 ? (triMax + r) / speed : (triMin - r) / speed;
+	}
+
+	if(enter > *first)
+	{
+		*first = enter;
+		vec3_scale(axis, speed > 0 ? -1.0f : 1.0f, normal);
+	}
+
+	if(leave < *last)
+		*last = leave;
+
+	return *first <= *last && *first <= 1.0f;
+}
+
+/*
+ * collision_sweepTriangle
+ * Returns etrue if a box with half extents half, centred on center and
+ * moving by delta, touches tri during the move. toi is the fraction of the
+ * move made first, 0 with startSolid set if they already overlap.
+ */
+static eboolean collision_sweepTriangle(const collision_tri_t *tri, const vec3_t center, const vec3_t half,
+		const vec3_t delta, float *toi, vec3_t normal, eboolean *startSolid)
+{
+	vec3_t	v[3], edges[3], axis;
+	float	first = -FLT_MAX, last = FLT_MAX;
+	int		i;
+
+	for(i = 0; i < 3; i++)
+		VectorSubtract(center, tri->verts[i], v[i]);
+	for(i = 0; i < 3; i++)
+		VectorSubtract(v[i], v[(i + 1) % 3], edges[i]);
+
+	VectorClear(normal);
+
+	//Box faces, the triangle's plane, then each box axis crossed with each
+	//edge. A cross product of parallel directions is no axis at all.
+	for(i = 0; i < 13; i++)
+	{
+		if(i < 3)
+		{
+			VectorCopy(boxAxes[i], axis);
+		}
+		else if(i == 3)
+			vec3_cross(edges[0], edges[1], axis);
+		else
+			vec3_cross(boxAxes[(i - 4) / 3], edges[(i - 4) % 3], axis);
+
+		if(i >= 3 && vec3_normalize(axis, axis) < 1e-6f)
+			continue;
+
+		if(!collision_testAxis(axis, half, v, delta, &first, &last, normal))
+			return efalse;
+	}
+
+	if(first < 0)
+	{
+		*toi		= 0;
+		*startSolid	= etrue;
+		VectorClear(normal);
+	}
+	else
+	{
+		*toi		= first;
+		*startSolid	= efalse;
+	}
+
+	return etrue;
+}
+
+/*
+ * collision_traceTriangle
+ * Keeps tri in trace if the box touches it before anything found so far.
+ */
+static void collision_traceTriangle(const collision_tri_t *tri, const vec3_t center, const vec3_t half,
+		const vec3_t delta, float *best, collision_trace_t *trace)
+{
+	vec3_t		normal;
+	float		toi;
+	eboolean	solid;
+
+	if(!collision_sweepTriangle(tri, center, half, delta, &toi, normal, &solid) || toi >= *best)
+		return;
+
+	*best				= toi;
+	trace->fraction		= toi;
+	trace->surface		= tri->surface;
+	trace->startSolid	= solid;
+	VectorCopy(normal, trace->normal);
+}
+
+/*
+ * collision_finishTrace
+ * Backs a hit off the surface and fills in where the box stopped.
+ */
+static void collision_finishTrace(const vec3_t start, const vec3_t delta, collision_trace_t *trace)
+{
+	float	toi, along;
+	int		i;
+
+	if(trace->surface < 0)
+	{
+		for(i = 0; i < 3; i++)
+			trace->end[i] = start[i] + trace->fraction * delta[i];
+		return;
+	}
+
+	statHits++;
+	toi = trace->fraction;
+
+	//Stepped off the point of contact along the normal, not back along the
+	//move: a glancing hit would end up closer than COLLISION_EPSILON, and a
+	//box that started the move closer than that could not back off at all,
+	//so where it came to rest would depend on its speed
+	for(i = 0; i < 3; i++)
+		trace->end[i] = start[i] + toi * delta[i] + COLLISION_EPSILON * trace->normal[i];
+
+	along = -vec3_dot(delta, trace->normal);
+	if(along > 0)
+		trace->fraction = fmaxf(0.0f, toi - COLLISION_EPSILON / along);
+}
+
+/*
+ * collision_sweep
+ * Moves a box with the given extents (relative to its origin) from start
+ * towards end, stopping just short of the first triangle in the way.
+ */
+void collision_sweep(const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs, collision_trace_t *trace)
+{
+	collision_tri_t	*tri;
+	vec3_t			delta, center, half, pathMins, pathMaxs;
+	float			best;
+	int				i, j, x, z, x0, z0, x1, z1;
+
+	VectorSubtract(start, end, delta);
+
+	trace->fraction		= 1.0f;
+	trace->surface		= -1;
+	trace->startSolid	= efalse;
+	VectorClear(trace->normal);
+
+	for(i = 0; i < 3; i++)
+	{
+		half[i]		= 0.5f * (maxs[i] - mins[i]);
+		center[i]	= start[i] + 0.5f * (maxs[i] + mins[i]);
+		pathMins[i]	= fminf(start[i], end[i]) + mins[i];
+		pathMaxs[i]	= fmaxf(start[i], end[i]) + maxs[i];
+	}
+
+	statSweeps++;
+
+	//Above any time of impact, so a box that ends up just touching still hits
+	best = 2.0f;
+
+	if(gridW == 0 || !collision_cellRange(pathMins, pathMaxs, &x0, &z0, &x1, &z1))
+	{
+		VectorCopy(end, trace->end);
+		return;
+	}
+
+	//A triangle spanning several cells is only tested once per sweep
+	if(++sweepStamp == 0)
+	{
+		for(i = 0; i < numTris; i++)
+			triList[i].stamp = 0;
+		sweepStamp = 1;
+	}
+
+	for(z = z0; z <= z1; z++)
+		for(x = x0; x <= x1; x++)
+			for(j = cellStart[z * gridW + x]; j < cellStart[z * gridW + x + 1]; j++)
+			{
+				tri = &triList[cellTris[j]];
+
+				if(tri->stamp == sweepStamp)
+					continue;
+				tri->stamp = sweepStamp;
+
+				if(tri->mins[_X] > pathMaxs[_X] || tri->maxs[_X] < pathMins[_X] ||
+				   tri->mins[_Y] > pathMaxs[_Y] || tri->maxs[_Y] < pathMins[_Y] ||
+				   tri->mins[_Z] > pathMaxs[_Z] || tri->maxs[_Z] < pathMins[_Z])
+					continue;
+
+				statTested++;
+				collision_traceTriangle(tri, center, half, delta, &best, trace);
+			}
+
+	collision_finishTrace(start, delta, trace);
+}
+
+/*
+ * collision_printStats
+ */
+void collision_printStats()
+{
+	if(statSweeps == 0)
+		return;
+
+	printf("Collision: %d triangles in a %dx%d grid, %u sweeps, %.2f triangles tested per sweep, %u hits.\n",
+			numTris, gridW, gridH, statSweeps, statTested / statSweeps, statHits);
+}
+
+/*
+===========================================================================
+	-collisiontest
+===========================================================================
+*/
+
+#define TEST_SPEEDS			48
+#define TEST_RANDOM_TRIS	2000
+#define TEST_RANDOM_SWEEPS	2000
+#define TEST_OVERLAP_MOVES	1000
+#define TEST_OVERLAP_STEPS	200
+#define TEST_OVERLAP_SPLITS	30
+
+//Further than any point of the triangle is from a sample of it, plus how
+//far the box moves between time samples, see collision_testOverlap
+#define TEST_OVERLAP_MARGIN	0.2f
+
+static unsigned int testSeed = 2463534242u;
+
+//xorshift, so every run tests the same cases
+static float collision_random(float lo, float hi)
+{
+	testSeed ^= testSeed << 13;
+	testSeed ^= testSeed >> 17;
+	testSeed ^= testSeed << 5;
+
+	return lo + (hi - lo) * (testSeed / 4294967296.0f);
+}
+
+/*
+ * collision_sweepAll
+ * collision_sweep without the grid, every triangle is tested.
+ */
+static void collision_sweepAll(const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs, collision_trace_t *trace)
+{
+	vec3_t	delta, center, half;
+	float	best = 2.0f;
+	int		i;
+
+	VectorSubtract(start, end, delta);
+
+	trace->fraction		= 1.0f;
+	trace->surface		= -1;
+	trace->startSolid	= efalse;
+	VectorClear(trace->normal);
+
+	for(i = 0; i < 3; i++)
+	{
+		half[i]		= 0.5f * (maxs[i] - mins[i]);
+		center[i]	= start[i] + 0.5f * (maxs[i] + mins[i]);
+	}
+
+	for(i = 0; i < numTris; i++)
+		collision_traceTriangle(&triList[i], center, half, delta, &best, trace);
+
+	collision_finishTrace(start, delta, trace);
+}
+
+/*
+ * collision_testFall
+ * Drops the player's box onto a floor at every speed from 0.05 to 1000
+ * units a tick, once on the floor's diagonal edge and once inside a
+ * triangle. Each drop has to come to rest at the same height, one
+ * COLLISION_EPSILON above the floor, and stay there on the next tick.
+ */
+static int collision_testFall()
+{
+	static const vec3_t	mins = {-0.25f, -1.0f, -0.25f}, maxs = {0.25f, 0.25f, 0.25f};
+	static const float	spots[2][2] = {{0.0f, 0.0f}, {3.0f, -7.0f}};
+
+	vec3_t				floor[4] = {{-10, 0, -10}, {-10, 0, 10}, {10, 0, 10}, {10, 0, -10}};
+	vec3_t				pos, end;
+	collision_trace_t	trace;
+	float				speed, want, worst = 0.0f;
+	int					i, s, ticks, failed = 0;
+
+	collision_clear();
+	collision_addQuad(floor, 0);
+	collision_build();
+
+	want = -mins[_Y] + COLLISION_EPSILON;
+
+	for(s = 0; s < 2; s++)
+		for(i = 0; i <= TEST_SPEEDS; i++)
+		{
+			speed = 0.05f * powf(20000.0f, (float)i / TEST_SPEEDS);
+			pos[_X] = spots[s][0];
+			pos[_Y] = 10.0f;
+			pos[_Z] = spots[s][1];
+
+			for(ticks = 0; pos[_Y] > -2000.0f; ticks++)
+			{
+				VectorCopy(pos, end);
+				end[_Y] -= speed;
+				collision_sweep(pos, end, mins, maxs, &trace);
+				VectorCopy(trace.end, pos);
+
+				if(trace.surface >= 0)
+					break;
+			}
+
+			worst = fmaxf(worst, fabsf(pos[_Y] - want));
+
+			//The resting box must be clear of the floor, not inside it
+			VectorCopy(pos, end);
+			end[_Y] -= speed;
+			collision_sweep(pos, end, mins, maxs, &trace);
+
+			if(fabsf(pos[_Y] - want) > 1e-3f || trace.startSolid || trace.surface < 0 ||
+			   fabsf(trace.end[_Y] - pos[_Y]) > 1e-3f)
+			{
+				printf("  fall at %.3f units a tick from (%g, %g): rested at %.5f after %d ticks, wanted %.5f\n",
+						speed, spots[s][0], spots[s][1], pos[_Y], ticks, want);
+				failed++;
+			}
+		}
+
+	printf("  %-34s %10.3g %s\n", "fall speeds 0.05 to 1000, height", worst, failed ? "FAILED" : "ok");
+	return failed ? 1 : 0;
+}
+
+/*
+ * collision_testGrid
+ * Random triangles, a few of them large enough to cover many cells, and
+ * random sweeps through them. The grid has to find the same first hit as
+ * testing every triangle. Equally early hits can come out in a different
+ * order, so a different surface is fine if it stops the box at the same
+ * point.
+ */
+static int collision_testGrid()
+{
+	vec3_t				a, b, c, start, end, mins, maxs;
+	collision_trace_t	grid, all;
+	float				size;
+	int					i, j, hits = 0, failed = 0;
+
+	collision_clear();
+
+	for(i = 0; i < TEST_RANDOM_TRIS; i++)
+	{
+		size = i % 50 ? collision_random(0.5f, 8.0f) : collision_random(50.0f, 200.0f);
+
+		for(j = 0; j < 3; j++)
+			a[j] = collision_random(-200.0f, 200.0f);
+		for(j = 0; j < 3; j++)
+		{
+			b[j] = a[j] + collision_random(-size, size);
+			c[j] = a[j] + collision_random(-size, size);
+		}
+
+		collision_addTriangle(a, b, c, i);
+	}
+
+	collision_build();
+
+	for(i = 0; i < TEST_RANDOM_SWEEPS; i++)
+	{
+		for(j = 0; j < 3; j++)
+		{
+			start[j] = collision_random(-220.0f, 220.0f);
+			end[j]	 = start[j] + collision_random(-60.0f, 60.0f);
+			mins[j]	 = -collision_random(0.1f, 3.0f);
+			maxs[j]	 = collision_random(0.1f, 3.0f);
+		}
+
+		collision_sweep(start, end, mins, maxs, &grid);
+		collision_sweepAll(start, end, mins, maxs, &all);
+
+		if(all.surface >= 0)
+			hits++;
+
+		if(grid.surface == all.surface && grid.fraction == all.fraction && grid.startSolid == all.startSolid)
+			continue;
+
+		if(grid.surface >= 0 && all.surface >= 0 && grid.startSolid == all.startSolid &&
+		   fabsf(grid.fraction - all.fraction) < 1e-6f)
+			continue;
+
+		printf("  sweep %d: grid hit %d at %.6f, all triangles hit %d at %.6f\n",
+				i, grid.surface, grid.fraction, all.surface, all.fraction);
+		failed++;
+	}
+
+	printf("  %-34s %10d %s\n", "grid vs every triangle, hits", hits, failed ? "FAILED" : "ok");
+	return failed ? 1 : 0;
+}
+
+/*
+ * collision_testOverlap
+ * Whether the box is ever inside a grown or shrunk copy of itself over a
+ * point sampled from the triangle, at a sampled time along the move.
+ */
+static eboolean collision_testOverlap(const vec3_t tri[3], const vec3_t start, const vec3_t end,
+		const vec3_t mins, const vec3_t maxs, float margin)
+{
+	vec3_t	p, origin;
+	float	t, u, v;
+	int		step, i, j, k;
+
+	for(step = 0; step <= TEST_OVERLAP_STEPS; step++)
+	{
+		t = (float)step / TEST_OVERLAP_STEPS;
+		for(k = 0; k < 3; k++)
+			origin[k] = start[k] + t * (end[k] - start[k]);
+
+		for(i = 0; i <= TEST_OVERLAP_SPLITS; i++)
+			for(j = 0; i + j <= TEST_OVERLAP_SPLITS; j++)
+			{
+				u = (float)i / TEST_OVERLAP_SPLITS;
+				v = (float)j / TEST_OVERLAP_SPLITS;
+
+				for(k = 0; k < 3; k++)
+				{
+					p[k] = tri[0][k] + u * (tri[1][k] - tri[0][k]) + v * (tri[2][k] - tri[0][k]) - origin[k];
+					if(p[k] < mins[k] - margin || p[k] > maxs[k] + margin)
+						break;
+				}
+
+				if(k == 3)
+					return etrue;
+			}
+	}
+
+	return efalse;
+}
+
+/*
+ * collision_testHits
+ * One random triangle and one random move at a time. A move that a shrunk
+ * box makes overlapping a sample of the triangle must hit it, a move that
+ * a grown box never does must miss it. Along any axis, every point of the
+ * triangle is within 2.3 / TEST_OVERLAP_SPLITS of a sample and the box
+ * moves at most 1.15 / TEST_OVERLAP_STEPS between time samples, which
+ * TEST_OVERLAP_MARGIN covers. Moves between the two are too close to call
+ * by sampling and count as neither.
+ */
+static int collision_testHits()
+{
+	vec3_t				tri[3], start, end, mins, maxs;
+	collision_trace_t	trace;
+	eboolean			inside, near;
+	int					i, j, hits = 0, misses = 0, failed = 0;
+
+	for(i = 0; i < TEST_OVERLAP_MOVES; i++)
+	{
+		for(j = 0; j < 3; j++)
+		{
+			tri[0][j] = collision_random(-1.5f, 1.5f);
+			tri[1][j] = tri[0][j] + collision_random(-1.15f, 1.15f);
+			tri[2][j] = tri[0][j] + collision_random(-1.15f, 1.15f);
+			start[j]  = collision_random(-2.0f, 2.0f);
+			end[j]	  = start[j] + collision_random(-1.15f, 1.15f);
+			mins[j]	  = -collision_random(0.1f, 1.0f);
+			maxs[j]	  = collision_random(0.1f, 1.0f);
+		}
+
+		collision_clear();
+		collision_addTriangle(tri[0], tri[1], tri[2], 0);
+		collision_build();
+		collision_sweep(start, end, mins, maxs, &trace);
+
+		inside = collision_testOverlap((const vec3_t *)tri, start, end, mins, maxs, -TEST_OVERLAP_MARGIN);
+		near   = collision_testOverlap((const vec3_t *)tri, start, end, mins, maxs, TEST_OVERLAP_MARGIN);
+
+		if(inside)
+			hits++;
+		else if(!near)
+			misses++;
+
+		if((inside && trace.surface < 0) || (!near && trace.surface >= 0))
+		{
+			printf("  move %d: swept %s, sampled %s\n", i, trace.surface < 0 ? "clear" : "hit",
+					inside ? "overlapping" : "apart");
+			failed++;
+		}
+	}
+
+	printf("  %-34s %4d / %-5d %s\n", "sweep vs sampled, hits / misses", hits, misses, failed ? "FAILED" : "ok");
+	return failed ? 1 : 0;
+}
+
+/*
+ * collision_test
+ * Prints the checks, returns the number that failed. Leaves the triangle
+ * set empty.
+ */
+int collision_test()
+{
+	int failed = 0;
+
+	printf("Collision checks:\n");
+
+	failed += collision_testFall();
+	failed += collision_testGrid();
+	failed += collision_testHits();
+
+	collision_clear();
+
+	return failed;
+}
@@ -0,0 +1,33 @@
+/*
+===========================================================================
+File:		collision.h
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+===========================================================================
+*/
+
+#ifndef COLLISION_H_
+#define COLLISION_H_
+
+#include "common.h"
+#include "vmath.h"
+
+typedef struct
+{
+	float		fraction;		//of the move made before touching, 1 if clear
+	vec3_t		end;			//where the box stopped
+	vec3_t		normal;			//of the surface hit, pointing back at the box
+	int			surface;		//id given to the triangle hit, -1 if clear
+	eboolean	startSolid;		//the box was already overlapping something
+}
+collision_trace_t;
+
+void collision_clear();
+void collision_addTriangle(const vec3_t a, const vec3_t b, const vec3_t c, int surface);
+void collision_addQuad(vec3_t verts[4], int surface);
+void collision_build();
+void collision_sweep(const vec3_t start, const vec3_t end, const vec3_t mins, const vec3_t maxs, collision_trace_t *trace);
+void collision_printStats();
+int  collision_test();
+
+#endif /* COLLISION_H_ */
@@ -16,7 +16,17 @@ Created on: Sep 29, 2010
 #define MAX_NAMELENGTH 	128
 #define	MAX_FILEPATH	512
 
+//Whitespace separated tokens read a chunk at a time, see system_files.c
+typedef struct files_tokenStream_s files_tokenStream_t;
+
 int    files_tokenizeStr(char *str, const char *delimiters, char ***tokens);
 char * files_readTextFile(char *filename);
+int    files_sameBaseName(const char *a, const char *b);
+
+files_tokenStream_t * files_openTokenStream(char *filename);
+char *                files_nextToken(files_tokenStream_t *stream);
+void                  files_closeTokenStream(files_tokenStream_t *stream);
+
+int    files_benchmark(char *filename);
 
 #endif /* FILES_H_ */
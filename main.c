@@ -20,14 +20,32 @@ Description:	Texturing demo - you will need to change the path to the texture
 ===========================================================================
 */
 
+#define _GNU_SOURCE
+
 #include <SDL/SDL.h>
 #include <SDL/SDL_main.h>
 #include <SDL/SDL_opengl.h>
 
+#include "collision.h"
+#include "files.h"
 #include "renderer_models.h"
+#include "renderer_batch.h"
 #include "renderer_materials.h"
+#include "renderer_particles.h"
+#include "renderer_profile.h"
+#include "renderer_queue.h"
+#include "renderer_sky.h"
+#include "system_hotreload.h"
+#include "system_jobs.h"
+#include "system_memory.h"
+#include "system_pack.h"
+#include "system_replay.h"
+#include "system_sync.h"
+#include "world.h"
 #include "common.h"
 #include "vmath.h"
+#include <assert.h>
+#include <limits.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -35,22 +53,52 @@ Description:	Texturing demo - you will need to change the path to the texture
 #include <sys/stat.h>
 #include <time.h>
 
+//Shared between threads, only touch through sync_load/sync_store
 static int user_exit = 0;
+
+//Owned by the simulation thread
 static float gravity = 0;
 static int hit = 0;
-static int textureStars;
-static int textureBrick;
-static int textureLava;
-static int textureScore;
 static double randx;
 static double randz;
 static double size;
 static int points = 0;
 static int won;
 static int lost;
+static int level = 0;
+
+//Collision surfaces, and the player's box around the eye. The eye stands
+//one unit above whatever the feet rest on.
+#define SURFACE_PLATFORM	0
+#define SURFACE_PLAQUE		1
+#define SURFACE_WORLD		2
+
+static const vec3_t playerMins = {-0.25, -1, -0.25};
+static const vec3_t playerMaxs = { 0.25, 0.25, 0.25};
+
+//Owned by the render thread
+static int textureBrick;
+static int textureScore;
+
+//score0.tga .. score9.tga, loaded once
+#define SCORE_TEXTURES 10
+static int textureScores[SCORE_TEXTURES];
 
 //INPUT DECLARATIONS
 
+typedef struct
+{
+	int		type;
+	int		key;
+	int		x, y;
+}
+input_event_t;
+
+#define INPUT_QUEUE_SIZE 256
+
+static sync_spscQueue_t inputQueue;
+
+static void input_post(SDL_Event *event);
 static void input_keyDown(SDLKey k);
 static void input_keyUp(SDLKey k);
 static void input_mouseMove(int dx, int dy);
@@ -63,26 +111,105 @@ typedef struct
 	vec3_t	position;
 	vec3_t	angles_deg;
 	vec3_t	angles_rad;
+
+	//Cached per-axis sin/cos of angles_rad, refreshed whenever an angle changes
+	vec3_t	sin_angles;
+	vec3_t	cos_angles;
+
+	//Where the view is actually placed; trails position once the round is lost
+	vec3_t	view_origin;
+
+	//rotMatrix is rotation only (sky), viewMatrix is rotation * translation
+	mat4_t	rotMatrix;
+	mat4_t	viewMatrix;
+	eboolean dirty;
 } camera_t;
 
 static camera_t camera;
 
 static void camera_init();
+static void camera_setAngle(int axis, float degrees);
+static void camera_setViewOrigin(vec3_t origin);
+static void camera_update();
 static void camera_rotateX(float degree);
 static void camera_rotateY(float degree);
 static void camera_rotateZ(float degree);
 static void camera_translateForward(float dist);
 static void camera_translateStrafe(float dist);
 
+//SIMULATION DECLARATIONS
+
+//Everything the renderer needs from one simulation tick. Published through
+//a triple buffer, so the renderer only ever sees complete snapshots.
+typedef struct
+{
+	mat4_t		viewMatrix;
+	mat4_t		rotMatrix;
+	vec3_t		position;
+	double		randx, randz, size;
+	int			points;
+	int			level;
+}
+sim_snapshot_t;
+
+#define SIM_TICK_MS			16
+#define SIM_MAX_CATCHUP		8
+
+static sync_tripleBuffer_t snapshots;
+
+//Executed tick count, replay files are keyed on it
+static unsigned int simTick = 0;
+
+//-record <file> / -replay <file>
+static eboolean recording = efalse, replaying = efalse;
+static replay_event_t replayNext;
+
+//Development mode, -hotreload: reload changed assets without restarting
+static eboolean devHotReload = efalse;
+
+//-occlusiontest: draw a scripted set of views instead of playing, see
+//r_occlusionTest
+static eboolean occlusionTest = efalse;
+
+static void sim_init();
+static int  sim_thread(void *data);
+static void sim_applyEvent(input_event_t *ev);
+static void sim_pollReplay();
+static void sim_tick();
+static void sim_publish();
+static void game_newRound();
+static void game_buildCollision();
+static void game_update();
+
 //RENDERER DECLARATIONS
 
 //NEW TEXTURE STUFF
 //static void r_image_loadTGA(char *name, int *glTexID, int *width, int *height, int *bpp);
 
+//An image r_init needs before the first frame. Decoded on the job workers,
+//uploaded on the GL thread.
+typedef struct
+{
+	char			name[16];
+	int				*glTexID;		//NULL for the sky
+	byte			*pixels;
+	int				width, height, bpp;
+	jobs_counter_t	decoded;
+}
+r_asset_t;
+
 static void r_init();
+static void r_decodeAsset(void *param);
+static void r_roundReset(sim_snapshot_t *snap);
+static void r_buildStaticWorld(sim_snapshot_t *snap);
 static void r_setupProjection();
 static void r_setupModelview();
-static void r_drawFrame();
+static void r_drawFrame(sim_snapshot_t *snap);
+static eboolean r_occlusionTest();
+
+//The snapshot being drawn, for render queue callbacks
+static sim_snapshot_t *r_snapshot;
+static int r_level = -1;
 
 static const GLfloat flipMatrix[16] =
 {1.0, 0.0,  0.0, 0.0,
@@ -90,18 +217,6 @@ static const GLfloat flipMatrix[16] =
  0.0, 1.0,  0.0, 0.0,
  0.0, 0.0,  0.0, 1.0};
 
-typedef struct
-{
-	int		glTexID;
-	char	name[128];
-	vec3_t	ambient, diffuse, specular;
-	float	shine, shineStrength, transparency;
-	int		width, height, bpp;
-}
-material_t;
-
-static material_t materialList[MAX_TEXTURES];
-static int stackPtr = 0;
 
 void newgame() {
 
@@ -112,10 +227,93 @@ void newgame() {
  */
 int main(int argc, char* argv[])
 {
+	SDL_Event		event;
+	SDL_Surface		*screen;
+	SDL_Thread		*simThread;
+	sim_snapshot_t	*snap;
+	unsigned int	seed;
+	unsigned long	megabytes;
+	char			*end;
+	int				i, exitCode = 0;
+
 	size = 32;
-	srand(time(NULL));
-	SDL_Event	event;
-	SDL_Surface	*screen;
+	seed = time(NULL);
+
+	for(i = 1; i < argc; i++)
+	{
+		if(!strcmp(argv[i], "-hotreload"))
+		{
+			devHotReload = etrue;
+			continue;
+		}
+
+		if(!strcmp(argv[i], "-occlusiontest"))
+		{
+			occlusionTest = etrue;
+			continue;
+		}
+
+		if(!strcmp(argv[i], "-jobsbench"))
+		{
+			jobs_benchmark();
+			return 0;
+		}
+
+		if(!strcmp(argv[i], "-vmathtest"))
+			return vmath_test() ? 1 : 0;
+
+		if(!strcmp(argv[i], "-collisiontest"))
+			return collision_test() ? 1 : 0;
+
+		//Optionally followed by the file to tokenize
+		if(!strcmp(argv[i], "-tokbench"))
+			return files_benchmark(i < argc - 1 ? argv[i+1] : "volcano.ASE") ? 0 : 1;
+
+		//The rest take an argument
+		if(i == argc - 1)
+		{
+			if(!strcmp(argv[i], "-record") || !strcmp(argv[i], "-replay"))
+				printf("Usage: %s %s <file>\n", argv[0], argv[i]);
+			else if(!strcmp(argv[i], "-texbudget"))
+				printf("Usage: %s -texbudget <megabytes>\n", argv[0]);
+			else if(!strcmp(argv[i], "-buildpack"))
+				printf("Usage: %s -buildpack <pack> <file>...\n", argv[0]);
+			else
+				break;
+
+			return 1;
+		}
+
+		if(!strcmp(argv[i], "-record"))
+			recording = replay_openRecord(argv[++i], seed);
+		else if(!strcmp(argv[i], "-replay"))
+			replaying = replay_openPlayback(argv[++i], &seed);
+		else if(!strcmp(argv[i], "-texbudget"))
+		{
+			//strtoul would quietly wrap a negative number around
+			megabytes = strtoul(argv[++i], &end, 10);
+
+			if(strchr(argv[i], '-') || end == argv[i] || *end != '\0' || megabytes == 0)
+			{
+				printf("Bad -texbudget %s, expected a positive number of megabytes.\n", argv[i]);
+				return 1;
+			}
+
+			//Clamped before multiplying, unsigned long is 32 bits on some targets
+			if(megabytes > UINT_MAX / (1024 * 1024))
+				megabytes = UINT_MAX / (1024 * 1024);
+
+			renderer_img_setTextureBudget((unsigned int)(megabytes * 1024UL * 1024UL));
+		}
+		else if(!strcmp(argv[i], "-buildpack"))
+			return pack_build(argv[i+1], &argv[i+2], argc - i - 2) ? 0 : 1;
+	}
+
+	//Edited files have to be seen, so hot reloading always reads loose files
+	if(!devHotReload)
+		pack_open(PACK_DEFAULT_NAME);
+
+	srand(seed);
 
 	if(SDL_Init(SDL_INIT_VIDEO|SDL_INIT_TIMER) != 0)
 	{
@@ -134,60 +332,74 @@ int main(int argc, char* argv[])
 		return 1;
 	}
 
+	jobs_init(0);
 	r_init();
+	world_init("world.txt");
 
-	float t = 0.0f;
-	float dt = 0.1f;
+	if(devHotReload)
+		hotreload_init(".");
 
-	float currentTime = 0.0f;
-	float accumulator = 0.0f;
+	sim_init();
 
-	while(!user_exit)
+	//The test draws its own frames with the simulation held still
+	if(occlusionTest)
 	{
-		if (won) {
-			r_init();
-		}
-		float newTime = time(0);
-		float deltaTime = newTime - currentTime;
-		currentTime = newTime;
-
-		if (deltaTime>0.25f)
-			deltaTime = 0.25f;
+		exitCode = r_occlusionTest() ? 0 : 1;
+		sync_store(&user_exit, 1);
+		simThread = NULL;
+	}
+	else
+		simThread = SDL_CreateThread(sim_thread, NULL);
 
-		accumulator += deltaTime;
+	//This thread owns the GL context and the SDL event queue. It never waits
+	//on the simulation: input is queued, and each frame draws whatever
+	//snapshot was published most recently.
+	while(!sync_load(&user_exit))
+	{
+		while(SDL_PollEvent(&event))
+			input_post(&event);
 
-		while (accumulator>=dt)
-		{
-			accumulator -= dt;
-			t += dt;
-		}
+		snap = (sim_snapshot_t *)sync_tripleRead(&snapshots);
 
-		//Handle input
-		while(SDL_PollEvent(&event))
+		if(snap->level != r_level)
 		{
-			switch(event.type)
-			{
-			case SDL_KEYDOWN:
-				input_keyDown(event.key.keysym.sym);
-				break;
-			case SDL_KEYUP:
-				input_keyUp(event.key.keysym.sym);
-				break;
-			case SDL_MOUSEMOTION:
-				input_mouseMove(event.motion.x, event.motion.y);
-				break;
-			case SDL_QUIT:
-				user_exit = 1;
-			}
+			r_roundReset(snap);
+			r_level = snap->level;
 		}
 
-		input_update();
-
-		r_drawFrame();
+		r_drawFrame(snap);
 	}
 
+	SDL_WaitThread(simThread, NULL);
+
+	if(recording)
+		replay_closeRecord(simTick);
+	if(replaying)
+		replay_closePlayback();
+
+	renderer_sky_printStats();
+	renderer_particles_printStats();
+	renderer_queue_printStats();
+	renderer_model_printStats();
+	renderer_profile_printStats();
+	renderer_img_printMaterialStats();
+	renderer_img_printTextureStats();
+	world_printStats();
+	collision_printStats();
+	pack_printStats();
+	jobs_printStats();
+
+	world_shutdown();
+	renderer_particles_shutdown();
+	hotreload_shutdown();
+	jobs_shutdown();
+	pack_close();
+
+	//After the shutdowns, so what is still live is what nothing releases
+	memory_printStats();
+
 	SDL_Quit();
-	return 0;
+	return exitCode;
 }
 
 /*
@@ -198,7 +410,51 @@ int main(int argc, char* argv[])
 
 static int keys_down[SDLK_LAST];
 
-static void input_keyDown(SDLKey k) { keys_down[k] = 1; if(k == SDLK_ESCAPE || k == SDLK_ESCAPE) user_exit = 1; }
+/*
+ * input_post
+ * Render thread. Forwards the events the simulation cares about.
+ */
+static void input_post(SDL_Event *event)
+{
+	input_event_t ev;
+
+	ev.type = event->type;
+	ev.key  = 0;
+	ev.x	= ev.y = 0;
+
+	switch(event->type)
+	{
+	case SDL_KEYDOWN:
+		//On demand memory report, the sim never needs to see it
+		if(event->key.keysym.sym == SDLK_F2)
+		{
+			memory_printStats();
+			return;
+		}
+		ev.key = event->key.keysym.sym;
+		break;
+	case SDL_KEYUP:
+		ev.key = event->key.keysym.sym;
+		break;
+	case SDL_MOUSEMOTION:
+		ev.x = event->motion.x;
+		ev.y = event->motion.y;
+
+		//Reset cursor to center, SDL calls have to stay on this thread
+		SDL_WarpMouse(WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2);
+		break;
+	case SDL_QUIT:
+		sync_store(&user_exit, 1);
+		return;
+	default:
+		return;
+	}
+
+	if(!sync_queuePush(&inputQueue, &ev))
+		printf("Input queue full, dropping event.\n");
+}
+
+static void input_keyDown(SDLKey k) { keys_down[k] = 1; if(k == SDLK_ESCAPE || k == SDLK_ESCAPE) sync_store(&user_exit, 1); }
 static void input_keyUp  (SDLKey k) { keys_down[k] = 0; }
 
 /*
@@ -216,9 +472,6 @@ void input_mouseMove(int dx, int dy)
 	//Feed the deltas to the camera
 	camera_rotateX(-dy/2.0);
 	camera_rotateY(-dx/2.0);
-
-	//Reset cursor to center
-	SDL_WarpMouse(halfWinWidth, halfWinHeight);
 }
 
 /*
@@ -240,8 +493,9 @@ static void input_update()
 	//Reset, sometimes you can get pretty lost...
 	if(keys_down[SDLK_r])
 	{
-		VectorClear(camera.angles_deg);
-		VectorClear(camera.angles_rad);
+		camera_setAngle(_X, 0);
+		camera_setAngle(_Y, 0);
+		camera_setAngle(_Z, 0);
 		VectorClear(camera.position);
 	}
 }
@@ -252,51 +506,125 @@ static void input_update()
 ===========================================================================
 */
 
-//Maintain a matrix for each rotation and one for translation
-static float xRotMatrix[16], yRotMatrix[16], zRotMatrix[16], translateMatrix[16];
-
 static void camera_init()
 {
 	camera.position[_X] = 0;
 	camera.position[_Y] = 0;
 	camera.position[_Z] = 0;
 
-	MatrixIdentity(xRotMatrix);
-	MatrixIdentity(yRotMatrix);
-	MatrixIdentity(zRotMatrix);
-	MatrixIdentity(translateMatrix);
+	VectorClear(camera.view_origin);
+
+	//Angles carry over between rounds, this just primes the sin/cos cache
+	camera_setAngle(_X, camera.angles_deg[_X]);
+	camera_setAngle(_Y, camera.angles_deg[_Y]);
+	camera_setAngle(_Z, camera.angles_deg[_Z]);
+
+	camera_update();
+}
+
+/*
+ * camera_setAngle
+ * The only place angles change, so sin/cos are evaluated once per change
+ * rather than every frame and every movement tick.
+ */
+static void camera_setAngle(int axis, float degrees)
+{
+	float s, c;
+
+	camera.angles_deg[axis] = degrees;
+	camera.angles_rad[axis] = degrees * M_PI_DIV180;
+
+	sincosf(camera.angles_rad[axis], &s, &c);
+	camera.sin_angles[axis] = s;
+	camera.cos_angles[axis] = c;
+
+	camera.dirty = etrue;
+}
+
+/*
+ * camera_setViewOrigin
+ */
+static void camera_setViewOrigin(vec3_t origin)
+{
+	if(origin[_X] == camera.view_origin[_X] && origin[_Y] == camera.view_origin[_Y] &&
+	   origin[_Z] == camera.view_origin[_Z])
+		return;
+
+	VectorCopy(origin, camera.view_origin);
+	camera.dirty = etrue;
+}
+
+/*
+ * camera_update
+ * Rebuilds the cached matrices if anything moved. The result is the same as
+ * the old per-frame xRot * zRot * yRot * translate sequence of glMultMatrixf.
+ */
+static void camera_update()
+{
+	mat4_t	xRot, yRot, zRot, translate;
+	float	sinX, cosX, sinY, cosY, sinZ, cosZ;
+
+	if(!camera.dirty)
+		return;
+
+	//Rotations are by the negated angles: sin(-a) = -sin(a), cos(-a) = cos(a)
+	sinX = -camera.sin_angles[_X]; cosX = camera.cos_angles[_X];
+	sinY = -camera.sin_angles[_Y]; cosY = camera.cos_angles[_Y];
+	sinZ = -camera.sin_angles[_Z]; cosZ = camera.cos_angles[_Z];
+
+	MatrixIdentity(xRot);
+	xRot[5]  = cosX;
+	xRot[6]  = sinX;
+	xRot[9]  = -sinX;
+	xRot[10] = cosX;
+
+	MatrixIdentity(yRot);
+	yRot[0]  =  cosY;
+	yRot[2]  = -sinY;
+	yRot[8]  =  sinY;
+	yRot[10] =  cosY;
+
+	MatrixIdentity(zRot);
+	zRot[0] = cosZ;
+	zRot[1] = sinZ;
+	zRot[4] = -sinZ;
+	zRot[5] = cosZ;
+
+	MatrixIdentity(translate);
+	translate[12] = -camera.view_origin[_X];
+	translate[13] = -camera.view_origin[_Y];
+	translate[14] = -camera.view_origin[_Z];
+
+	mat4_multiply(xRot, zRot, camera.rotMatrix);
+	mat4_multiply(camera.rotMatrix, yRot, camera.rotMatrix);
+	mat4_multiply(camera.rotMatrix, translate, camera.viewMatrix);
+
+	camera.dirty = efalse;
 }
 
 //Rotations just increase/decrease the angle and compute a new radian value.
 static void camera_rotateX(float degree)
 {
-	if(!((degree < 0 && camera.angles_deg[_X] < -70) || (degree > 0 && camera.angles_deg[_X] > 70))) {
-		camera.angles_deg[_X] += degree;
-		camera.angles_rad[_X] = camera.angles_deg[_X] * M_PI_DIV180;
-	}
+	if(!((degree < 0 && camera.angles_deg[_X] < -70) || (degree > 0 && camera.angles_deg[_X] > 70)))
+		camera_setAngle(_X, camera.angles_deg[_X] + degree);
 }
 
 static void camera_rotateY(float degree)
 {
-		camera.angles_deg[_Y] += degree;
-		camera.angles_rad[_Y] = camera.angles_deg[_Y] * M_PI_DIV180;
+	camera_setAngle(_Y, camera.angles_deg[_Y] + degree);
 }
 
 static void camera_rotateZ(float degree)
 {
-	camera.angles_deg[_Z] += degree;
-	camera.angles_rad[_Z] = camera.angles_deg[_Z] * M_PI_DIV180;
+	camera_setAngle(_Z, camera.angles_deg[_Z] + degree);
 }
 
 static void camera_translateForward(float dist)
 {
-	float sinX, cosX, sinY, cosY, dx, dy, dz;
+	float sinY, cosY, dx, dy, dz;
 
-	sinY = sin(camera.angles_rad[_Y]);
-	cosY = cos(camera.angles_rad[_Y]);
-
-	sinX = sin(camera.angles_rad[_X]);
-	cosX = cos(camera.angles_rad[_X]);
+	sinY = camera.sin_angles[_Y];
+	cosY = camera.cos_angles[_Y];
 
 	//Free
 //	dx =  -sinY * cosX * dist;
@@ -315,15 +643,13 @@ static void camera_translateForward(float dist)
 
 static void camera_translateStrafe(float dist)
 {
-	float sinX, cosX, sinY, cosY, dx, dy, dz, yPlus90;
-
-	yPlus90 = (camera.angles_deg[_Y] + 90.0) * M_PI_DIV180;
+	float cosX, sinY, cosY, dx, dy, dz;
 
-	sinY = sin(yPlus90);
-	cosY = cos(yPlus90);
+	//sin(y + 90) = cos(y), cos(y + 90) = -sin(y)
+	sinY =  camera.cos_angles[_Y];
+	cosY = -camera.sin_angles[_Y];
 
-	sinX = sin(camera.angles_rad[_X]);
-	cosX = cos(camera.angles_rad[_X]);
+	cosX = camera.cos_angles[_X];
 
 	//Free
 	dx =  -sinY * cosX * dist;
@@ -340,6 +666,295 @@ static void camera_translateStrafe(float dist)
 	camera.position[_Z] += dz;
 }
 
+/*
+===========================================================================
+	SIMULATION
+===========================================================================
+*/
+
+/*
+ * sim_init
+ * Sets up the first round and publishes it before the thread starts, so
+ * the renderer has something to draw on its first frame.
+ */
+static void sim_init()
+{
+	sync_queueInit(&inputQueue, sizeof(input_event_t), INPUT_QUEUE_SIZE);
+	sync_tripleInit(&snapshots, sizeof(sim_snapshot_t));
+
+	game_newRound();
+	sim_publish();
+}
+
+/*
+ * sim_thread
+ * Fixed rate simulation. If it falls behind it catches up a few ticks at a
+ * time and then drops the rest, it never waits on the renderer.
+ */
+static int sim_thread(void *data)
+{
+	Uint32	now, next;
+	int		ticks;
+
+	next = SDL_GetTicks();
+
+	while(!sync_load(&user_exit))
+	{
+		now = SDL_GetTicks();
+
+		if((Sint32)(next - now) > 0)
+		{
+			SDL_Delay(next - now);
+			continue;
+		}
+
+		for(ticks = 0; (Sint32)(now - next) >= 0 && ticks < SIM_MAX_CATCHUP && !sync_load(&user_exit); ticks++)
+		{
+			sim_tick();
+			next += SIM_TICK_MS;
+		}
+
+		if((Sint32)(now - next) >= 0)
+			next = now + SIM_TICK_MS;
+
+		sim_publish();
+	}
+
+	return 0;
+}
+
+/*
+ * sim_applyEvent
+ * Feeds one event to the input handlers, logging it when recording.
+ */
+static void sim_applyEvent(input_event_t *ev)
+{
+	replay_event_t rec;
+
+	rec.tick = simTick;
+	rec.key  = ev->key;
+	rec.x	 = ev->x;
+	rec.y	 = ev->y;
+
+	//keys_down is indexed by it, replay_readEvent and SDL keep it in range
+	assert(ev->type == SDL_MOUSEMOTION || (ev->key >= 0 && ev->key < SDLK_LAST));
+
+	switch(ev->type)
+	{
+	case SDL_KEYDOWN:
+		input_keyDown((SDLKey)ev->key);
+		rec.type = REPLAY_KEYDOWN;
+		break;
+	case SDL_KEYUP:
+		input_keyUp((SDLKey)ev->key);
+		rec.type = REPLAY_KEYUP;
+		break;
+	case SDL_MOUSEMOTION:
+		input_mouseMove(ev->x, ev->y);
+		rec.type = REPLAY_MOUSE;
+		break;
+	default:
+		return;
+	}
+
+	if(recording)
+		replay_writeEvent(&rec);
+}
+
+/*
+ * sim_pollReplay
+ * Applies every logged event stamped with the current tick. Live input is
+ * drained and ignored, except that escape still quits.
+ */
+static void sim_pollReplay()
+{
+	input_event_t ev;
+
+	while(sync_queuePop(&inputQueue, &ev))
+		if(ev.type == SDL_KEYDOWN && ev.key == SDLK_ESCAPE)
+			sync_store(&user_exit, 1);
+
+	if(simTick == 0)
+		replay_readEvent(&replayNext);
+
+	while(replayNext.tick == simTick)
+	{
+		switch(replayNext.type)
+		{
+		case REPLAY_KEYDOWN:
+			ev.type = SDL_KEYDOWN;
+			break;
+		case REPLAY_KEYUP:
+			ev.type = SDL_KEYUP;
+			break;
+		case REPLAY_MOUSE:
+			ev.type = SDL_MOUSEMOTION;
+			break;
+		default:
+			//END: the recorded session stopped here
+			sync_store(&user_exit, 1);
+			return;
+		}
+
+		ev.key = replayNext.key;
+		ev.x   = replayNext.x;
+		ev.y   = replayNext.y;
+		sim_applyEvent(&ev);
+
+		replay_readEvent(&replayNext);
+	}
+}
+
+/*
+ * sim_tick
+ */
+static void sim_tick()
+{
+	input_event_t ev;
+
+	if(won)
+		game_newRound();
+
+	if(replaying)
+	{
+		sim_pollReplay();
+
+		if(sync_load(&user_exit))
+			return;
+	}
+	else
+		while(sync_queuePop(&inputQueue, &ev))
+			sim_applyEvent(&ev);
+
+	input_update();
+	game_update();
+
+	simTick++;
+}
+
+/*
+ * sim_publish
+ */
+static void sim_publish()
+{
+	sim_snapshot_t *snap;
+
+	camera_update();
+
+	snap = (sim_snapshot_t *)sync_tripleWriteSlot(&snapshots);
+
+	memcpy(snap->viewMatrix, camera.viewMatrix, sizeof(mat4_t));
+	memcpy(snap->rotMatrix,  camera.rotMatrix,  sizeof(mat4_t));
+	VectorCopy(camera.view_origin, snap->position);
+	snap->randx  = randx;
+	snap->randz  = randz;
+	snap->size	 = size;
+	snap->points = points;
+	snap->level  = level;
+
+	sync_triplePublish(&snapshots);
+}
+
+/*
+ * game_newRound
+ * Rolls a new target platform. level tells the renderer to rebuild.
+ */
+static void game_newRound()
+{
+	lost = 0;
+	won = 0;
+	hit = 0;
+	randx = rand()%21-10;
+	randz = rand()%21-10;
+	size = size/2;
+
+	camera_init();
+	world_updateCollision(camera.position);
+	game_buildCollision();
+
+	level++;
+}
+
+/*
+ * game_buildCollision
+ * The surfaces the player can land on: the chunk models world_updateCollision
+ * holds around the player and what r_buildStaticWorld draws. The start pad is left out, gravity only starts
+ * once the eye is off it and the player's box would otherwise catch on its
+ * edge.
+ */
+static void game_buildCollision()
+{
+	const vec_t	*tris;
+	int			i, j, numTris;
+
+	collision_clear();
+
+	for(i = 0; world_getCollision(i, &tris, &numTris); i++)
+		for(j = 0; j < numTris; j++)
+			collision_addTriangle(&tris[j*9], &tris[j*9+3], &tris[j*9+6], SURFACE_WORLD);
+
+	//Score plaque
+	{
+		vec3_t v[4] = {{20,-200,20}, {20,-200,120}, {120,-200,120}, {120,-200,20}};
+		collision_addQuad(v, SURFACE_PLAQUE);
+	}
+
+	//Target platform
+	{
+		vec3_t v[4] = {{randx+size,-100,randz+size}, {randx+size,-100,randz-size},
+					   {randx-size,-100,randz-size}, {randx-size,-100,randz+size}};
+		collision_addQuad(v, SURFACE_PLATFORM);
+	}
+
+	collision_build();
+}
+
+/*
+ * game_update
+ * Gravity and the win/loss checks, once per tick. The fall is swept, so
+ * the player lands on the platform however far a tick moves them.
+ */
+static void game_update()
+{
+	collision_trace_t	trace;
+	vec3_t				end;
+
+	//Crossed into another chunk, the held world collision moves with it
+	if(world_updateCollision(camera.position))
+		game_buildCollision();
+
+	if (gravity==0 && (camera.position[_X]>2 || camera.position[_X]<-2 || camera.position[_Z]>2 || camera.position[_Z]<-2)) {
+		if (!hit) {
+			gravity = -0.05;
+		}
+	}
+	if (camera.position[_Y]<-99) {
+		hit = 1;
+	}
+	if (camera.position[_Y]<-199 && gravity) {
+		lost = 1;
+	}
+	if (!lost) {
+		if (gravity) {
+			VectorCopy(camera.position, end);
+			end[_Y] += gravity;
+
+			collision_sweep(camera.position, end, playerMins, playerMaxs, &trace);
+			VectorCopy(trace.end, camera.position);
+
+			if (trace.surface == SURFACE_PLATFORM && !hit) {
+				gravity = 0;
+				points++;
+				won = 1;
+			}
+			else if (trace.surface >= 0) {
+				lost = 1;
+			}
+		}
+		camera_setViewOrigin(camera.position);
+	}
+}
+
 /*
 ===========================================================================
 	TGA LOADING
@@ -361,45 +976,57 @@ typedef struct
 tgaHeader_t;
 
 /*
- * Function: renderer_img_loadTGA
- * Description: Loads a TARGA image file, uploads to GL, and returns the
- * texture ID. Only supports 24/32 bit.
+ * Function: renderer_img_decodeTGA
+ * Description: Reads a TARGA image, from the asset pack if it has one by
+ * that name or else the loose file, and returns its pixels as tightly
+ * packed luminance, RGB or RGBA rows, or NULL on failure. Only supports
+ * uncompressed 8 bit grayscale and 24/32 bit color.
+ * IMPORTANT: The client is responsible for freeing the returned buffer!
  */
-void renderer_img_loadTGA(char *name, int *glTexID, int *width, int *height, int *bpp)
+byte * renderer_img_decodeTGA(char *name, int *width, int *height, int *bpp)
 {
 	int				dataSize, rows, cols, i, j;
-	GLuint			type;
-	byte			*buf, *imageData, *pixelBuf, red, green, blue, alpha;
+	unsigned int	fileSize;
+	byte			*fileBuf = NULL, *imageData, *pixelBuf, red, green, blue, alpha;
+	const byte		*buf;
 
 	FILE 			*file;
 	tgaHeader_t		header;
 	struct stat 	st;
 
-	file = fopen(name, "rb");
-
-	if(file == NULL)
+	//Straight out of the asset pack mapping if it's there
+	if((buf = pack_find(name, &fileSize)) == NULL)
 	{
-		printf("Loading TGA: %s, failed. Null file pointer.\n", name);
-		return;
-	}
+		file = fopen(name, "rb");
 
-	if(stat(name, &st))
-	{
-		printf("Loading TGA: %s, failed. Could not determine file size.\n", name);
-		return;
+		if(file == NULL)
+		{
+			printf("Loading TGA: %s, failed. Null file pointer.\n", name);
+			return NULL;
+		}
+
+		if(stat(name, &st))
+		{
+			printf("Loading TGA: %s, failed. Could not determine file size.\n", name);
+			fclose(file);
+			return NULL;
+		}
+
+		fileSize = st.st_size;
+		fileBuf  = (byte *)memory_alloc(MEMORY_TAG_IMAGES, fileSize ? fileSize : 1);
+		fileSize = fread(fileBuf, sizeof(byte), fileSize, file);
+		buf		 = fileBuf;
+
+		fclose(file);
 	}
 
-	if(st.st_size < HEADER_SIZE)
+	if(fileSize < HEADER_SIZE)
 	{
 		printf("Loading TGA: %s, failed. Header too short.\n", name);
-		return;
+		memory_free(fileBuf);
+		return NULL;
 	}
 
-	buf = (byte *)malloc(st.st_size);
-	fread(buf, sizeof(byte), st.st_size, file);
-
-	fclose(file);
-
 	memcpy(&header.idLength, 	 	&buf[0],  1);
 	memcpy(&header.colormapType, 	&buf[1],  1);
 	memcpy(&header.imageType, 		&buf[2],  1);
@@ -413,32 +1040,38 @@ void renderer_img_loadTGA(char *name, int *glTexID, int *width, int *height, int
 	memcpy(&header.pixelSize,		&buf[16], 1);
 	memcpy(&header.attributes,		&buf[17], 1);
 
-	//Advance past the header
-	buf += HEADER_SIZE;
+	//Advance past the header and the optional image ID
+	buf += HEADER_SIZE + header.idLength;
 
-	if(header.pixelSize != 24 && header.pixelSize != 32)
+	if(header.pixelSize != 8 && header.pixelSize != 24 && header.pixelSize != 32)
 	{
-		printf("Loading TGA: %s, failed. Only support 24/32 bit images.\n", name);
-		return;
+		printf("Loading TGA: %s, failed. Only support 8/24/32 bit images.\n", name);
+		memory_free(fileBuf);
+		return NULL;
 	}
-	else if(header.pixelSize == 24)
-		type = GL_RGB;
-	else
-		type = GL_RGBA;
 
 	//Determine size of image data chunk in bytes
 	dataSize = header.width * header.height * (header.pixelSize / 8);
 
+	if(fileSize < (unsigned int)(HEADER_SIZE + header.idLength + dataSize))
+	{
+		printf("Loading TGA: %s, failed. Image data truncated.\n", name);
+		memory_free(fileBuf);
+		return NULL;
+	}
+
 	//Set up our texture
 	*bpp 	 	= header.pixelSize;
 	*width  	= header.width;
 	*height 	= header.height;
 
-	imageData = (byte *)malloc(dataSize);
+	imageData = (byte *)memory_alloc(MEMORY_TAG_IMAGES, dataSize);
 	rows	  = *height;
 	cols	  = *width;
 
-	if(type == GL_RGB)
+	if(header.pixelSize == 8)
+		memcpy(imageData, buf, dataSize);
+	else if(header.pixelSize == 24)
 	{
 		for(i = 0; i < rows; i++)
 		{
@@ -475,21 +1108,6 @@ void renderer_img_loadTGA(char *name, int *glTexID, int *width, int *height, int
 		}
 	}
 
-	//Upload the texture to OpenGL
-	glGenTextures(1, glTexID);
-	glBindTexture(GL_TEXTURE_2D, *glTexID);
-
-	//Default OpenGL settings have GL_TEXTURE_MAG/MIN_FILTER set to use
-	//mipmaps... without these calls texturing will not work properly.
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-	//Upload image data to OpenGL
-	glTexImage2D(GL_TEXTURE_2D, 0, type, *width, *height,
-			0, type, GL_UNSIGNED_BYTE, imageData);
-
 	//Header debugging
 	/*
 	printf("Attributes: %d\n", 				header.attributes);
@@ -505,6 +1123,77 @@ void renderer_img_loadTGA(char *name, int *glTexID, int *width, int *height, int
 	printf("X Origin: %d\n", 				header.xOrigin);
 	printf("Y Origin: %d\n", 				header.yOrigin);
 	*/
+
+	memory_free(fileBuf);
+
+	return imageData;
+}
+
+/*
+ * Function: renderer_img_loadTGA
+ * Description: Loads a TARGA image file, uploads to GL, and returns the
+ * texture ID. Only supports 24/32 bit.
+ */
+void renderer_img_loadTGA(char *name, int *glTexID, int *width, int *height, int *bpp)
+{
+	byte *imageData;
+
+	imageData = renderer_img_decodeTGA(name, width, height, bpp);
+
+	if(imageData == NULL)
+		return;
+
+	*glTexID = renderer_img_uploadImage(imageData, *width, *height, *bpp);
+	renderer_img_trackTexture(*glTexID, name, imageData, *width, *height, *bpp);
+
+	memory_free(imageData);
+}
+
+/*
+ * Function: renderer_img_uploadImage
+ * Description: Uploads decoded RGB/RGBA pixels as a new 2D texture and
+ * returns its GL ID. Must be called on the GL thread.
+ */
+int renderer_img_uploadImage(byte *imageData, int width, int height, int bpp)
+{
+	GLuint glTexID;
+
+	glGenTextures(1, &glTexID);
+	renderer_img_updateImage(glTexID, imageData, width, height, bpp);
+
+	return glTexID;
+}
+
+/*
+ * Function: renderer_img_updateImage
+ * Description: Replaces the image of an existing texture in place, so every
+ * list and queue item holding its GL ID picks up the new pixels.
+ */
+void renderer_img_updateImage(int glTexID, byte *imageData, int width, int height, int bpp)
+{
+	GLuint type;
+
+	if(bpp == 8)
+		type = GL_LUMINANCE;
+	else
+		type = (bpp == 24) ? GL_RGB : GL_RGBA;
+
+	//Upload the texture to OpenGL
+	glBindTexture(GL_TEXTURE_2D, glTexID);
+
+	//Default OpenGL settings have GL_TEXTURE_MAG/MIN_FILTER set to use
+	//mipmaps... without these calls texturing will not work properly.
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+	//Rows are tightly packed, which matters for odd widths at 8/24 bit
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	//Upload image data to OpenGL
+	glTexImage2D(GL_TEXTURE_2D, 0, type, width, height,
+			0, type, GL_UNSIGNED_BYTE, imageData);
 }
 
 /*
@@ -515,18 +1204,13 @@ void renderer_img_loadTGA(char *name, int *glTexID, int *width, int *height, int
 
 /*
  * r_init
- * Perform any one-time GL state changes.
+ * Perform any one-time GL state changes and load the textures every round
+ * shares. Runs once, new rounds only need r_roundReset.
  */
 static void r_init()
 {
-	lost = 0;
-	won = 0;
-	hit = 0;
-	randx = rand()%21-10;
-	randz = rand()%21-10;
-	size = size/2;
-
-	int myGLTexture, myTexWidth, myTexHeight, myTexBPP;
+	r_asset_t	assets[SCORE_TEXTURES + 2], *asset;
+	int			numAssets, i;
 
 	glEnable(GL_DEPTH_TEST);
 //	glEnable(GL_CULL_FACE);
@@ -535,69 +1219,118 @@ static void r_init()
 	glEnable(GL_TEXTURE_2D);
 	glEnable(GL_BLEND);
 	glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	//Emitters come from the world manifest
+	renderer_particles_init(PARTICLES_DEFAULT_MAX);
 	//You might want to play with changing the modes
 	//glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
 
+	//None of these depend on each other, so every decode is queued up front
+	//and each upload only waits for its own image. Startup costs about as
+	//much as the slowest decode instead of all of them in a row.
+	memset(assets, 0, sizeof(assets));
+
+	strcpy(assets[0].name, "Starfield.tga");
+	strcpy(assets[1].name, "brick.tga");
+	assets[1].glTexID = &textureBrick;
+	numAssets = 2;
+
+	for(i = 0; i < SCORE_TEXTURES; i++, numAssets++)
+	{
+		sprintf(assets[numAssets].name, "score%d.tga", i);
+		assets[numAssets].glTexID = &textureScores[i];
+	}
+
 //	renderer_img_loadTGA("buttons.tga",
 //			&textureButtons, &myTexWidth, &myTexHeight, &myTexBPP);
-	renderer_img_loadTGA("brick.tga",
-			&textureBrick, &myTexWidth, &myTexHeight, &myTexBPP);
-	renderer_img_loadTGA("Starfield.tga",
-			&textureStars, &myTexWidth, &myTexHeight, &myTexBPP);
-	renderer_img_loadTGA("lava01.tga",
-			&textureLava, &myTexWidth, &myTexHeight, &myTexBPP);
 //	renderer_model_loadASE("submarine.ASE", efalse);
-	renderer_model_loadASE("volcano.ASE", efalse);
 
-	switch(points) {
-	case 0:
-		renderer_img_loadTGA("score0.tga",
-				&textureScore, &myTexWidth, &myTexHeight, &myTexBPP);
-		break;
-	case 1:
-		renderer_img_loadTGA("score1.tga",
-				&textureScore, &myTexWidth, &myTexHeight, &myTexBPP);
-		break;
-	case 2:
-		renderer_img_loadTGA("score2.tga",
-				&textureScore, &myTexWidth, &myTexHeight, &myTexBPP);
-		break;
-	case 3:
-		renderer_img_loadTGA("score3.tga",
-				&textureScore, &myTexWidth, &myTexHeight, &myTexBPP);
-		break;
-	case 4:
-		renderer_img_loadTGA("score4.tga",
-				&textureScore, &myTexWidth, &myTexHeight, &myTexBPP);
-		break;
-	case 5:
-		renderer_img_loadTGA("score5.tga",
-				&textureScore, &myTexWidth, &myTexHeight, &myTexBPP);
-		break;
-	case 6:
-		renderer_img_loadTGA("score6.tga",
-				&textureScore, &myTexWidth, &myTexHeight, &myTexBPP);
-		break;
-	case 7:
-		renderer_img_loadTGA("score7.tga",
-				&textureScore, &myTexWidth, &myTexHeight, &myTexBPP);
-		break;
-	case 8:
-		renderer_img_loadTGA("score8.tga",
-				&textureScore, &myTexWidth, &myTexHeight, &myTexBPP);
-		break;
-	case 9:
-		renderer_img_loadTGA("score9.tga",
-				&textureScore, &myTexWidth, &myTexHeight, &myTexBPP);
-		break;
-	}
+	for(i = 0; i < numAssets; i++)
+		jobs_submit(&assets[i].decoded, r_decodeAsset, &assets[i]);
 
+	for(i = 0; i < numAssets; i++)
+	{
+		asset = &assets[i];
+		jobs_wait(&asset->decoded);
 
-	camera_init();
+		if(asset->pixels == NULL)
+			continue;
+
+		if(asset->glTexID != NULL)
+		{
+			*asset->glTexID = renderer_img_uploadImage(asset->pixels, asset->width, asset->height, asset->bpp);
+			renderer_img_trackTexture(*asset->glTexID, asset->name, asset->pixels,
+					asset->width, asset->height, asset->bpp);
+		}
+		else
+			renderer_sky_initFromImage(asset->pixels, asset->width, asset->height, asset->bpp);
+
+		memory_free(asset->pixels);
+	}
 
 	r_setupProjection();
 }
 
+/*
+ * r_decodeAsset
+ * Job. Reads and decodes one of r_init's images.
+ */
+static void r_decodeAsset(void *param)
+{
+	r_asset_t *asset = (r_asset_t *)param;
+
+	asset->pixels = renderer_img_decodeTGA(asset->name, &asset->width, &asset->height, &asset->bpp);
+}
+
+/*
+ * r_roundReset
+ * Everything the renderer has to do for a new round: pick the score digit
+ * and re-upload the handful of static quads. Nothing is loaded or
+ * allocated, so memory stays flat however many rounds are played.
+ */
+static void r_roundReset(sim_snapshot_t *snap)
+{
+	textureScore = textureScores[snap->points < SCORE_TEXTURES ? snap->points : SCORE_TEXTURES-1];
+
+	r_buildStaticWorld(snap);
+}
+
+/*
+ * r_buildStaticWorld
+ * Gathers every quad that does not move during a round into the static
+ * batch. Needs rebuilding whenever randx, randz, size or the score change.
+ */
+static void r_buildStaticWorld(sim_snapshot_t *snap)
+{
+	double randx = snap->randx, randz = snap->randz, size = snap->size;
+
+	renderer_batch_clear();
+
+	//Score plaque
+	{
+		vec3_t v[4] = {{20,-200,20}, {20,-200,120}, {120,-200,120}, {120,-200,20}};
+		vec2_t t[4] = {{0,0}, {1,0}, {1,1}, {0,1}};
+		renderer_batch_addQuad(textureScore, v, t);
+	}
+
+	//Start pad
+	{
+		vec3_t v[4] = {{2,-1,2}, {2,-1,-2}, {-2,-1,-2}, {-2,-1,2}};
+		vec2_t t[4] = {{0,0}, {1,0}, {1,1}, {0,1}};
+		renderer_batch_addQuad(textureBrick, v, t);
+	}
+
+	//Target platform
+	{
+		vec3_t v[4] = {{randx+size,-100,randz+size}, {randx+size,-100,randz-size},
+					   {randx-size,-100,randz-size}, {randx-size,-100,randz+size}};
+		vec2_t t[4] = {{0,0}, {size/4,0}, {size/4,size/4}, {0,size/4}};
+		renderer_batch_addQuad(textureBrick, v, t);
+	}
+
+	renderer_batch_build();
+}
+
 /*
  * r_setupProjection
  * Calculates the GL projection matrix. Only called once.
@@ -620,185 +1353,70 @@ static void r_setupModelview()
 }
 
 /*
- * r_setupModelview
- * Calculates the GL modelview matrix. Called each frame.
+ * r_drawSky
+ * Render queue callback, draws the sky with the camera's rotation-only matrix.
  */
-static void r_setupModelviewRotate()
+static void r_drawSky(int param)
 {
-//	glMultMatrixf(flipMatrix);
-	float sinX, cosX, sinY, cosY, sinZ, cosZ;
-
-	sinX = sin(-camera.angles_rad[_X]);
-	cosX = cos(-camera.angles_rad[_X]);
-
-	xRotMatrix[5]  = cosX;
-	xRotMatrix[6]  = sinX;
-	xRotMatrix[9]  = -sinX;
-	xRotMatrix[10] = cosX;
-
-	sinY = sin(-camera.angles_rad[_Y]);
-	cosY = cos(-camera.angles_rad[_Y]);
-
-	zRotMatrix[0]  =  cosY;
-	zRotMatrix[2]  = -sinY;
-	zRotMatrix[8]  =  sinY;
-	zRotMatrix[10] =  cosY;
-
-	sinZ = sin(-camera.angles_rad[_Z]);
-	cosZ = cos(-camera.angles_rad[_Z]);
-
-	yRotMatrix[0] = cosZ;
-	yRotMatrix[1] = sinZ;
-	yRotMatrix[4] = -sinZ;
-	yRotMatrix[5] = cosZ;
-
-	glMatrixMode(GL_MODELVIEW);
-	glLoadIdentity();
-//	glMultMatrixf(flipMatrix);
-	glMultMatrixf(xRotMatrix);
-	glMultMatrixf(yRotMatrix);
-	glMultMatrixf(zRotMatrix);
+	renderer_sky_draw(r_snapshot->rotMatrix);
 }
 
 /*
- * r_setupModelview
- * Calculates the GL modelview matrix. Called each frame.
+ * r_setupModelviewTranslate
+ * Loads the full camera view matrix from the snapshot.
  */
-static void r_setupModelviewTranslate()
+static void r_setupModelviewTranslate(sim_snapshot_t *snap)
 {
-	if (gravity==0 && (camera.position[_X]>2 || camera.position[_X]<-2 || camera.position[_Z]>2 || camera.position[_Z]<-2)) {
-		if (!hit) {
-			gravity = -0.05;
-		}
-	}
-	if (camera.position[_Y]<-99 && !(camera.position[_X]>randx+size || camera.position[_X]<randx-size || camera.position[_Z]>randz+size || camera.position[_Z]<randz-size)) {
-		if (!hit) {
-			gravity = 0;
-			points++;
-			won = 1;
-		}
-	}
-	if (camera.position[_Y]<-99) {
-		hit = 1;
-	}
-	if (camera.position[_Y]<-199 && gravity) {
-		lost = 1;
-	}
-	if (!lost) {
-		camera.position[_Y] += gravity;
-		translateMatrix[12] = -camera.position[_X];
-		translateMatrix[13] = -camera.position[_Y];
-		translateMatrix[14] = -camera.position[_Z];
-	}
 	glMatrixMode(GL_MODELVIEW);
-//	glMultMatrixf(flipMatrix);
-	glMultMatrixf(translateMatrix);
+	glLoadMatrixf(snap->viewMatrix);
 }
 
 /*
  * r_drawFrame
  * Perform any drawing and setup necessary to produce a single frame.
  */
-static void r_drawFrame()
+static void r_drawFrame(sim_snapshot_t *snap)
 {
+	static unsigned int lastFrameTicks = 0;
+	unsigned int now = SDL_GetTicks();
 
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	if(lastFrameTicks == 0)
+		lastFrameTicks = now;
 
-	r_setupModelviewRotate();
+	r_snapshot = snap;
 
-	glClear(GL_DEPTH_BUFFER_BIT);
+	renderer_profile_beginFrame();
+	renderer_img_updateTextures();
+	hotreload_poll();
+
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
     // Just in case we set all vertices to white.
     glColor4f(1,1,1,1);
 
-    glBindTexture(GL_TEXTURE_2D, textureStars);
-
-    // Render the front quad
-    glBegin(GL_QUADS);
-        glTexCoord2f(0, 0); glVertex3f(  1.0f, -1.0f, -1.0f );
-        glTexCoord2f(1, 0); glVertex3f( -1.0f, -1.0f, -1.0f );
-        glTexCoord2f(1, 1); glVertex3f( -1.0f,  1.0f, -1.0f );
-        glTexCoord2f(0, 1); glVertex3f(  1.0f,  1.0f, -1.0f );
-    glEnd();
-
-    // Render the left quad
-    glBegin(GL_QUADS);
-        glTexCoord2f(0, 0); glVertex3f(  1.0f, -1.0f,  1.0f );
-        glTexCoord2f(1, 0); glVertex3f(  1.0f, -1.0f, -1.0f );
-        glTexCoord2f(1, 1); glVertex3f(  1.0f,  1.0f, -1.0f );
-        glTexCoord2f(0, 1); glVertex3f(  1.0f,  1.0f,  1.0f );
-    glEnd();
-
-    // Render the back quad
-    glBegin(GL_QUADS);
-        glTexCoord2f(0, 0); glVertex3f( -1.0f, -1.0f,  1.0f );
-        glTexCoord2f(1, 0); glVertex3f(  1.0f, -1.0f,  1.0f );
-        glTexCoord2f(1, 1); glVertex3f(  1.0f,  1.0f,  1.0f );
-        glTexCoord2f(0, 1); glVertex3f( -1.0f,  1.0f,  1.0f );
-    glEnd();
-
-    // Render the right quad
-    glBegin(GL_QUADS);
-        glTexCoord2f(0, 0); glVertex3f( -1.0f, -1.0f, -1.0f );
-        glTexCoord2f(1, 0); glVertex3f( -1.0f, -1.0f,  1.0f );
-        glTexCoord2f(1, 1); glVertex3f( -1.0f,  1.0f,  1.0f );
-        glTexCoord2f(0, 1); glVertex3f( -1.0f,  1.0f, -1.0f );
-    glEnd();
-
-    // Render the top quad
-    glBegin(GL_QUADS);
-        glTexCoord2f(0, 1); glVertex3f( -1.0f,  1.0f, -1.0f );
-        glTexCoord2f(0, 0); glVertex3f( -1.0f,  1.0f,  1.0f );
-        glTexCoord2f(1, 0); glVertex3f(  1.0f,  1.0f,  1.0f );
-        glTexCoord2f(1, 1); glVertex3f(  1.0f,  1.0f, -1.0f );
-    glEnd();
-
-    // Render the bottom quad
-    glBegin(GL_QUADS);
-        glTexCoord2f(0, 0); glVertex3f( -1.0f, -1.0f, -1.0f );
-        glTexCoord2f(0, 1); glVertex3f( -1.0f, -1.0f,  1.0f );
-        glTexCoord2f(1, 1); glVertex3f(  1.0f, -1.0f,  1.0f );
-        glTexCoord2f(1, 0); glVertex3f(  1.0f, -1.0f, -1.0f );
-    glEnd();
-
-	glClear(GL_DEPTH_BUFFER_BIT);
-
-    r_setupModelviewTranslate();
-
-
-	renderer_model_drawASE(0);
-
-	glBindTexture(GL_TEXTURE_2D, textureLava);
-    glBegin(GL_QUADS);
-    glTexCoord2f(0,0); glVertex3f(200,-201,200);
-    glTexCoord2f(1,0); glVertex3f(200,-201,-200);
-    glTexCoord2f(1,1); glVertex3f(-200,-201,-200);
-    glTexCoord2f(0,1); glVertex3f(-200,-201,200);
-    glEnd();
-
-    glBindTexture(GL_TEXTURE_2D, textureScore);
-    glBegin(GL_QUADS);
-    glTexCoord2f(0,0); glVertex3f(20,-200,20);
-    glTexCoord2f(1,0); glVertex3f(20,-200,120);
-    glTexCoord2f(1,1); glVertex3f(120,-200,120);
-    glTexCoord2f(0,1); glVertex3f(120,-200,20);
-    glEnd();
-
-    glBindTexture(GL_TEXTURE_2D, textureBrick);
-
-    glBegin(GL_QUADS);
-    glTexCoord2f(0,0); glVertex3f(2,-1,2);
-    glTexCoord2f(1,0); glVertex3f(2,-1,-2);
-    glTexCoord2f(1,1); glVertex3f(-2,-1,-2);
-    glTexCoord2f(0,1); glVertex3f(-2,-1,2);
-    glEnd();
-
-    glBegin(GL_QUADS);
-    glTexCoord2f(0,0); glVertex3f(randx+size,-100,randz+size);
-    glTexCoord2f(size/4,0); glVertex3f(randx+size,-100,randz-size);
-    glTexCoord2f(size/4,size/4); glVertex3f(randx-size,-100,randz-size);
-    glTexCoord2f(0,size/4); glVertex3f(randx-size,-100,randz+size);
-    glEnd();
+    r_setupModelviewTranslate(snap);
+
+	world_update(snap->position);
+
+	renderer_queue_begin(snap->viewMatrix);
+
+	world_queue(snap->viewMatrix);
+
+	renderer_queue_setPass(PROFILE_PASS_STATIC);
+	renderer_batch_queue();
+
+	renderer_queue_setPass(PROFILE_PASS_PARTICLES);
+	renderer_particles_update((now - lastFrameTicks) / 1000.0f);
+	renderer_particles_queue();
+	lastFrameTicks = now;
+
+    //Sky sorts after the opaque world so it only fills what was left uncovered
+	renderer_queue_setPass(PROFILE_PASS_SKY);
+	renderer_queue_add(QUEUE_LAYER_SKY, efalse, 0, NULL, QUEUE_SOURCE_NONE, r_drawSky, 0);
+
+	renderer_queue_flush();
+
+	renderer_profile_mark(PROFILE_PASS_HUD);
 
 //	DrawOverlay();
 	r_setupModelview();
@@ -848,37 +1466,74 @@ static void r_drawFrame()
 //	glTexCoord2f(0, 1); glVertex3f(  0.0f, SQRT_2*-0.1f, -0.2f );
 //	glEnd();
 
+	renderer_profile_endFrame();
 
 	SDL_GL_SwapBuffers();
 }
 
+//Frames drawn for each view of r_occlusionTest, query results come back a
+//frame or more late. Up to OCCLUSION_TEST_WAIT frames are drawn first to
+//let the world's chunks stream in.
+#define OCCLUSION_TEST_FRAMES	30
+#define OCCLUSION_TEST_WAIT		600
+
 /*
- * renderer_img_createMaterial
+ * r_occlusionTest
+ * Draws frames from the start position looking down at the world, then up
+ * into the open sky, then down again, and checks the ASE occlusion counts
+ * of each view: objects drawn in the first, skipped once only sky is in
+ * view, and drawn again in the last. Needs nothing but a GL context, so it
+ * runs headless on Mesa's llvmpipe. Returns etrue if all three hold.
  */
-int renderer_img_createMaterial(char *name, vec3_t ambient, vec3_t diffuse, vec3_t specular,
-		float shine, float shineStrength, float transparency)
+static eboolean r_occlusionTest()
 {
-	material_t *currentMat = &materialList[stackPtr];
+	static const char	*views[3] = {"down", "up", "down again"};
+	static const float	pitch[3]  = {-60, 60, -60};
+	sim_snapshot_t		*snap;
+	double				drawn[4], occluded[4], queries[4];
+	eboolean			passed;
+	int					view, frame;
+
+	for(view = 0; view < 3; view++)
+	{
+		camera_setAngle(_X, pitch[view]);
+		sim_publish();
+		snap = (sim_snapshot_t *)sync_tripleRead(&snapshots);
 
-	currentMat->shine 			= shine;
-	currentMat->shineStrength 	= shineStrength;
-	currentMat->transparency 	= transparency;
+		if(snap->level != r_level)
+		{
+			r_roundReset(snap);
+			r_level = snap->level;
+		}
 
-	strcpy(currentMat->name, name);
+		//Until something is drawn, the volcano has not streamed in yet
+		for(frame = 0; view == 0 && frame < OCCLUSION_TEST_WAIT; frame++)
+		{
+			renderer_model_getOcclusionStats(&drawn[0], &occluded[0], &queries[0]);
+			if(drawn[0] > 0)
+				break;
 
-	VectorCopy(ambient,  currentMat->ambient);
-	VectorCopy(diffuse,  currentMat->diffuse);
-	VectorCopy(specular, currentMat->specular);
+			r_drawFrame(snap);
+		}
 
-	renderer_img_loadTGA(name, &(currentMat->glTexID),
-			&(currentMat->width), &(currentMat->height), &(currentMat->bpp));
-//	r_image_loadTGA(name, &(currentMat->glTexID),
-//			&(currentMat->width), &(currentMat->height), &(currentMat->bpp));
+		renderer_model_getOcclusionStats(&drawn[view], &occluded[view], &queries[view]);
 
-	return stackPtr++;
-}
+		for(frame = 0; frame < OCCLUSION_TEST_FRAMES; frame++)
+			r_drawFrame(snap);
+	}
+
+	renderer_model_getOcclusionStats(&drawn[3], &occluded[3], &queries[3]);
+
+	passed = drawn[1] > drawn[0] && occluded[2] > occluded[1] && drawn[3] > drawn[2];
+
+	printf("Occlusion test: %d frames per view, renderer %s.\n", OCCLUSION_TEST_FRAMES, glGetString(GL_RENDERER));
+	printf("  view           drawn  occluded  queries\n");
 
-int renderer_img_getMatGLID  (int i) { return materialList[i].glTexID; }
-int renderer_img_getMatWidth (int i) { return materialList[i].width;   }
-int renderer_img_getMatHeight(int i) { return materialList[i].height;  }
-int renderer_img_getMatBpp   (int i) { return materialList[i].bpp;     }
+	for(view = 0; view < 3; view++)
+		printf("  %-12s %7.0f %9.0f %8.0f\n", views[view], drawn[view+1] - drawn[view],
+				occluded[view+1] - occluded[view], queries[view+1] - queries[view]);
+
+	printf("Occlusion test %s.\n", passed ? "passed" : "FAILED");
+
+	return passed;
+}
@@ -0,0 +1,561 @@
+/*
+===========================================================================
+File:		renderer_anim.c
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+Description:	Node animation. At load time every node's keys are resampled
+				to one position, rotation and scale per scene frame, stored
+				structure-of-arrays: for each frame, each channel is a row
+				of floats across all nodes, padded to a multiple of four.
+				Sampling a time is then the same few operations for every
+				node, done four nodes at a time with SSE: lerp position and
+				scale, nlerp the rotation, build the matrix. Only parenting
+				and the bind pose inverse are applied per node afterwards.
+
+				Rotations are made sign-continuous from frame to frame when
+				the clip is built, so nlerp never has to check for the long
+				way round. Playback loops from the last frame to the first.
+===========================================================================
+*/
+
+#include <string.h>
+
+#include "renderer_anim.h"
+#include "system_memory.h"
+
+enum
+{
+	CH_PX, CH_PY, CH_PZ,
+	CH_QX, CH_QY, CH_QZ, CH_QW,
+	CH_SX, CH_SY, CH_SZ,
+	ANIM_CHANNELS
+};
+
+struct anim_clip_s
+{
+	int		numNodes, stride, numFrames;
+	float	frameSpeed;
+
+	float	*channels;			//[frame][channel][stride], 16 byte aligned
+	int		*parents;
+	mat4_t	*inverseBind;
+};
+
+#define ANIM_ROW(clip, frame, ch)	((clip)->channels + ((frame) * ANIM_CHANNELS + (ch)) * (clip)->stride)
+
+/*
+ * anim_invertAffine
+ * Inverse of a matrix with no projective part.
+ */
+static void anim_invertAffine(const mat4_t m, mat4_t out)
+{
+	mat4_t	r;
+	float	det, inv;
+
+	r[0]  = m[5] * m[10] - m[9] * m[6];
+	r[1]  = m[9] * m[2]  - m[1] * m[10];
+	r[2]  = m[1] * m[6]  - m[5] * m[2];
+	r[4]  = m[8] * m[6]  - m[4] * m[10];
+	r[5]  = m[0] * m[10] - m[8] * m[2];
+	r[6]  = m[4] * m[2]  - m[0] * m[6];
+	r[8]  = m[4] * m[9]  - m[8] * m[5];
+	r[9]  = m[8] * m[1]  - m[0] * m[9];
+	r[10] = m[0] * m[5]  - m[4] * m[1];
+
+	det = m[0] * r[0] + m[4] * r[1] + m[8] * r[2];
+
+	if(fabsf(det) < 1e-12f)
+	{
+		mat4_identity(out);
+		return;
+	}
+
+	inv = 1.0f / det;
+	r[0] *= inv; r[1] *= inv; r[2]  *= inv;
+	r[4] *= inv; r[5] *= inv; r[6]  *= inv;
+	r[8] *= inv; r[9] *= inv; r[10] *= inv;
+
+	r[12] = -(r[0] * m[12] + r[4] * m[13] + r[8]  * m[14]);
+	r[13] = -(r[1] * m[12] + r[5] * m[13] + r[9]  * m[14]);
+	r[14] = -(r[2] * m[12] + r[6] * m[13] + r[10] * m[14]);
+
+	r[3] = r[7] = r[11] = 0.0f;
+	r[15] = 1.0f;
+
+	memcpy(out, r, sizeof(mat4_t));
+}
+
+static void anim_quatMultiply(const vec4_t a, const vec4_t b, vec4_t out)
+{
+	vec4_t r;
+
+	r[0] = a[3] * b[0] + a[0] * b[3] + a[1] * b[2] - a[2] * b[1];
+	r[1] = a[3] * b[1] - a[0] * b[2] + a[1] * b[3] + a[2] * b[0];
+	r[2] = a[3] * b[2] + a[0] * b[1] - a[1] * b[0] + a[2] * b[3];
+	r[3] = a[3] * b[3] - a[0] * b[0] - a[1] * b[1] - a[2] * b[2];
+
+	memcpy(out, r, sizeof(vec4_t));
+}
+
+static void anim_quatNormalize(vec4_t q)
+{
+	float len = sqrtf(vec4_dot(q, q));
+
+	if(len < 1e-12f)
+	{
+		q[0] = q[1] = q[2] = 0.0f;
+		q[3] = 1.0f;
+		return;
+	}
+
+	q[0] /= len; q[1] /= len; q[2] /= len; q[3] /= len;
+}
+
+/*
+ * anim_decompose
+ * Splits an affine matrix into translation, rotation and per-axis scale.
+ * A mirrored matrix gets a negative x scale.
+ */
+static void anim_decompose(const mat4_t m, vec3_t pos, vec4_t q, vec3_t scale)
+{
+	float	r[9], s, trace;
+	int		c;
+
+	pos[0] = m[12];
+	pos[1] = m[13];
+	pos[2] = m[14];
+
+	scale[0] = sqrtf(m[0]*m[0] + m[1]*m[1] + m[2]*m[2]);
+	scale[1] = sqrtf(m[4]*m[4] + m[5]*m[5] + m[6]*m[6]);
+	scale[2] = sqrtf(m[8]*m[8] + m[9]*m[9] + m[10]*m[10]);
+
+	if(m[0] * (m[5]*m[10] - m[9]*m[6]) - m[4] * (m[1]*m[10] - m[9]*m[2]) + m[8] * (m[1]*m[6] - m[5]*m[2]) < 0.0f)
+		scale[0] = -scale[0];
+
+	//Rotation only, r[col*3+row]
+	for(c = 0; c < 3; c++)
+	{
+		s = fabsf(scale[c]) > 1e-12f ? 1.0f / scale[c] : 0.0f;
+		r[c*3+0] = m[c*4+0] * s;
+		r[c*3+1] = m[c*4+1] * s;
+		r[c*3+2] = m[c*4+2] * s;
+	}
+
+	trace = r[0] + r[4] + r[8];
+
+	if(trace > 0.0f)
+	{
+		s = sqrtf(trace + 1.0f) * 2.0f;
+		q[3] = 0.25f * s;
+		q[0] = (r[5] - r[7]) / s;
+		q[1] = (r[6] - r[2]) / s;
+		q[2] = (r[1] - r[3]) / s;
+	}
+	else if(r[0] > r[4] && r[0] > r[8])
+	{
+		s = sqrtf(1.0f + r[0] - r[4] - r[8]) * 2.0f;
+		q[3] = (r[5] - r[7]) / s;
+		q[0] = 0.25f * s;
+		q[1] = (r[3] + r[1]) / s;
+		q[2] = (r[6] + r[2]) / s;
+	}
+	else if(r[4] > r[8])
+	{
+		s = sqrtf(1.0f + r[4] - r[0] - r[8]) * 2.0f;
+		q[3] = (r[6] - r[2]) / s;
+		q[0] = (r[3] + r[1]) / s;
+		q[1] = 0.25f * s;
+		q[2] = (r[7] + r[5]) / s;
+	}
+	else
+	{
+		s = sqrtf(1.0f + r[8] - r[0] - r[4]) * 2.0f;
+		q[3] = (r[1] - r[3]) / s;
+		q[0] = (r[6] + r[2]) / s;
+		q[1] = (r[7] + r[5]) / s;
+		q[2] = 0.25f * s;
+	}
+
+	anim_quatNormalize(q);
+}
+
+/*
+ * anim_lerpKeys
+ * Keys are stride floats, the tick first and then size values. Holds the
+ * first and last key outside their range.
+ */
+static void anim_lerpKeys(const float *keys, int numKeys, int stride, int size, float tick, float *out)
+{
+	const float	*k0, *k1;
+	float		t;
+	int			i;
+
+	for(i = 0; i < numKeys - 1 && keys[(i+1) * stride] <= tick; i++)
+		;
+
+	k0 = &keys[i * stride];
+	k1 = (i + 1 < numKeys) ? k0 + stride : k0;
+	t  = (k1[0] > k0[0]) ? (tick - k0[0]) / (k1[0] - k0[0]) : 0.0f;
+
+	if(t < 0.0f)
+		t = 0.0f;
+
+	for(i = 1; i <= size; i++)
+		out[i-1] = k0[i] + t * (k1[i] - k0[i]);
+}
+
+static void anim_slerp(const vec4_t a, const vec4_t b, float t, vec4_t out)
+{
+	vec4_t	end;
+	float	d, theta, s, wa, wb;
+
+	d = vec4_dot(a, b);
+	memcpy(end, b, sizeof(vec4_t));
+
+	if(d < 0.0f)
+	{
+		d = -d;
+		end[0] = -end[0]; end[1] = -end[1]; end[2] = -end[2]; end[3] = -end[3];
+	}
+
+	if(d > 0.9995f)
+	{
+		wa = 1.0f - t;
+		wb = t;
+	}
+	else
+	{
+		theta = acosf(d);
+		s  = sinf(theta);
+		wa = sinf((1.0f - t) * theta) / s;
+		wb = sinf(t * theta) / s;
+	}
+
+	out[0] = wa * a[0] + wb * end[0];
+	out[1] = wa * a[1] + wb * end[1];
+	out[2] = wa * a[2] + wb * end[2];
+	out[3] = wa * a[3] + wb * end[3];
+
+	anim_quatNormalize(out);
+}
+
+/*
+ * anim_absoluteRotations
+ * Turns relative axis/angle keys into absolute quaternions, tick then xyzw.
+ * Max writes angles clockwise about the axis, hence the negation.
+ */
+static float * anim_absoluteRotations(const anim_node_t *node)
+{
+	float	*abs;
+	vec4_t	q = {0, 0, 0, 1}, dq;
+	vec3_t	axis;
+	float	half;
+	int		k;
+
+	abs = (float *)memory_alloc(MEMORY_TAG_ANIM, sizeof(float) * 5 * node->numRotKeys);
+
+	for(k = 0; k < node->numRotKeys; k++)
+	{
+		const float *key = &node->rotKeys[k * 5];
+
+		vec3_normalize(&key[1], axis);
+		half = -0.5f * key[4];
+		dq[0] = axis[0] * sinf(half);
+		dq[1] = axis[1] * sinf(half);
+		dq[2] = axis[2] * sinf(half);
+		dq[3] = cosf(half);
+
+		anim_quatMultiply(dq, q, q);
+		anim_quatNormalize(q);
+
+		abs[k*5] = key[0];
+		memcpy(&abs[k*5+1], q, sizeof(vec4_t));
+	}
+
+	return abs;
+}
+
+static void anim_sampleRotation(const float *abs, int numKeys, float tick, vec4_t out)
+{
+	int		i;
+	float	t;
+
+	for(i = 0; i < numKeys - 1 && abs[(i+1) * 5] <= tick; i++)
+		;
+
+	if(i + 1 >= numKeys || abs[(i+1) * 5] <= abs[i * 5])
+	{
+		memcpy(out, &abs[i*5+1], sizeof(vec4_t));
+		return;
+	}
+
+	t = (tick - abs[i * 5]) / (abs[(i+1) * 5] - abs[i * 5]);
+	anim_slerp(&abs[i*5+1], &abs[(i+1)*5+1], t < 0.0f ? 0.0f : t, out);
+}
+
+/*
+ * renderer_anim_build
+ * Resamples every node's keys to whole frames between firstFrame and
+ * lastFrame. Channels without keys hold the node's bind pose, relative to
+ * its parent.
+ */
+anim_clip_t * renderer_anim_build(const anim_node_t *nodes, int numNodes, int firstFrame, int lastFrame,
+		float frameSpeed, int ticksPerFrame)
+{
+	anim_clip_t			*clip;
+	const anim_node_t	*node;
+	mat4_t				local;
+	vec3_t				bindPos, bindScale, v;
+	vec4_t				bindRot, q, prev;
+	float				*abs, tick;
+	void				*mem;
+	int					n, f, c;
+
+	if(numNodes <= 0)
+		return NULL;
+
+	clip = (anim_clip_t *)memory_calloc(MEMORY_TAG_ANIM, 1, sizeof(anim_clip_t));
+	clip->numNodes	 = numNodes;
+	clip->stride	 = (numNodes + 3) & ~3;
+	clip->numFrames	 = lastFrame > firstFrame ? lastFrame - firstFrame + 1 : 1;
+	clip->frameSpeed = frameSpeed > 0.0f ? frameSpeed : 30.0f;
+
+	if(ticksPerFrame <= 0)
+		ticksPerFrame = 160;
+
+	if((mem = memory_alloc(MEMORY_TAG_ANIM, sizeof(float) * clip->numFrames * ANIM_CHANNELS * clip->stride)) == NULL)
+	{
+		memory_free(clip);
+		return NULL;
+	}
+
+	clip->channels	  = (float *)mem;
+	clip->parents	  = (int *)memory_alloc(MEMORY_TAG_ANIM, sizeof(int) * numNodes);
+	clip->inverseBind = (mat4_t *)memory_alloc(MEMORY_TAG_ANIM, sizeof(mat4_t) * numNodes);
+
+	//Padding lanes sample to an identity transform
+	for(f = 0; f < clip->numFrames; f++)
+		for(c = 0; c < ANIM_CHANNELS; c++)
+			for(n = numNodes; n < clip->stride; n++)
+				ANIM_ROW(clip, f, c)[n] = (c == CH_QW || c >= CH_SX) ? 1.0f : 0.0f;
+
+	for(n = 0; n < numNodes; n++)
+	{
+		node = &nodes[n];
+
+		clip->parents[n] = (node->parent >= 0 && node->parent < n) ? node->parent : -1;
+		anim_invertAffine(node->bind, clip->inverseBind[n]);
+
+		if(clip->parents[n] >= 0)
+			mat4_multiply(clip->inverseBind[clip->parents[n]], node->bind, local);
+		else
+			memcpy(local, node->bind, sizeof(mat4_t));
+
+		anim_decompose(local, bindPos, bindRot, bindScale);
+
+		abs = node->numRotKeys ? anim_absoluteRotations(node) : NULL;
+
+		for(f = 0; f < clip->numFrames; f++)
+		{
+			tick = (float)(firstFrame + f) * ticksPerFrame;
+
+			if(node->numPosKeys)
+				anim_lerpKeys(node->posKeys, node->numPosKeys, 4, 3, tick, v);
+			else
+				VectorCopy(bindPos, v);
+
+			ANIM_ROW(clip, f, CH_PX)[n] = v[0];
+			ANIM_ROW(clip, f, CH_PY)[n] = v[1];
+			ANIM_ROW(clip, f, CH_PZ)[n] = v[2];
+
+			if(abs != NULL)
+				anim_sampleRotation(abs, node->numRotKeys, tick, q);
+			else
+				memcpy(q, bindRot, sizeof(vec4_t));
+
+			//Keep neighbouring frames in the same hemisphere for nlerp
+			if(f > 0 && vec4_dot(q, prev) < 0.0f)
+			{
+				q[0] = -q[0]; q[1] = -q[1]; q[2] = -q[2]; q[3] = -q[3];
+			}
+			memcpy(prev, q, sizeof(vec4_t));
+
+			ANIM_ROW(clip, f, CH_QX)[n] = q[0];
+			ANIM_ROW(clip, f, CH_QY)[n] = q[1];
+			ANIM_ROW(clip, f, CH_QZ)[n] = q[2];
+			ANIM_ROW(clip, f, CH_QW)[n] = q[3];
+
+			if(node->numScaleKeys)
+				anim_lerpKeys(node->scaleKeys, node->numScaleKeys, 4, 3, tick, v);
+			else
+				VectorCopy(bindScale, v);
+
+			ANIM_ROW(clip, f, CH_SX)[n] = v[0];
+			ANIM_ROW(clip, f, CH_SY)[n] = v[1];
+			ANIM_ROW(clip, f, CH_SZ)[n] = v[2];
+		}
+
+		memory_free(abs);
+	}
+
+	return clip;
+}
+
+/*
+ * anim_storeLanes
+ * Scatters up to four nodes' local matrices from SoA rows into out.
+ */
+static void anim_storeLanes(const float rows[12][4], mat4_t *out, int count)
+{
+	static const int slot[12] = {0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14};
+	int lane, k;
+
+	for(lane = 0; lane < count; lane++)
+	{
+		for(k = 0; k < 12; k++)
+			out[lane][slot[k]] = rows[k][lane];
+
+		out[lane][3] = out[lane][7] = out[lane][11] = 0.0f;
+		out[lane][15] = 1.0f;
+	}
+}
+
+/*
+ * renderer_anim_sample
+ * Writes each node's transform at time seconds to out, numNodes matrices.
+ * Each maps the node's exported (bind pose) vertices to where they are at
+ * that time, so it goes straight onto the modelview in front of the mesh.
+ */
+void renderer_anim_sample(const anim_clip_t *clip, float seconds, mat4_t *out)
+{
+	const float	*a0, *a1;
+	float		frame, t, rows[12][4] __attribute__((aligned(16)));
+	int			f0, f1, i, stride;
+
+	stride = clip->stride;
+
+	frame = fmodf(seconds * clip->frameSpeed, (float)clip->numFrames);
+	if(frame < 0.0f)
+		frame += clip->numFrames;
+
+	f0 = (int)frame;
+	if(f0 >= clip->numFrames)
+		f0 = clip->numFrames - 1;
+
+	t  = frame - f0;
+	f1 = (f0 + 1 < clip->numFrames) ? f0 + 1 : 0;
+
+	a0 = ANIM_ROW(clip, f0, 0);
+	a1 = ANIM_ROW(clip, f1, 0);
+
+	for(i = 0; i < stride; i += 4)
+	{
+#ifdef VMATH_SSE
+		__m128 vt, one, half, p[3], q[4], s[3], len, r;
+		__m128 x2, y2, z2, xx, yy, zz, xy, xz, yz, wx, wy, wz;
+		int c;
+
+		vt	 = _mm_set1_ps(t);
+		one	 = _mm_set1_ps(1.0f);
+		half = _mm_set1_ps(0.5f);
+
+		for(c = 0; c < 3; c++)
+		{
+			__m128 b = _mm_load_ps(a0 + (CH_PX + c) * stride + i);
+			__m128 e = _mm_load_ps(a1 + (CH_PX + c) * stride + i);
+			p[c] = _mm_add_ps(b, _mm_mul_ps(vt, _mm_sub_ps(e, b)));
+
+			b = _mm_load_ps(a0 + (CH_SX + c) * stride + i);
+			e = _mm_load_ps(a1 + (CH_SX + c) * stride + i);
+			s[c] = _mm_add_ps(b, _mm_mul_ps(vt, _mm_sub_ps(e, b)));
+		}
+
+		for(c = 0; c < 4; c++)
+		{
+			__m128 b = _mm_load_ps(a0 + (CH_QX + c) * stride + i);
+			__m128 e = _mm_load_ps(a1 + (CH_QX + c) * stride + i);
+			q[c] = _mm_add_ps(b, _mm_mul_ps(vt, _mm_sub_ps(e, b)));
+		}
+
+		//nlerp: rsqrt estimate plus one Newton-Raphson step
+		len = _mm_add_ps(_mm_add_ps(_mm_mul_ps(q[0], q[0]), _mm_mul_ps(q[1], q[1])),
+						 _mm_add_ps(_mm_mul_ps(q[2], q[2]), _mm_mul_ps(q[3], q[3])));
+		r	= _mm_rsqrt_ps(len);
+		r	= _mm_mul_ps(r, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(_mm_mul_ps(half, len), _mm_mul_ps(r, r))));
+
+		for(c = 0; c < 4; c++)
+			q[c] = _mm_mul_ps(q[c], r);
+
+		x2 = _mm_add_ps(q[0], q[0]);
+		y2 = _mm_add_ps(q[1], q[1]);
+		z2 = _mm_add_ps(q[2], q[2]);
+		xx = _mm_mul_ps(q[0], x2); yy = _mm_mul_ps(q[1], y2); zz = _mm_mul_ps(q[2], z2);
+		xy = _mm_mul_ps(q[0], y2); xz = _mm_mul_ps(q[0], z2); yz = _mm_mul_ps(q[1], z2);
+		wx = _mm_mul_ps(q[3], x2); wy = _mm_mul_ps(q[3], y2); wz = _mm_mul_ps(q[3], z2);
+
+		_mm_store_ps(rows[0],  _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), s[0]));
+		_mm_store_ps(rows[1],  _mm_mul_ps(_mm_add_ps(xy, wz), s[0]));
+		_mm_store_ps(rows[2],  _mm_mul_ps(_mm_sub_ps(xz, wy), s[0]));
+		_mm_store_ps(rows[3],  _mm_mul_ps(_mm_sub_ps(xy, wz), s[1]));
+		_mm_store_ps(rows[4],  _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), s[1]));
+		_mm_store_ps(rows[5],  _mm_mul_ps(_mm_add_ps(yz, wx), s[1]));
+		_mm_store_ps(rows[6],  _mm_mul_ps(_mm_add_ps(xz, wy), s[2]));
+		_mm_store_ps(rows[7],  _mm_mul_ps(_mm_sub_ps(yz, wx), s[2]));
+		_mm_store_ps(rows[8],  _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), s[2]));
+		_mm_store_ps(rows[9],  p[0]);
+		_mm_store_ps(rows[10], p[1]);
+		_mm_store_ps(rows[11], p[2]);
+#else
+		int lane;
+
+		for(lane = 0; lane < 4; lane++)
+		{
+			float v[ANIM_CHANNELS], inv;
+			int c, k = i + lane;
+
+			for(c = 0; c < ANIM_CHANNELS; c++)
+				v[c] = a0[c * stride + k] + t * (a1[c * stride + k] - a0[c * stride + k]);
+
+			inv = 1.0f / sqrtf(v[CH_QX]*v[CH_QX] + v[CH_QY]*v[CH_QY] + v[CH_QZ]*v[CH_QZ] + v[CH_QW]*v[CH_QW]);
+			v[CH_QX] *= inv; v[CH_QY] *= inv; v[CH_QZ] *= inv; v[CH_QW] *= inv;
+
+			rows[0][lane]  = (1.0f - 2.0f * (v[CH_QY]*v[CH_QY] + v[CH_QZ]*v[CH_QZ])) * v[CH_SX];
+			rows[1][lane]  = 2.0f * (v[CH_QX]*v[CH_QY] + v[CH_QW]*v[CH_QZ]) * v[CH_SX];
+			rows[2][lane]  = 2.0f * (v[CH_QX]*v[CH_QZ] - v[CH_QW]*v[CH_QY]) * v[CH_SX];
+			rows[3][lane]  = 2.0f * (v[CH_QX]*v[CH_QY] - v[CH_QW]*v[CH_QZ]) * v[CH_SY];
+			rows[4][lane]  = (1.0f - 2.0f * (v[CH_QX]*v[CH_QX] + v[CH_QZ]*v[CH_QZ])) * v[CH_SY];
+			rows[5][lane]  = 2.0f * (v[CH_QY]*v[CH_QZ] + v[CH_QW]*v[CH_QX]) * v[CH_SY];
+			rows[6][lane]  = 2.0f * (v[CH_QX]*v[CH_QZ] + v[CH_QW]*v[CH_QY]) * v[CH_SZ];
+			rows[7][lane]  = 2.0f * (v[CH_QY]*v[CH_QZ] - v[CH_QW]*v[CH_QX]) * v[CH_SZ];
+			rows[8][lane]  = (1.0f - 2.0f * (v[CH_QX]*v[CH_QX] + v[CH_QY]*v[CH_QY])) * v[CH_SZ];
+			rows[9][lane]  = v[CH_PX];
+			rows[10][lane] = v[CH_PY];
+			rows[11][lane] = v[CH_PZ];
+		}
+#endif
+
+		anim_storeLanes((const float (*)[4])rows, out + i, clip->numNodes - i < 4 ? clip->numNodes - i : 4);
+	}
+
+	//Parents always come first, so their world transform is ready
+	for(i = 0; i < clip->numNodes; i++)
+		if(clip->parents[i] >= 0)
+			mat4_multiply(out[clip->parents[i]], out[i], out[i]);
+
+	for(i = 0; i < clip->numNodes; i++)
+		mat4_multiply(out[i], clip->inverseBind[i], out[i]);
+}
+
+/*
+ * renderer_anim_free
+ */
+void renderer_anim_free(anim_clip_t *clip)
+{
+	if(clip == NULL)
+		return;
+
+	memory_free(clip->channels);
+	memory_free(clip->parents);
+	memory_free(clip->inverseBind);
+	memory_free(clip);
+}
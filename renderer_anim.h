@@ -0,0 +1,34 @@
+/*
+===========================================================================
+File:		renderer_anim.h
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+===========================================================================
+*/
+
+#ifndef RENDERER_ANIM_H_
+#define RENDERER_ANIM_H_
+
+#include "common.h"
+#include "vmath.h"
+
+//One node's transform and keys as they come out of the file. Keys are
+//packed floats: tick x y z for position and scale, tick axis xyz angle for
+//rotation, each rotation relative to the key before it.
+typedef struct
+{
+	int		parent;				//node index, -1 for a root, lower than this node's
+	mat4_t	bind;				//world transform the mesh was exported in
+	int		numPosKeys, numRotKeys, numScaleKeys;
+	float	*posKeys, *rotKeys, *scaleKeys;
+}
+anim_node_t;
+
+typedef struct anim_clip_s anim_clip_t;
+
+anim_clip_t * renderer_anim_build(const anim_node_t *nodes, int numNodes, int firstFrame, int lastFrame,
+		float frameSpeed, int ticksPerFrame);
+void          renderer_anim_sample(const anim_clip_t *clip, float seconds, mat4_t *out);
+void          renderer_anim_free(anim_clip_t *clip);
+
+#endif /* RENDERER_ANIM_H_ */
@@ -0,0 +1,198 @@
+/*
+===========================================================================
+File:		renderer_batch.c
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+Description:	Static world geometry. Quads are collected once per level,
+				grouped by texture into a single vertex buffer, and then
+				drawn with one call per texture every frame.
+===========================================================================
+*/
+
+#define GL_GLEXT_PROTOTYPES
+
+#include <SDL/SDL_opengl.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "common.h"
+#include "renderer_batch.h"
+#include "renderer_queue.h"
+#include "system_memory.h"
+
+#define MAX_BATCH_RANGES 64
+
+typedef struct
+{
+	vec3_t	pos;
+	vec2_t	st;
+}
+batch_vertex_t;
+
+typedef struct
+{
+	int				glTexID;
+	batch_vertex_t	verts[4];
+}
+batch_quad_t;
+
+typedef struct
+{
+	int		glTexID;
+	GLint	first;
+	GLsizei	count;
+	vec3_t	center;
+}
+batch_range_t;
+
+static batch_quad_t		*quadList = NULL;
+static int				numQuads = 0, quadsAllocated = 0;
+
+static batch_range_t	rangeList[MAX_BATCH_RANGES];
+static int				numRanges = 0;
+
+static GLuint			batchBuffer = 0;
+static int				batchBytes = 0;
+static int				batchSource = -1;
+
+/*
+ * renderer_batch_clear
+ * Forgets the pending quads. The built buffer stays drawable until the next
+ * renderer_batch_build.
+ */
+void renderer_batch_clear()
+{
+	numQuads = 0;
+}
+
+/*
+ * renderer_batch_addQuad
+ */
+void renderer_batch_addQuad(int glTexID, vec3_t verts[4], vec2_t texCoords[4])
+{
+	batch_quad_t	*quad;
+	int				i;
+
+	if(numQuads >= quadsAllocated)
+	{
+		quadsAllocated = quadsAllocated ? quadsAllocated * 2 : 16;
+		quadList = (batch_quad_t *)memory_realloc(MEMORY_TAG_RENDERER, quadList, sizeof(batch_quad_t) * quadsAllocated);
+	}
+
+	quad = &quadList[numQuads++];
+	quad->glTexID = glTexID;
+
+	for(i = 0; i < 4; i++)
+	{
+		VectorCopy(verts[i], quad->verts[i].pos);
+		quad->verts[i].st[0] = texCoords[i][0];
+		quad->verts[i].st[1] = texCoords[i][1];
+	}
+}
+
+static int batch_compareQuads(const void *a, const void *b)
+{
+	const batch_quad_t *qa = (const batch_quad_t *)a, *qb = (const batch_quad_t *)b;
+
+	return qa->glTexID - qb->glTexID;
+}
+
+/*
+ * renderer_batch_build
+ * Sorts the pending quads by texture, splits each into two triangles and
+ * uploads everything as one static buffer. Only call when the level changes.
+ */
+void renderer_batch_build()
+{
+	static const int	triOrder[6] = {0, 1, 2, 0, 2, 3};
+	batch_vertex_t		*vertexData, *v;
+	int					i, j, bytes;
+
+	qsort(quadList, numQuads, sizeof(batch_quad_t), batch_compareQuads);
+
+	vertexData = v = (batch_vertex_t *)memory_alloc(MEMORY_TAG_RENDERER, sizeof(batch_vertex_t) * 6 * (numQuads ? numQuads : 1));
+	numRanges = 0;
+
+	for(i = 0; i < numQuads; i++)
+	{
+		if(numRanges == 0 || rangeList[numRanges-1].glTexID != quadList[i].glTexID)
+		{
+			if(numRanges == MAX_BATCH_RANGES)
+			{
+				printf("Static batch: more than %d textures, dropping the rest.\n", MAX_BATCH_RANGES);
+				break;
+			}
+
+			rangeList[numRanges].glTexID = quadList[i].glTexID;
+			rangeList[numRanges].first   = i * 6;
+			rangeList[numRanges].count   = 0;
+			VectorClear(rangeList[numRanges].center);
+			numRanges++;
+		}
+
+		for(j = 0; j < 6; j++)
+		{
+			*v = quadList[i].verts[triOrder[j]];
+			VectorAdd(rangeList[numRanges-1].center, v->pos, rangeList[numRanges-1].center);
+			v++;
+		}
+
+		rangeList[numRanges-1].count += 6;
+	}
+
+	for(i = 0; i < numRanges; i++)
+		VectorScale(rangeList[i].center, 1.0f / rangeList[i].count, rangeList[i].center);
+
+	if(!batchBuffer)
+	{
+		glGenBuffers(1, &batchBuffer);
+		memory_trackGPU(MEMORY_TAG_RENDERER, 0, 1);
+	}
+
+	bytes = sizeof(batch_vertex_t) * (v - vertexData);
+	memory_trackGPU(MEMORY_TAG_RENDERER, bytes - batchBytes, 0);
+	batchBytes = bytes;
+
+	glBindBuffer(GL_ARRAY_BUFFER, batchBuffer);
+	glBufferData(GL_ARRAY_BUFFER, batchBytes, vertexData, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	memory_free(vertexData);
+}
+
+static void batch_beginSource()
+{
+	glBindBuffer(GL_ARRAY_BUFFER, batchBuffer);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glVertexPointer(3, GL_FLOAT, sizeof(batch_vertex_t), (void *)offsetof(batch_vertex_t, pos));
+	glTexCoordPointer(2, GL_FLOAT, sizeof(batch_vertex_t), (void *)offsetof(batch_vertex_t, st));
+}
+
+static void batch_endSource()
+{
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+static void batch_drawRange(int range)
+{
+	glDrawArrays(GL_TRIANGLES, rangeList[range].first, rangeList[range].count);
+}
+
+/*
+ * renderer_batch_queue
+ * Submits one render queue item per texture range.
+ */
+void renderer_batch_queue()
+{
+	int i;
+
+	if(batchSource < 0)
+		batchSource = renderer_queue_addSource(batch_beginSource, batch_endSource);
+
+	for(i = 0; i < numRanges; i++)
+		renderer_queue_add(QUEUE_LAYER_WORLD, efalse, rangeList[i].glTexID, rangeList[i].center,
+				batchSource, batch_drawRange, i);
+}
@@ -0,0 +1,19 @@
+/*
+===========================================================================
+File:		renderer_batch.h
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+===========================================================================
+*/
+
+#ifndef RENDERER_BATCH_H_
+#define RENDERER_BATCH_H_
+
+#include "vmath.h"
+
+void renderer_batch_clear();
+void renderer_batch_addQuad(int glTexID, vec3_t verts[4], vec2_t texCoords[4]);
+void renderer_batch_build();
+void renderer_batch_queue();
+
+#endif /* RENDERER_BATCH_H_ */
@@ -0,0 +1,276 @@
+/*
+===========================================================================
+File:		renderer_materials.c
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+Description:	Material pool. Materials are referred to by handles that
+				pack a slot index with the slot's generation, which is
+				bumped every time the slot is released, so a handle kept
+				past its material's release is recognised instead of
+				reading whatever took the slot. Released slots go on a
+				free list.
+
+				Per draw lookups only need the texture and whether the
+				material is translucent, so those live in a small array of
+				their own, apart from the colours and sizes that are only
+				read at load time. Names are interned: a material stores a
+				pointer into one shared table, and reloading the same file
+				doesn't add its name again.
+===========================================================================
+*/
+
+#include <string.h>
+
+#include "renderer_materials.h"
+#include "system_memory.h"
+
+#define MAT_INDEX_BITS		9				//MAX_TEXTURES is 1 << MAT_INDEX_BITS
+#define MAT_INDEX_MASK		((1 << MAT_INDEX_BITS) - 1)
+#define MAT_NAME_SLOTS		(MAX_TEXTURES * 2)
+
+#define MAT_IN_USE			1
+#define MAT_TRANSLUCENT		2
+
+//Read every time a material is drawn or queued
+typedef struct
+{
+	int				glTexID;
+	unsigned short	generation;
+	unsigned short	flags;
+}
+material_hot_t;
+
+//Only read when materials are created, released or inspected
+typedef struct
+{
+	const char	*name;
+	vec3_t		ambient, diffuse, specular;
+	float		shine, shineStrength, transparency;
+	int			width, height, bpp;
+	int			nextFree;
+}
+material_cold_t;
+
+static material_hot_t	matHot[MAX_TEXTURES];
+static material_cold_t	matCold[MAX_TEXTURES];
+static int				matTop = 0, freeHead = -1;
+
+//Interned names. Strings are never freed, there are only as many as
+//distinct files were ever loaded.
+static char				*nameSlots[MAT_NAME_SLOTS];
+static unsigned int		numNames = 0, nameBytes = 0;
+
+static unsigned int		statLive = 0, statPeak = 0, statStale = 0;
+
+/*
+ * renderer_img_internName
+ * Returns the one shared copy of name, adding it if this is the first
+ * time it is seen. Falls back to "" once the table is full.
+ */
+static const char * renderer_img_internName(const char *name)
+{
+	unsigned int h = 2166136261u, slot;
+	const char *c;
+
+	for(c = name; *c; c++)
+	{
+		h ^= (byte)*c;
+		h *= 16777619u;
+	}
+
+	for(slot = h & (MAT_NAME_SLOTS - 1); nameSlots[slot] != NULL; slot = (slot + 1) & (MAT_NAME_SLOTS - 1))
+		if(!strcmp(nameSlots[slot], name))
+			return nameSlots[slot];
+
+	//Keep the table at most three quarters full so probes stay short
+	if(numNames >= MAT_NAME_SLOTS * 3 / 4)
+		return "";
+
+	nameSlots[slot] = memory_strdup(MEMORY_TAG_MATERIALS, name);
+	numNames++;
+	nameBytes += strlen(name) + 1;
+
+	return nameSlots[slot];
+}
+
+/*
+ * renderer_img_lookupMaterial
+ * Returns the slot a handle refers to, or -1 for a handle that was never
+ * valid or whose material has since been released.
+ */
+static int renderer_img_lookupMaterial(int handle)
+{
+	int index = handle & MAT_INDEX_MASK;
+
+	if(handle > 0 && index < matTop && (matHot[index].flags & MAT_IN_USE) &&
+	   matHot[index].generation == (unsigned int)handle >> MAT_INDEX_BITS)
+		return index;
+
+	if(handle != MATERIAL_NONE)
+		statStale++;
+
+	return -1;
+}
+
+/*
+ * renderer_img_createMaterial
+ */
+int renderer_img_createMaterial(char *name, vec3_t ambient, vec3_t diffuse, vec3_t specular,
+		float shine, float shineStrength, float transparency)
+{
+	int		width, height, bpp, handle;
+	byte	*imageData;
+
+	imageData = renderer_img_decodeTGA(name, &width, &height, &bpp);
+
+	handle = renderer_img_createMaterialFromImage(name, ambient, diffuse, specular,
+			shine, shineStrength, transparency, imageData, width, height, bpp);
+
+	memory_free(imageData);
+
+	return handle;
+}
+
+/*
+ * renderer_img_createMaterialFromImage
+ * Same as renderer_img_createMaterial, but with the texture already decoded
+ * (possibly on another thread). imageData may be NULL if decoding failed.
+ * Returns a handle, or MATERIAL_NONE when the pool is full.
+ */
+int renderer_img_createMaterialFromImage(char *name, vec3_t ambient, vec3_t diffuse, vec3_t specular,
+		float shine, float shineStrength, float transparency,
+		byte *imageData, int width, int height, int bpp)
+{
+	material_hot_t	*hot;
+	material_cold_t	*cold;
+	int				index;
+
+	if(freeHead >= 0)
+	{
+		index = freeHead;
+		freeHead = matCold[index].nextFree;
+	}
+	else if(matTop < MAX_TEXTURES)
+	{
+		index = matTop++;
+		matHot[index].generation = 1;
+	}
+	else
+	{
+		printf("Out of material slots, %s not created.\n", name);
+		return MATERIAL_NONE;
+	}
+
+	hot  = &matHot[index];
+	cold = &matCold[index];
+
+	memset(cold, 0, sizeof(material_cold_t));
+	hot->glTexID = 0;
+	hot->flags	 = MAT_IN_USE | (transparency > 0.0f ? MAT_TRANSLUCENT : 0);
+
+	cold->name			= renderer_img_internName(name);
+	cold->shine			= shine;
+	cold->shineStrength	= shineStrength;
+	cold->transparency	= transparency;
+	cold->nextFree		= -1;
+
+	VectorCopy(ambient,  cold->ambient);
+	VectorCopy(diffuse,  cold->diffuse);
+	VectorCopy(specular, cold->specular);
+
+	if(imageData)
+	{
+		hot->glTexID = renderer_img_uploadImage(imageData, width, height, bpp);
+		renderer_img_trackTexture(hot->glTexID, name, imageData, width, height, bpp);
+		cold->width	 = width;
+		cold->height = height;
+		cold->bpp	 = bpp;
+	}
+
+	if(++statLive > statPeak)
+		statPeak = statLive;
+
+	return (hot->generation << MAT_INDEX_BITS) | index;
+}
+
+/*
+ * renderer_img_releaseMaterial
+ * Deletes the material's texture and puts its slot on the free list. The
+ * handle, and every copy of it, is stale from here on.
+ */
+void renderer_img_releaseMaterial(int handle)
+{
+	int index;
+
+	if(handle == MATERIAL_NONE || (index = renderer_img_lookupMaterial(handle)) < 0)
+		return;
+
+	renderer_img_deleteTexture(matHot[index].glTexID);
+
+	matHot[index].glTexID = 0;
+	matHot[index].flags	  = 0;
+
+	//Generation 0 would make a handle of 0 for slot 0, skip it
+	if(++matHot[index].generation == 0)
+		matHot[index].generation = 1;
+
+	matCold[index].nextFree = freeHead;
+	freeHead = index;
+
+	statLive--;
+}
+
+/*
+ * Getters. A stale or invalid handle reads as an untextured, opaque,
+ * zero sized material.
+ */
+int renderer_img_getMatGLID(int handle)
+{
+	int index = renderer_img_lookupMaterial(handle);
+	return index < 0 ? 0 : matHot[index].glTexID;
+}
+
+eboolean renderer_img_isMatTranslucent(int handle)
+{
+	int index = renderer_img_lookupMaterial(handle);
+	return index < 0 ? efalse : (matHot[index].flags & MAT_TRANSLUCENT) != 0;
+}
+
+int renderer_img_getMatWidth(int handle)
+{
+	int index = renderer_img_lookupMaterial(handle);
+	return index < 0 ? 0 : matCold[index].width;
+}
+
+int renderer_img_getMatHeight(int handle)
+{
+	int index = renderer_img_lookupMaterial(handle);
+	return index < 0 ? 0 : matCold[index].height;
+}
+
+int renderer_img_getMatBpp(int handle)
+{
+	int index = renderer_img_lookupMaterial(handle);
+	return index < 0 ? 0 : matCold[index].bpp;
+}
+
+float renderer_img_getMatTransparency(int handle)
+{
+	int index = renderer_img_lookupMaterial(handle);
+	return index < 0 ? 0.0f : matCold[index].transparency;
+}
+
+const char * renderer_img_getMatName(int handle)
+{
+	int index = renderer_img_lookupMaterial(handle);
+	return index < 0 ? "" : matCold[index].name;
+}
+
+/*
+ * renderer_img_printMaterialStats
+ */
+void renderer_img_printMaterialStats()
+{
+	printf("Materials: %u live, %u peak of %d slots, %u stale handle lookups, %u names interned in %u bytes.\n",
+			statLive, statPeak, MAX_TEXTURES, statStale, numNames, nameBytes);
+}
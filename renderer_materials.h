@@ -10,16 +10,41 @@ Created on: Feb 19, 2011
 #define RENDERER_MATERIALS_H_
 
 #define MAX_TEXTURES 512
+#include "common.h"
 #include "vmath.h"
 
+//Materials are referred to by handle, see renderer_materials.c. No valid
+//handle is ever 0.
+#define MATERIAL_NONE 0
+
 int renderer_img_createMaterial(char *name, vec3_t ambient, vec3_t diffuse, vec3_t specular,
 		float shine, float shineStrength, float transparency);
+int renderer_img_createMaterialFromImage(char *name, vec3_t ambient, vec3_t diffuse, vec3_t specular,
+		float shine, float shineStrength, float transparency,
+		byte *imageData, int width, int height, int bpp);
+void renderer_img_releaseMaterial(int handle);
+void renderer_img_printMaterialStats();
+
+int          renderer_img_getMatGLID(int handle);
+eboolean     renderer_img_isMatTranslucent(int handle);
+int          renderer_img_getMatWidth(int handle);
+int          renderer_img_getMatHeight(int handle);
+int          renderer_img_getMatBpp(int handle);
+float        renderer_img_getMatTransparency(int handle);
+const char * renderer_img_getMatName(int handle);
 
-int renderer_img_getMatGLID(int i);
-int renderer_img_getMatWidth(int i);
-int renderer_img_getMatHeight(int i);
-int renderer_img_getMatBpp(int i);
+byte * renderer_img_decodeTGA(char *name, int *width, int *height, int *bpp);
+void   renderer_img_loadTGA(char *name, int *glTexID, int *width, int *height, int *bpp);
+int    renderer_img_uploadImage(byte *imageData, int width, int height, int bpp);
+void   renderer_img_updateImage(int glTexID, byte *imageData, int width, int height, int bpp);
 
-void renderer_img_loadTGA(char *name, int *glTexID, int *width, int *height, int *bpp);
+//Residency, see renderer_textures.c
+void renderer_img_trackTexture(int glTexID, char *name, byte *pixels, int width, int height, int bpp);
+void renderer_img_deleteTexture(int glTexID);
+void renderer_img_touchTexture(int glTexID);
+void renderer_img_updateTextures();
+int  renderer_img_reloadTexture(char *name);
+void renderer_img_setTextureBudget(unsigned int bytes);
+void renderer_img_printTextureStats();
 
 #endif /* RENDERER_MATERIALS_H_ */
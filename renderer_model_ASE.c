@@ -9,17 +9,47 @@ Notes:		Please remember that this is, for the moment, basically
 ===========================================================================
 */
 
+#define GL_GLEXT_PROTOTYPES
+
 #include <SDL/SDL_opengl.h>
 
 #include "common.h"
 #include "files.h"
 #include "vmath.h"
 
+#include "renderer_anim.h"
 #include "renderer_materials.h"
 #include "renderer_models.h"
+#include "renderer_queue.h"
+#include "system_jobs.h"
+#include "system_memory.h"
+
+//Geomobjects with at least this many faces are tested with an occlusion
+//query before drawing, smaller ones cost less to draw than to test
+#define ASE_OCCLUSION_MIN_FACES	64
+
+//A camera this close to a box is treated as inside it, the near plane
+//would otherwise clip the proxy away
+#define ASE_OCCLUSION_MARGIN	1.0f
+
+//Submaterials of one multi/sub-object material that get their own range,
+//face material IDs wrap around at this. The animated queue callback packs
+//model, object and submesh into one int, 8 bits are left for the submesh.
+#define ASE_MAX_SUBMESHES		256
+#define ASE_SUBMESH_PARAM(index, obj, sub)	(((index) << 24) | ((obj) << 8) | (sub))
 
-static void loadASE_parseTokens(char **tokens, int numTokens, eboolean collidable);
+//Estimate for a face in a display list, three vertices with a normal,
+//texcoord and position each
+#define ASE_LIST_FACE_BYTES		(3 * 9 * (int)sizeof(float))
+
+static void loadASE_parseTokens(ase_model_t *model, files_tokenStream_t *stream);
 static void loadASE_generateList(int index);
+static void loadASE_uploadToSlot(int index, ase_model_t *parsed);
+static void loadASE_freeModelData(ase_model_t *model);
+static void loadASE_decodeMaterial(void *param);
+static void loadASE_buildAnimation(ase_model_t *model);
+static void loadASE_bucketFaces(ase_model_t *model);
+static void loadASE_buildCollision(ase_model_t *model);
 
 /*
 ===========================================================================
@@ -52,12 +82,20 @@ typedef struct
 	char	falloff[MAX_NAMELENGTH], xpType[MAX_NAMELENGTH];
 
 	ase_mapDiffuse_t diffuseMap;
+
+	//Multi/sub-object materials, the submaterials follow the top level
+	//materials in the same list
+	int		firstSubMaterial, numSubMaterials;
+
+	//Decoded diffuse bitmap, filled in at parse time and consumed on upload
+	byte	*pixels;
+	int		width, height, bpp;
 }
 ase_material_t;
 
 typedef struct
 {
-	int				materialCount;
+	int				materialCount;		//top level and submaterials
 	ase_material_t	*list;
 }
 ase_materialList_t;
@@ -105,22 +143,64 @@ typedef struct
 }
 ase_mesh_t;
 
+//A run of an object's faces that share a material
+typedef struct
+{
+	int		materialRef;
+	int		firstFace, numFaces;		//range of the object's faceOrder
+}
+ase_subMesh_t;
+
 typedef struct
 {
 	char 		name[MAX_NAMELENGTH];
 	ase_mesh_t 	mesh;
 	int			materialRef;
+
+	//Faces grouped by submaterial at import. faceOrder is NULL when the
+	//whole object is one submesh in file order.
+	int				numSubMeshes;
+	ase_subMesh_t	*subMeshes;
+	int				*faceOrder;
+
+	//One list per submesh, starting at glListID. Faces only, no texture
+	//bind, so the render queue can share binds.
+	int			glListID;
+	vec3_t		center;
+
+	//Occlusion culling, query is 0 for objects too small to bother with
+	vec3_t		mins, maxs;
+	GLuint		query;
+	eboolean	queryPending, occluded;
+
+	//NODE_TM and TM_ANIMATION keys, baked into the model's clip after parsing
+	char		parentName[MAX_NAMELENGTH];
+	anim_node_t	node;
 }
 ase_geomObject_t;
 
-typedef struct
+struct ase_model_s
 {
+	eboolean			inUse;
+	char				name[MAX_FILEPATH];
+	eboolean			collidable;
 	int 				numObjects;
 	int					glListID;
 	ase_geomObject_t	*objects;
 	ase_materialList_t	materials;
-}
-ase_model_t;
+
+	//Packed triangles, 9 floats each, only for collidable models
+	int					numCollisionTris;
+	vec_t				*collisionTris;
+
+	//Scene timing from the header. anim is NULL unless some object has
+	//keys, nodeMatrices holds one transform per object from the last
+	//renderer_model_animateASE.
+	int					firstFrame, lastFrame, ticksPerFrame;
+	float				frameSpeed;
+	anim_clip_t			*anim;
+	mat4_t				*nodeMatrices;
+};
 
 //Debugging
 static void loadASE_printDiffuse(ase_mapDiffuse_t *diffuse);
@@ -134,375 +214,951 @@ static void loadASE_printMesh(ase_mesh_t *mesh);
 static void loadASE_printGeomObject(ase_geomObject_t *geomObject);
 static void loadASE_printModel(ase_model_t *model);
 
+static void loadASE_generateObjectList(ase_geomObject_t *object);
+
 static ase_model_t 	modelStack[MAX_MODELS];
 static int 			modelPtr = 0;
 
+static int			occlusionSource = -1;
+static double		statDrawn = 0, statOccluded = 0, statQueries = 0;
+
 /*
  * renderer_model_loadASE
+ * Parses and uploads in one go, returns the model index or -1.
+ */
+int renderer_model_loadASE(char *name, eboolean collidable)
+{
+	ase_model_t *model;
+
+	model = renderer_model_parseASE(name, collidable);
+
+	if(model == NULL)
+		return -1;
+
+	return renderer_model_uploadASE(model);
+}
+
+/*
+ * renderer_model_parseASE
+ * Reads and parses an ASE file and decodes its material bitmaps. Touches no
+ * GL or global state, so it is safe to run off the GL thread. The result
+ * goes to renderer_model_uploadASE or renderer_model_discardASE.
  */
-void renderer_model_loadASE(char *name, eboolean collidable)
+ase_model_t * renderer_model_parseASE(char *name, eboolean collidable)
 {
-	FILE 			*file;
-	unsigned int	fileSize;
-	char 			*fileBuffer, **tokens;
-	unsigned int	numTokens, blah;
+	files_tokenStream_t	*stream;
+	unsigned int		i;
+	ase_model_t			*model;
+	jobs_counter_t		decoded;
 
-	//Attempt to load the specified file
-	file = fopen(name, "r");
+	//Plain or gzipped, from the pack or a loose file, parsed as it is read
+	stream = files_openTokenStream(name);
 
-	if(file == NULL)
+	if(stream == NULL)
 	{
 		printf("Loading ASE: %s, failed. Null file pointer.\n", name);
-		return;
+		return NULL;
 	}
 
-	//Determine the size of the file
-	fseek(file, 0, SEEK_END);
-	fileSize = ftell(file);
-	rewind(file);
+	model = (ase_model_t *)memory_calloc(MEMORY_TAG_MODELS, 1, sizeof(ase_model_t));
+	strncpy(model->name, name, MAX_FILEPATH-1);
+	model->collidable = collidable;
+	loadASE_parseTokens(model, stream);
+	loadASE_bucketFaces(model);
+	loadASE_buildAnimation(model);
 
-	//If successful, load the file's contents into a buffer
-	fileBuffer = (char *)malloc(sizeof(char) * fileSize);
-	blah = fread(fileBuffer, sizeof(char), fileSize+1, file);
-	fileBuffer[blah] = '\0';
+	files_closeTokenStream(stream);
 
-	fclose(file);
+	//Decode the bitmaps here so the upload only has to hand pixels to GL,
+	//all of them at once on the job workers
+	jobs_initCounter(&decoded, NULL);
 
-	//Break the file into a new array of tokens
-	numTokens = files_tokenizeStr(fileBuffer, " \t\n\r\0", &tokens);
-	free(fileBuffer);
+	for(i = 0; i < (unsigned int)model->materials.materialCount; i++)
+		jobs_submit(&decoded, loadASE_decodeMaterial, &(model->materials.list[i]));
 
-	loadASE_parseTokens(tokens, numTokens, collidable);
+	//Potentially add triangles to collision list
+	if(collidable)
+		loadASE_buildCollision(model);
+
+	jobs_wait(&decoded);
+
+	return model;
 }
 
 /*
- * loadASE_parseTokens
+ * loadASE_buildCollision
+ * Packs every face of every object into collisionTris, 9 floats each.
+ */
+static void loadASE_buildCollision(ase_model_t *model)
+{
+	int					i, j;
+	ase_mesh_vertex_t	*vertexList;
+	ase_mesh_face_t		*faceList;
+	vec_t				*tri;
+
+	for(i = 0; i < model->numObjects; i++)
+		model->numCollisionTris += model->objects[i].mesh.numFaces;
+
+	model->collisionTris = tri = (vec_t *)memory_alloc(MEMORY_TAG_MODELS, sizeof(vec_t) * 9 * (model->numCollisionTris ? model->numCollisionTris : 1));
+
+	for(i = 0; i < model->numObjects; i++)
+	{
+		vertexList  = model->objects[i].mesh.vertexList;
+		faceList    = model->objects[i].mesh.faceList;
+
+		for(j = 0; j < model->objects[i].mesh.numFaces; j++, tri += 9)
+		{
+			VectorCopy(vertexList[faceList[j].A].coords, (tri+0));
+			VectorCopy(vertexList[faceList[j].B].coords, (tri+3));
+			VectorCopy(vertexList[faceList[j].C].coords, (tri+6));
+		}
+	}
+}
+
+/*
+ * renderer_model_loadCollisionASE
+ * Any thread, no GL. Reads only the geometry of a model and returns its
+ * faces packed 9 floats each, or NULL if it can't be read. The caller
+ * frees them with memory_free.
+ */
+vec_t * renderer_model_loadCollisionASE(char *name, int *numTris)
+{
+	files_tokenStream_t	*stream;
+	ase_model_t			*model;
+	vec_t				*tris;
+
+	*numTris = 0;
+
+	stream = files_openTokenStream(name);
+
+	if(stream == NULL)
+	{
+		printf("Loading ASE collision: %s, failed. Null file pointer.\n", name);
+		return NULL;
+	}
+
+	model = (ase_model_t *)memory_calloc(MEMORY_TAG_MODELS, 1, sizeof(ase_model_t));
+	strncpy(model->name, name, MAX_FILEPATH-1);
+	loadASE_parseTokens(model, stream);
+	files_closeTokenStream(stream);
+
+	loadASE_buildCollision(model);
+	tris	 = model->collisionTris;
+	*numTris = model->numCollisionTris;
+	model->collisionTris = NULL;
+
+	loadASE_freeModelData(model);
+	memory_free(model);
+
+	return tris;
+}
+
+/*
+ * renderer_model_takeCollisionASE
+ * Hands the collision triangles of a parsed, not yet uploaded, collidable
+ * model over to the caller, who frees them with memory_free. Returns NULL
+ * if it has none.
+ */
+vec_t * renderer_model_takeCollisionASE(ase_model_t *parsed, int *numTris)
+{
+	vec_t *tris;
+
+	*numTris = 0;
+
+	if(parsed == NULL)
+		return NULL;
+
+	tris	 = parsed->collisionTris;
+	*numTris = parsed->numCollisionTris;
+
+	parsed->collisionTris	 = NULL;
+	parsed->numCollisionTris = 0;
+
+	return tris;
+}
+
+/*
+ * loadASE_decodeMaterial
+ * Job. Decodes one material's diffuse bitmap into its pixels.
+ */
+static void loadASE_decodeMaterial(void *param)
+{
+	ase_material_t *mat = (ase_material_t *)param;
+
+	mat->pixels = renderer_img_decodeTGA(mat->diffuseMap.bitmap, &mat->width, &mat->height, &mat->bpp);
+}
+
+/*
+ * loadASE_buildAnimation
+ * Resolves parents by name and bakes the keys into a clip, if there are
+ * any. The raw keys aren't needed after that.
+ */
+static void loadASE_buildAnimation(ase_model_t *model)
+{
+	anim_node_t	*nodes;
+	eboolean	animated = efalse;
+	int			i, j;
+
+	for(i = 0; i < model->numObjects; i++)
+		if(model->objects[i].node.numPosKeys || model->objects[i].node.numRotKeys ||
+		   model->objects[i].node.numScaleKeys)
+			animated = etrue;
+
+	if(animated)
+	{
+		nodes = (anim_node_t *)memory_alloc(MEMORY_TAG_ANIM, sizeof(anim_node_t) * model->numObjects);
+
+		for(i = 0; i < model->numObjects; i++)
+		{
+			nodes[i] = model->objects[i].node;
+			nodes[i].parent = -1;
+
+			for(j = 0; j < i && model->objects[i].parentName[0]; j++)
+				if(!strcmp(model->objects[j].name, model->objects[i].parentName))
+					nodes[i].parent = j;
+		}
+
+		model->anim = renderer_anim_build(nodes, model->numObjects, model->firstFrame, model->lastFrame,
+				model->frameSpeed, model->ticksPerFrame);
+		memory_free(nodes);
+	}
+
+	if(model->anim != NULL)
+	{
+		model->nodeMatrices = (mat4_t *)memory_alloc(MEMORY_TAG_MODELS, sizeof(mat4_t) * model->numObjects);
+
+		for(i = 0; i < model->numObjects; i++)
+			mat4_identity(model->nodeMatrices[i]);
+	}
+
+	for(i = 0; i < model->numObjects; i++)
+	{
+		memory_free(model->objects[i].node.posKeys);
+		memory_free(model->objects[i].node.rotKeys);
+		memory_free(model->objects[i].node.scaleKeys);
+		memset(&(model->objects[i].node), 0, sizeof(anim_node_t));
+	}
+}
+
+/*
+ * renderer_model_uploadASE
+ * GL thread. Creates the materials and display lists for a parsed model and
+ * moves it into a free modelStack slot. Returns the index, or -1 if the
+ * stack is full (the model is discarded).
+ */
+int renderer_model_uploadASE(ase_model_t *parsed)
+{
+	int index;
+
+	for(index = 0; index < MAX_MODELS; index++)
+		if(!modelStack[index].inUse)
+			break;
+
+	if(index == MAX_MODELS)
+	{
+		printf("Loading ASE: out of model slots.\n");
+		renderer_model_discardASE(parsed);
+		return -1;
+	}
+
+	loadASE_uploadToSlot(index, parsed);
+
+	return index;
+}
+
+/*
+ * loadASE_uploadToSlot
+ * Moves a parsed model into modelStack[index], which must be free, and
+ * builds its materials and display lists.
+ */
+static void loadASE_uploadToSlot(int index, ase_model_t *parsed)
+{
+	int				i, j;
+	ase_model_t		*model;
+	ase_material_t	*mat;
+	ase_subMesh_t	*sub;
+
+	model = &(modelStack[index]);
+	*model = *parsed;
+	model->inUse = etrue;
+	memory_free(parsed);
+
+	if(index >= modelPtr)
+		modelPtr = index + 1;
+
+	//Create OpenGL textures from our materials, and store the global material indices
+	for(i = 0; i < model->materials.materialCount; i++)
+	{
+		mat = &(model->materials.list[i]);
+
+		mat->globalID = renderer_img_createMaterialFromImage(mat->diffuseMap.bitmap,
+				mat->ambient, mat->diffuse, mat->specular,
+				mat->shine, mat->shineStrength, mat->transparency,
+				mat->pixels, mat->width, mat->height, mat->bpp);
+
+		memory_free(mat->pixels);
+		mat->pixels = NULL;
+	}
+
+	//Correct the mesh's references to point to the global material
+	for(i = 0; i < model->numObjects; i++)
+	{
+		for(j = 0; j < model->objects[i].numSubMeshes; j++)
+		{
+			sub = &(model->objects[i].subMeshes[j]);
+			sub->materialRef = sub->materialRef < model->materials.materialCount ?
+					model->materials.list[sub->materialRef].globalID : MATERIAL_NONE;
+		}
+
+		model->objects[i].materialRef = model->materials.list[model->objects[i].materialRef].globalID;
+	}
+
+	//Each geomobject gets its own list, and the whole-model list just binds
+	//and calls them in order
+	for(i = 0; i < model->numObjects; i++)
+		loadASE_generateObjectList(&(model->objects[i]));
+
+	//Generate a display list for drawing
+	model->glListID = glGenLists(1);
+	memory_trackGPU(MEMORY_TAG_MODELS, 0, 1);
+	glNewList(model->glListID, GL_COMPILE);
+		loadASE_generateList(index);
+	glEndList();
+}
+
+/*
+ * renderer_model_reloadASE
+ * GL thread. Parses a changed file again and swaps it into every slot that
+ * was loaded from it, keeping the slot indices. A slot whose file no longer
+ * parses keeps the old model. Returns how many slots were replaced.
+ */
+int renderer_model_reloadASE(char *name)
+{
+	ase_model_t	*parsed;
+	int			index, count;
+
+	for(index = 0, count = 0; index < modelPtr; index++)
+	{
+		if(!modelStack[index].inUse || !files_sameBaseName(modelStack[index].name, name))
+			continue;
+
+		parsed = renderer_model_parseASE(modelStack[index].name, modelStack[index].collidable);
+
+		if(parsed == NULL || parsed->numObjects == 0)
+		{
+			renderer_model_discardASE(parsed);
+			continue;
+		}
+
+		renderer_model_freeASE(index);
+		loadASE_uploadToSlot(index, parsed);
+		count++;
+	}
+
+	return count;
+}
+
+/*
+ * renderer_model_discardASE
+ * Frees a parsed model that was never uploaded.
  */
-static void loadASE_parseTokens(char **tokens, int numTokens, eboolean collidable)
+void renderer_model_discardASE(ase_model_t *parsed)
 {
-	int i, j, curMatID, curObj, curFNormal, curVNormal;
+	int i;
+
+	if(parsed == NULL)
+		return;
+
+	for(i = 0; i < parsed->materials.materialCount; i++)
+		memory_free(parsed->materials.list[i].pixels);
+
+	loadASE_freeModelData(parsed);
+	memory_free(parsed);
+}
+
+/*
+ * renderer_model_freeASE
+ * GL thread. Releases an uploaded model's lists and materials and frees its
+ * slot for reuse.
+ */
+void renderer_model_freeASE(int index)
+{
+	int			i;
 	ase_model_t	*model;
-	ase_mesh_vertex_t *vertexList;
-	ase_mesh_face_t *faceList;
-	vec3_t tri[3];
 
-	model = &(modelStack[modelPtr]);
+	if(index < 0 || index >= MAX_MODELS || !modelStack[index].inUse)
+		return;
+
+	model = &(modelStack[index]);
+
+	for(i = 0; i < model->numObjects; i++)
+	{
+		glDeleteLists(model->objects[i].glListID, model->objects[i].numSubMeshes);
+		memory_trackGPU(MEMORY_TAG_MODELS, -model->objects[i].mesh.numFaces * ASE_LIST_FACE_BYTES,
+				-model->objects[i].numSubMeshes);
+
+		if(model->objects[i].query)
+			glDeleteQueries(1, &(model->objects[i].query));
+	}
+	glDeleteLists(model->glListID, 1);
+	memory_trackGPU(MEMORY_TAG_MODELS, 0, -1);
+
+	for(i = 0; i < model->materials.materialCount; i++)
+		renderer_img_releaseMaterial(model->materials.list[i].globalID);
 
-	for(i = 0; i < numTokens; i++)
+	loadASE_freeModelData(model);
+	memset(model, 0, sizeof(ase_model_t));
+}
+
+/*
+ * loadASE_freeModelData
+ */
+static void loadASE_freeModelData(ase_model_t *model)
+{
+	int i;
+
+	for(i = 0; i < model->numObjects; i++)
 	{
-		if(!strcmp(tokens[i], "*MATERIAL_COUNT"))
+		memory_free(model->objects[i].mesh.vertexList);
+		memory_free(model->objects[i].mesh.tvertList);
+		memory_free(model->objects[i].mesh.faceList);
+		memory_free(model->objects[i].mesh.tfaceList);
+		memory_free(model->objects[i].subMeshes);
+		memory_free(model->objects[i].faceOrder);
+		memory_free(model->objects[i].node.posKeys);
+		memory_free(model->objects[i].node.rotKeys);
+		memory_free(model->objects[i].node.scaleKeys);
+	}
+
+	memory_free(model->objects);
+	memory_free(model->materials.list);
+	memory_free(model->collisionTris);
+	memory_free(model->nodeMatrices);
+	renderer_anim_free(model->anim);
+}
+
+/*
+ * loadASE_next
+ * Next token, or an empty string past the end so a truncated file parses
+ * to zeros instead of crashing.
+ */
+static char * loadASE_next(files_tokenStream_t *stream)
+{
+	char *token = files_nextToken(stream);
+
+	return token != NULL ? token : "";
+}
+
+static void loadASE_skip(files_tokenStream_t *stream, int count)
+{
+	while(count-- > 0)
+		files_nextToken(stream);
+}
+
+/*
+ * loadASE_readKey
+ * Appends one animation key of size floats, the tick first.
+ */
+static void loadASE_readKey(files_tokenStream_t *stream, float **keys, int *numKeys, int size)
+{
+	int i;
+
+	//Capacity doubles whenever the count reaches a power of two
+	if((*numKeys & (*numKeys - 1)) == 0)
+		*keys = (float *)memory_realloc(MEMORY_TAG_ANIM, *keys, sizeof(float) * size * (*numKeys ? *numKeys * 2 : 1));
+
+	for(i = 0; i < size; i++)
+		(*keys)[*numKeys * size + i] = atof(loadASE_next(stream));
+
+	(*numKeys)++;
+}
+
+/*
+ * loadASE_parseTokens
+ */
+static void loadASE_parseTokens(ase_model_t *model, files_tokenStream_t *stream)
+{
+	int			j, curMatID = 0, curTopMatID = 0, curObj = 0, curFNormal, curVNormal;
+	char		*token;
+	ase_material_t	*parent;
+	anim_node_t	*node;
+	eboolean	inGeom = efalse;
+
+	while((token = files_nextToken(stream)) != NULL)
+	{
+		if(!strcmp(token, "*MATERIAL_COUNT"))
 		{
-			model->materials.materialCount = atoi(tokens[++i]);
+			model->materials.materialCount = atoi(loadASE_next(stream));
 
 			//Allocate enough space for the given number of materials.
-			model->materials.list = (ase_material_t *)malloc(sizeof(ase_material_t) * model->materials.materialCount);
+			model->materials.list = (ase_material_t *)memory_calloc(MEMORY_TAG_MATERIALS, model->materials.materialCount, sizeof(ase_material_t));
 		}
-		else if(!strcmp(tokens[i], "*MATERIAL"))
+		else if(!strcmp(token, "*MATERIAL"))
 		{
-			curMatID = atoi(tokens[++i]);
+			curMatID = curTopMatID = atoi(loadASE_next(stream));
 			model->materials.list[curMatID].id = curMatID;
 		}
-		else if(!strcmp(tokens[i], "*MATERIAL_NAME"))
-			strcpy(model->materials.list[curMatID].name, tokens[++i]);
-		else if(!strcmp(tokens[i], "*MATERIAL_CLASS"))
-			strcpy(model->materials.list[curMatID].class, tokens[++i]);
-		else if(!strcmp(tokens[i], "*MATERIAL_AMBIENT"))
-		{
-			model->materials.list[curMatID].ambient[_X] = atoi(tokens[++i]);
-			model->materials.list[curMatID].ambient[_Y] = atoi(tokens[++i]);
-			model->materials.list[curMatID].ambient[_Z] = atoi(tokens[++i]);
-		}
-		else if(!strcmp(tokens[i], "*MATERIAL_DIFFUSE"))
-		{
-			model->materials.list[curMatID].diffuse[_X] = atoi(tokens[++i]);
-			model->materials.list[curMatID].diffuse[_Y] = atoi(tokens[++i]);
-			model->materials.list[curMatID].diffuse[_Z] = atoi(tokens[++i]);
-		}
-		else if(!strcmp(tokens[i], "*MATERIAL_SPECULAR"))
-		{
-			model->materials.list[curMatID].specular[_X] = atoi(tokens[++i]);
-			model->materials.list[curMatID].specular[_Y] = atoi(tokens[++i]);
-			model->materials.list[curMatID].specular[_Z] = atoi(tokens[++i]);
-		}
-		else if(!strcmp(tokens[i], "*MATERIAL_SHINE"))
-			model->materials.list[curMatID].shine = atof(tokens[++i]);
-		else if(!strcmp(tokens[i], "*MATERIAL_SHINESTRENGTH"))
-			model->materials.list[curMatID].shineStrength = atof(tokens[++i]);
-		else if(!strcmp(tokens[i], "*MATERIAL_TRANSPARENCY"))
-			model->materials.list[curMatID].transparency = atof(tokens[++i]);
-		else if(!strcmp(tokens[i], "*MATERIAL_WIRESIZE"))
-			model->materials.list[curMatID].wireSize = atof(tokens[++i]);
-		else if(!strcmp(tokens[i], "*MATERIAL_SHADING"))
-			strcpy(model->materials.list[curMatID].shading, tokens[++i]);
-		else if(!strcmp(tokens[i], "*MATERIAL_XP_FALLOFF"))
-			model->materials.list[curMatID].xpFalloff = atof(tokens[++i]);
-		else if(!strcmp(tokens[i], "*MATERIAL_SELFILLUM"))
-			model->materials.list[curMatID].selfIllum = atof(tokens[++i]);
-		else if(!strcmp(tokens[i], "*MATERIAL_FALLOFF"))
-			strcpy(model->materials.list[curMatID].falloff, tokens[++i]);
-		else if(!strcmp(tokens[i], "*MATERIAL_XP_TYPE"))
-			strcpy(model->materials.list[curMatID].xpType, tokens[++i]);
-
-		else if(!strcmp(tokens[i], "*MAP_NAME"))
-			strcpy(model->materials.list[curMatID].diffuseMap.name, tokens[++i]);
-		else if(!strcmp(tokens[i], "*MAP_CLASS"))
-			strcpy(model->materials.list[curMatID].diffuseMap.class, tokens[++i]);
-		else if(!strcmp(tokens[i], "*MAP_SUBNO"))
-			model->materials.list[curMatID].diffuseMap.subNo = atoi(tokens[++i]);
-		else if(!strcmp(tokens[i], "*MAP_AMOUNT"))
-			model->materials.list[curMatID].diffuseMap.amount = atof(tokens[++i]);
-		else if(!strcmp(tokens[i], "*BITMAP"))
-			strcpy(model->materials.list[curMatID].diffuseMap.bitmap, tokens[++i]);
-		else if(!strcmp(tokens[i], "*MAP_TYPE"))
-			strcpy(model->materials.list[curMatID].diffuseMap.type, tokens[++i]);
-		else if(!strcmp(tokens[i], "*UVW_U_OFFSET"))
-			model->materials.list[curMatID].diffuseMap.uvw_uOffset = atof(tokens[++i]);
-		else if(!strcmp(tokens[i], "*UVW_V_OFFSET"))
-			model->materials.list[curMatID].diffuseMap.uvw_vOffset = atof(tokens[++i]);
-		else if(!strcmp(tokens[i], "*UVW_U_TILING"))
-			model->materials.list[curMatID].diffuseMap.uvw_uTiling = atof(tokens[++i]);
-		else if(!strcmp(tokens[i], "*UVW_V_TILING"))
-			model->materials.list[curMatID].diffuseMap.uvw_vTiling = atof(tokens[++i]);
-		else if(!strcmp(tokens[i], "*UVW_ANGLE"))
-			model->materials.list[curMatID].diffuseMap.uvw_angle = atof(tokens[++i]);
-		else if(!strcmp(tokens[i], "*UVW_BLUR"))
-			model->materials.list[curMatID].diffuseMap.uvw_blur = atof(tokens[++i]);
-		else if(!strcmp(tokens[i], "*UVW_BLUR_OFFSET"))
-			model->materials.list[curMatID].diffuseMap.uvw_blurOffset = atof(tokens[++i]);
+		//Submaterials are appended to the list and indexed from their top
+		//level material. Multi materials nested inside submaterials are
+		//not supported, their submaterials are read into the submaterial.
+		else if(!strcmp(token, "*NUMSUBMTLS") && curMatID == curTopMatID)
+		{
+			j = atoi(loadASE_next(stream));
+			j = j < 0 ? 0 : j > ASE_MAX_SUBMESHES ? ASE_MAX_SUBMESHES : j;
+
+			model->materials.list = (ase_material_t *)memory_realloc(MEMORY_TAG_MATERIALS, model->materials.list,
+					sizeof(ase_material_t) * (model->materials.materialCount + j));
+			memset(&(model->materials.list[model->materials.materialCount]), 0, sizeof(ase_material_t) * j);
+
+			parent = &(model->materials.list[curTopMatID]);
+			parent->firstSubMaterial = model->materials.materialCount;
+			parent->numSubMaterials  = j;
+			model->materials.materialCount += j;
+		}
+		else if(!strcmp(token, "*SUBMATERIAL"))
+		{
+			parent = &(model->materials.list[curTopMatID]);
+			j = atoi(loadASE_next(stream));
+
+			if(j >= 0 && j < parent->numSubMaterials)
+			{
+				curMatID = parent->firstSubMaterial + j;
+				model->materials.list[curMatID].id = curMatID;
+			}
+		}
+		else if(!strcmp(token, "*MATERIAL_NAME"))
+			strcpy(model->materials.list[curMatID].name, loadASE_next(stream));
+		else if(!strcmp(token, "*MATERIAL_CLASS"))
+			strcpy(model->materials.list[curMatID].class, loadASE_next(stream));
+		else if(!strcmp(token, "*MATERIAL_AMBIENT"))
+		{
+			model->materials.list[curMatID].ambient[_X] = atoi(loadASE_next(stream));
+			model->materials.list[curMatID].ambient[_Y] = atoi(loadASE_next(stream));
+			model->materials.list[curMatID].ambient[_Z] = atoi(loadASE_next(stream));
+		}
+		else if(!strcmp(token, "*MATERIAL_DIFFUSE"))
+		{
+			model->materials.list[curMatID].diffuse[_X] = atoi(loadASE_next(stream));
+			model->materials.list[curMatID].diffuse[_Y] = atoi(loadASE_next(stream));
+			model->materials.list[curMatID].diffuse[_Z] = atoi(loadASE_next(stream));
+		}
+		else if(!strcmp(token, "*MATERIAL_SPECULAR"))
+		{
+			model->materials.list[curMatID].specular[_X] = atoi(loadASE_next(stream));
+			model->materials.list[curMatID].specular[_Y] = atoi(loadASE_next(stream));
+			model->materials.list[curMatID].specular[_Z] = atoi(loadASE_next(stream));
+		}
+		else if(!strcmp(token, "*MATERIAL_SHINE"))
+			model->materials.list[curMatID].shine = atof(loadASE_next(stream));
+		else if(!strcmp(token, "*MATERIAL_SHINESTRENGTH"))
+			model->materials.list[curMatID].shineStrength = atof(loadASE_next(stream));
+		else if(!strcmp(token, "*MATERIAL_TRANSPARENCY"))
+			model->materials.list[curMatID].transparency = atof(loadASE_next(stream));
+		else if(!strcmp(token, "*MATERIAL_WIRESIZE"))
+			model->materials.list[curMatID].wireSize = atof(loadASE_next(stream));
+		else if(!strcmp(token, "*MATERIAL_SHADING"))
+			strcpy(model->materials.list[curMatID].shading, loadASE_next(stream));
+		else if(!strcmp(token, "*MATERIAL_XP_FALLOFF"))
+			model->materials.list[curMatID].xpFalloff = atof(loadASE_next(stream));
+		else if(!strcmp(token, "*MATERIAL_SELFILLUM"))
+			model->materials.list[curMatID].selfIllum = atof(loadASE_next(stream));
+		else if(!strcmp(token, "*MATERIAL_FALLOFF"))
+			strcpy(model->materials.list[curMatID].falloff, loadASE_next(stream));
+		else if(!strcmp(token, "*MATERIAL_XP_TYPE"))
+			strcpy(model->materials.list[curMatID].xpType, loadASE_next(stream));
+
+		else if(!strcmp(token, "*MAP_NAME"))
+			strcpy(model->materials.list[curMatID].diffuseMap.name, loadASE_next(stream));
+		else if(!strcmp(token, "*MAP_CLASS"))
+			strcpy(model->materials.list[curMatID].diffuseMap.class, loadASE_next(stream));
+		else if(!strcmp(token, "*MAP_SUBNO"))
+			model->materials.list[curMatID].diffuseMap.subNo = atoi(loadASE_next(stream));
+		else if(!strcmp(token, "*MAP_AMOUNT"))
+			model->materials.list[curMatID].diffuseMap.amount = atof(loadASE_next(stream));
+		else if(!strcmp(token, "*BITMAP"))
+			strcpy(model->materials.list[curMatID].diffuseMap.bitmap, loadASE_next(stream));
+		else if(!strcmp(token, "*MAP_TYPE"))
+			strcpy(model->materials.list[curMatID].diffuseMap.type, loadASE_next(stream));
+		else if(!strcmp(token, "*UVW_U_OFFSET"))
+			model->materials.list[curMatID].diffuseMap.uvw_uOffset = atof(loadASE_next(stream));
+		else if(!strcmp(token, "*UVW_V_OFFSET"))
+			model->materials.list[curMatID].diffuseMap.uvw_vOffset = atof(loadASE_next(stream));
+		else if(!strcmp(token, "*UVW_U_TILING"))
+			model->materials.list[curMatID].diffuseMap.uvw_uTiling = atof(loadASE_next(stream));
+		else if(!strcmp(token, "*UVW_V_TILING"))
+			model->materials.list[curMatID].diffuseMap.uvw_vTiling = atof(loadASE_next(stream));
+		else if(!strcmp(token, "*UVW_ANGLE"))
+			model->materials.list[curMatID].diffuseMap.uvw_angle = atof(loadASE_next(stream));
+		else if(!strcmp(token, "*UVW_BLUR"))
+			model->materials.list[curMatID].diffuseMap.uvw_blur = atof(loadASE_next(stream));
+		else if(!strcmp(token, "*UVW_BLUR_OFFSET"))
+			model->materials.list[curMatID].diffuseMap.uvw_blurOffset = atof(loadASE_next(stream));
 		//TYPO in the exporter!!!!!!
-		else if(!strcmp(tokens[i], "*UVW_NOUSE_AMT"))
-			model->materials.list[curMatID].diffuseMap.uvw_noiseAmt = atof(tokens[++i]);
-		else if(!strcmp(tokens[i], "*UVW_NOISE_SIZE"))
-			model->materials.list[curMatID].diffuseMap.uvw_noiseSize = atof(tokens[++i]);
-		else if(!strcmp(tokens[i], "*UVW_NOISE_LEVEL"))
-			model->materials.list[curMatID].diffuseMap.uvw_noiseLevel = atof(tokens[++i]);
-		else if(!strcmp(tokens[i], "*UVW_NOISE_PHASE"))
-			model->materials.list[curMatID].diffuseMap.uvw_noisePhase = atof(tokens[++i]);
-		else if(!strcmp(tokens[i], "*BITMAP_FILTER"))
-			strcpy(model->materials.list[curMatID].diffuseMap.bitmapFilter, tokens[++i]);
-
-		else if(!strcmp(tokens[i], "*GEOMOBJECT"))
+		else if(!strcmp(token, "*UVW_NOUSE_AMT"))
+			model->materials.list[curMatID].diffuseMap.uvw_noiseAmt = atof(loadASE_next(stream));
+		else if(!strcmp(token, "*UVW_NOISE_SIZE"))
+			model->materials.list[curMatID].diffuseMap.uvw_noiseSize = atof(loadASE_next(stream));
+		else if(!strcmp(token, "*UVW_NOISE_LEVEL"))
+			model->materials.list[curMatID].diffuseMap.uvw_noiseLevel = atof(loadASE_next(stream));
+		else if(!strcmp(token, "*UVW_NOISE_PHASE"))
+			model->materials.list[curMatID].diffuseMap.uvw_noisePhase = atof(loadASE_next(stream));
+		else if(!strcmp(token, "*BITMAP_FILTER"))
+			strcpy(model->materials.list[curMatID].diffuseMap.bitmapFilter, loadASE_next(stream));
+
+		else if(!strcmp(token, "*GEOMOBJECT"))
 		{
 			model->numObjects++;
-			model->objects = (ase_geomObject_t *)realloc(model->objects, sizeof(ase_geomObject_t) * model->numObjects);
+			model->objects = (ase_geomObject_t *)memory_realloc(MEMORY_TAG_MODELS, model->objects, sizeof(ase_geomObject_t) * model->numObjects);
 			curObj = model->numObjects - 1;
+			memset(&(model->objects[curObj]), 0, sizeof(ase_geomObject_t));
+			mat4_identity(model->objects[curObj].node.bind);
+			inGeom = etrue;
+		}
+		else if(!strcmp(token, "*HELPEROBJECT") || !strcmp(token, "*SHAPEOBJECT") ||
+				!strcmp(token, "*CAMERAOBJECT") || !strcmp(token, "*LIGHTOBJECT"))
+			inGeom = efalse;
+
+		else if(!strcmp(token, "*SCENE_FIRSTFRAME"))
+			model->firstFrame = atoi(loadASE_next(stream));
+		else if(!strcmp(token, "*SCENE_LASTFRAME"))
+			model->lastFrame = atoi(loadASE_next(stream));
+		else if(!strcmp(token, "*SCENE_FRAMESPEED"))
+			model->frameSpeed = atof(loadASE_next(stream));
+		else if(!strcmp(token, "*SCENE_TICKSPERFRAME"))
+			model->ticksPerFrame = atoi(loadASE_next(stream));
+
+		//Node transform and animation, only kept for geomobjects
+		else if(inGeom && !strcmp(token, "*NODE_PARENT"))
+			strcpy(model->objects[curObj].parentName, loadASE_next(stream));
+		else if(inGeom && !strncmp(token, "*TM_ROW", 7) && token[7] >= '0' && token[7] <= '3' && !token[8])
+		{
+			//token is only good until the next read
+			j = (token[7] - '0') * 4;
+			node = &(model->objects[curObj].node);
+			node->bind[j + 0] = atof(loadASE_next(stream));
+			node->bind[j + 1] = atof(loadASE_next(stream));
+			node->bind[j + 2] = atof(loadASE_next(stream));
 		}
-		else if(!strcmp(tokens[i], "*NODE_NAME"))
-			strcpy(model->objects[curObj].name, tokens[++i]);
-		else if(!strcmp(tokens[i], "*MESH_NUMVERTEX"))
+		else if(inGeom && (!strcmp(token, "*CONTROL_POS_SAMPLE") || !strcmp(token, "*CONTROL_TCB_POS_KEY") ||
+				!strcmp(token, "*CONTROL_BEZIER_POS_KEY")))
 		{
-			model->objects[curObj].mesh.numVertex = atoi(tokens[++i]);
+			node = &(model->objects[curObj].node);
+			loadASE_readKey(stream, &node->posKeys, &node->numPosKeys, 4);
+		}
+		else if(inGeom && (!strcmp(token, "*CONTROL_ROT_SAMPLE") || !strcmp(token, "*CONTROL_TCB_ROT_KEY")))
+		{
+			node = &(model->objects[curObj].node);
+			loadASE_readKey(stream, &node->rotKeys, &node->numRotKeys, 5);
+		}
+		else if(inGeom && (!strcmp(token, "*CONTROL_SCALE_SAMPLE") || !strcmp(token, "*CONTROL_TCB_SCALE_KEY") ||
+				!strcmp(token, "*CONTROL_BEZIER_SCALE_KEY")))
+		{
+			node = &(model->objects[curObj].node);
+			loadASE_readKey(stream, &node->scaleKeys, &node->numScaleKeys, 4);
+		}
+		else if(inGeom && !strcmp(token, "*NODE_NAME"))
+			strcpy(model->objects[curObj].name, loadASE_next(stream));
+		else if(!strcmp(token, "*MESH_NUMVERTEX"))
+		{
+			model->objects[curObj].mesh.numVertex = atoi(loadASE_next(stream));
 			model->objects[curObj].mesh.vertexList =
-					(ase_mesh_vertex_t *)malloc(sizeof(ase_mesh_vertex_t) * model->objects[curObj].mesh.numVertex);
+					(ase_mesh_vertex_t *)memory_alloc(MEMORY_TAG_MODELS, sizeof(ase_mesh_vertex_t) * model->objects[curObj].mesh.numVertex);
 		}
-		else if(!strcmp(tokens[i], "*MESH_NUMFACES"))
+		else if(!strcmp(token, "*MESH_NUMFACES"))
 		{
-			model->objects[curObj].mesh.numFaces = atoi(tokens[++i]);
+			model->objects[curObj].mesh.numFaces = atoi(loadASE_next(stream));
 			model->objects[curObj].mesh.faceList =
-					(ase_mesh_face_t *)malloc(sizeof(ase_mesh_face_t) * model->objects[curObj].mesh.numFaces);
+					(ase_mesh_face_t *)memory_alloc(MEMORY_TAG_MODELS, sizeof(ase_mesh_face_t) * model->objects[curObj].mesh.numFaces);
 		}
-		else if(!strcmp(tokens[i], "*MESH_VERTEX_LIST"))
+		else if(!strcmp(token, "*MESH_VERTEX_LIST"))
 		{
-			//Skip *MESH_VERTEX_LIST and {
-			i += 2;
+			//Skip {, the stream is already past *MESH_VERTEX_LIST
+			loadASE_skip(stream, 1);
 
 			for(j = 0; j < model->objects[curObj].mesh.numVertex; j++)
 			{
 				//Skip *MESH_VERTEX
-				i++;
+				loadASE_skip(stream, 1);
 
-				model->objects[curObj].mesh.vertexList[j].vertexID   = atoi(tokens[i++]);
-				model->objects[curObj].mesh.vertexList[j].coords[_X] = atof(tokens[i++]);
-				model->objects[curObj].mesh.vertexList[j].coords[_Y] = atof(tokens[i++]);
-				model->objects[curObj].mesh.vertexList[j].coords[_Z] = atof(tokens[i++]);
+				model->objects[curObj].mesh.vertexList[j].vertexID   = atoi(loadASE_next(stream));
+				model->objects[curObj].mesh.vertexList[j].coords[_X] = atof(loadASE_next(stream));
+				model->objects[curObj].mesh.vertexList[j].coords[_Y] = atof(loadASE_next(stream));
+				model->objects[curObj].mesh.vertexList[j].coords[_Z] = atof(loadASE_next(stream));
 			}
 		}
-		else if(!strcmp(tokens[i], "*MESH_FACE_LIST"))
+		else if(!strcmp(token, "*MESH_FACE_LIST"))
 		{
-			//Skip *MESH_FACE_LIST and {
-			i += 2;
+			//Skip {, the stream is already past *MESH_FACE_LIST
+			loadASE_skip(stream, 1);
 
 			for(j = 0; j < model->objects[curObj].mesh.numFaces; j++)
 			{
 				//Skip *MESH_FACE and #:
-				i += 2;
+				loadASE_skip(stream, 2);
 
 				model->objects[curObj].mesh.faceList[j].faceID = j;
 
 				//Skip A:
-				i++; model->objects[curObj].mesh.faceList[j].A = atoi(tokens[i++]);
+				loadASE_skip(stream, 1); model->objects[curObj].mesh.faceList[j].A = atoi(loadASE_next(stream));
 				//Skip B:
-				i++; model->objects[curObj].mesh.faceList[j].B = atoi(tokens[i++]);
+				loadASE_skip(stream, 1); model->objects[curObj].mesh.faceList[j].B = atoi(loadASE_next(stream));
 				//Skip C:
-				i++; model->objects[curObj].mesh.faceList[j].C = atoi(tokens[i++]);
+				loadASE_skip(stream, 1); model->objects[curObj].mesh.faceList[j].C = atoi(loadASE_next(stream));
 				//Skip AB:
-				i++; model->objects[curObj].mesh.faceList[j].AB = atoi(tokens[i++]);
+				loadASE_skip(stream, 1); model->objects[curObj].mesh.faceList[j].AB = atoi(loadASE_next(stream));
 				//Skip BC:
-				i++; model->objects[curObj].mesh.faceList[j].BC = atoi(tokens[i++]);
+				loadASE_skip(stream, 1); model->objects[curObj].mesh.faceList[j].BC = atoi(loadASE_next(stream));
 				//Skip CA:
-				i++; model->objects[curObj].mesh.faceList[j].CA = atoi(tokens[i++]);
+				loadASE_skip(stream, 1); model->objects[curObj].mesh.faceList[j].CA = atoi(loadASE_next(stream));
 				//Skip *MESH_SMOOTHING
 				//Its possible to not have a smoothing group number, in which case we'll accidentally gobble
 				//up too many tokens
-				i++;
+				loadASE_skip(stream, 1);
 
 				//If the next token IS NOT *MESH_MTLID
-				if(strcmp(tokens[i], "*MESH_MTLID"))
-					//Then grab
-					model->objects[curObj].mesh.faceList[j].smoothingGroup = atoi(tokens[i++]);
-
-				//Skip *MESH_MTLID
-				i++; model->objects[curObj].mesh.faceList[j].materialID = atoi(tokens[i++]);
+				token = loadASE_next(stream);
+				if(strcmp(token, "*MESH_MTLID"))
+				{
+					//Then grab, and skip *MESH_MTLID
+					model->objects[curObj].mesh.faceList[j].smoothingGroup = atoi(token);
+					loadASE_skip(stream, 1);
+				}
+
+				model->objects[curObj].mesh.faceList[j].materialID = atoi(loadASE_next(stream));
 			}
 		}
-		else if(!strcmp(tokens[i], "*MESH_NUMTVERTEX"))
+		else if(!strcmp(token, "*MESH_NUMTVERTEX"))
 		{
-			model->objects[curObj].mesh.numTVertex = atoi(tokens[++i]);
+			model->objects[curObj].mesh.numTVertex = atoi(loadASE_next(stream));
 			model->objects[curObj].mesh.tvertList =
-					(ase_mesh_tvertex_t *)malloc(sizeof(ase_mesh_tvertex_t) * model->objects[curObj].mesh.numTVertex);
+					(ase_mesh_tvertex_t *)memory_alloc(MEMORY_TAG_MODELS, sizeof(ase_mesh_tvertex_t) * model->objects[curObj].mesh.numTVertex);
 		}
-		else if(!strcmp(tokens[i], "*MESH_TVERTLIST"))
+		else if(!strcmp(token, "*MESH_TVERTLIST"))
 		{
-			//Skip *MESH_TVERTLIST and {
-			i += 2;
+			//Skip {, the stream is already past *MESH_TVERTLIST
+			loadASE_skip(stream, 1);
 
 			for(j = 0; j < model->objects[curObj].mesh.numTVertex; j++)
 			{
 				//Skip *MESH_TVERTEX
-				i++;
+				loadASE_skip(stream, 1);
 
-				model->objects[curObj].mesh.tvertList[j].vertexID   = atoi(tokens[i++]);
-				model->objects[curObj].mesh.tvertList[j].coords[_X] = atof(tokens[i++]);
-				model->objects[curObj].mesh.tvertList[j].coords[_Y] = atof(tokens[i++]);
-				model->objects[curObj].mesh.tvertList[j].coords[_Z] = atof(tokens[i++]);
+				model->objects[curObj].mesh.tvertList[j].vertexID   = atoi(loadASE_next(stream));
+				model->objects[curObj].mesh.tvertList[j].coords[_X] = atof(loadASE_next(stream));
+				model->objects[curObj].mesh.tvertList[j].coords[_Y] = atof(loadASE_next(stream));
+				model->objects[curObj].mesh.tvertList[j].coords[_Z] = atof(loadASE_next(stream));
 			}
 		}
-		else if(!strcmp(tokens[i], "*MESH_NUMTVFACES"))
+		else if(!strcmp(token, "*MESH_NUMTVFACES"))
 		{
-			model->objects[curObj].mesh.numTVFaces = atoi(tokens[++i]);
+			model->objects[curObj].mesh.numTVFaces = atoi(loadASE_next(stream));
 			model->objects[curObj].mesh.tfaceList =
-					(ase_mesh_tface_t *)malloc(sizeof(ase_mesh_tface_t) * model->objects[curObj].mesh.numTVFaces);
+					(ase_mesh_tface_t *)memory_alloc(MEMORY_TAG_MODELS, sizeof(ase_mesh_tface_t) * model->objects[curObj].mesh.numTVFaces);
 		}
-		else if(!strcmp(tokens[i], "*MESH_TFACELIST"))
+		else if(!strcmp(token, "*MESH_TFACELIST"))
 		{
-			//Skip *MESH_TFACELIST and {
-			i += 2;
+			//Skip {, the stream is already past *MESH_TFACELIST
+			loadASE_skip(stream, 1);
 
 			for(j = 0; j < model->objects[curObj].mesh.numTVFaces; j++)
 			{
 				//Skip *MESH_TFACE
-				i++;
+				loadASE_skip(stream, 1);
 
-				model->objects[curObj].mesh.tfaceList[j].tfaceID = atoi(tokens[i++]);
-				model->objects[curObj].mesh.tfaceList[j].a = atoi(tokens[i++]);
-				model->objects[curObj].mesh.tfaceList[j].b = atoi(tokens[i++]);
-				model->objects[curObj].mesh.tfaceList[j].c = atoi(tokens[i++]);
+				model->objects[curObj].mesh.tfaceList[j].tfaceID = atoi(loadASE_next(stream));
+				model->objects[curObj].mesh.tfaceList[j].a = atoi(loadASE_next(stream));
+				model->objects[curObj].mesh.tfaceList[j].b = atoi(loadASE_next(stream));
+				model->objects[curObj].mesh.tfaceList[j].c = atoi(loadASE_next(stream));
 			}
 		}
-		else if(!strcmp(tokens[i], "*MESH_FACENORMAL"))
+		else if(!strcmp(token, "*MESH_FACENORMAL"))
 		{
-			curFNormal = atoi(tokens[++i]);
-			model->objects[curObj].mesh.faceList[curFNormal].normal[_X] = atof(tokens[++i]);
-			model->objects[curObj].mesh.faceList[curFNormal].normal[_Y] = atof(tokens[++i]);
-			model->objects[curObj].mesh.faceList[curFNormal].normal[_Z] = atof(tokens[++i]);
+			curFNormal = atoi(loadASE_next(stream));
+			model->objects[curObj].mesh.faceList[curFNormal].normal[_X] = atof(loadASE_next(stream));
+			model->objects[curObj].mesh.faceList[curFNormal].normal[_Y] = atof(loadASE_next(stream));
+			model->objects[curObj].mesh.faceList[curFNormal].normal[_Z] = atof(loadASE_next(stream));
 		}
 
-		else if(!strcmp(tokens[i], "*MESH_VERTEXNORMAL"))
+		else if(!strcmp(token, "*MESH_VERTEXNORMAL"))
 		{
-			curVNormal = atoi(tokens[++i]);
-			model->objects[curObj].mesh.vertexList[curVNormal].normal[_X] = atof(tokens[++i]);
-			model->objects[curObj].mesh.vertexList[curVNormal].normal[_Y] = 1.0-atof(tokens[++i]);
-			model->objects[curObj].mesh.vertexList[curVNormal].normal[_Z] = atof(tokens[++i]);
+			curVNormal = atoi(loadASE_next(stream));
+			model->objects[curObj].mesh.vertexList[curVNormal].normal[_X] = atof(loadASE_next(stream));
+			model->objects[curObj].mesh.vertexList[curVNormal].normal[_Y] = 1.0-atof(loadASE_next(stream));
+			model->objects[curObj].mesh.vertexList[curVNormal].normal[_Z] = atof(loadASE_next(stream));
 		}
-		else if(!strcmp(tokens[i], "*MATERIAL_REF"))
-			model->objects[curObj].materialRef = atoi(tokens[++i]);
+		else if(!strcmp(token, "*MATERIAL_REF"))
+			model->objects[curObj].materialRef = atoi(loadASE_next(stream));
 	}
+}
 
-	//Create OpenGL textures from our materials, and store the global material indices
-	for(i = 0; i < model->materials.materialCount; i++)
-	{
-		model->materials.list[i].globalID = renderer_img_createMaterial(model->materials.list[i].diffuseMap.bitmap,
-				model->materials.list[i].ambient, model->materials.list[i].diffuse, model->materials.list[i].specular,
-				model->materials.list[i].shine, model->materials.list[i].shineStrength, model->materials.list[i].transparency);
-	}
+/*
+ * loadASE_bucketFaces
+ * Splits each object into one submesh per submaterial its faces use, with
+ * the faces reordered so every submesh is one contiguous range. Objects
+ * whose material has no submaterials stay a single submesh, face material
+ * IDs only mean anything with a multi/sub-object material.
+ */
+static void loadASE_bucketFaces(ase_model_t *model)
+{
+	ase_geomObject_t	*object;
+	ase_material_t		*mat;
+	int					i, j, sub, numSubs, *offsets;
 
-	//Correct the mesh's references to point to the global material
 	for(i = 0; i < model->numObjects; i++)
-		model->objects[i].materialRef = model->materials.list[model->objects[i].materialRef].globalID;
-
-	/*
-	//Potentially add triangles to collision list
-	if(collidable)
 	{
-		for(i = 0; i < model->numObjects; i++)
+		object	= &(model->objects[i]);
+		numSubs	= 0;
+		mat		= NULL;
+
+		if(object->materialRef >= 0 && object->materialRef < model->materials.materialCount)
 		{
-			world_allocCollisionTris(model->objects[i].mesh.numFaces);
+			mat		= &(model->materials.list[object->materialRef]);
+			numSubs	= mat->numSubMaterials;
+		}
+
+		if(numSubs == 0)
+		{
+			object->numSubMeshes = 1;
+			object->subMeshes = (ase_subMesh_t *)memory_alloc(MEMORY_TAG_MODELS, sizeof(ase_subMesh_t));
+			object->subMeshes[0].materialRef = object->materialRef;
+			object->subMeshes[0].firstFace	 = 0;
+			object->subMeshes[0].numFaces	 = object->mesh.numFaces;
+			continue;
+		}
 
-			vertexList  = model->objects[i].mesh.vertexList;
-			faceList    = model->objects[i].mesh.faceList;
+		//Counting sort on the submaterial, which keeps file order within
+		//each range
+		offsets = (int *)memory_calloc(MEMORY_TAG_MODELS, numSubs + 1, sizeof(int));
 
-			for(j = 0; j < model->objects[i].mesh.numFaces; j++)
-			{
-				VectorCopy(vertexList[faceList[j].A].coords, tri[0]);
-				VectorCopy(vertexList[faceList[j].B].coords, tri[1]);
-				VectorCopy(vertexList[faceList[j].C].coords, tri[2]);
+		for(j = 0; j < object->mesh.numFaces; j++)
+			offsets[abs(object->mesh.faceList[j].materialID) % numSubs + 1]++;
+
+		object->subMeshes = (ase_subMesh_t *)memory_alloc(MEMORY_TAG_MODELS, sizeof(ase_subMesh_t) * numSubs);
+		object->numSubMeshes = 0;
 
-				world_addCollisionTri(tri);
+		for(sub = 0; sub < numSubs; sub++)
+		{
+			if(offsets[sub + 1] > 0)
+			{
+				object->subMeshes[object->numSubMeshes].materialRef = mat->firstSubMaterial + sub;
+				object->subMeshes[object->numSubMeshes].firstFace	= offsets[sub];
+				object->subMeshes[object->numSubMeshes].numFaces	= offsets[sub + 1];
+				object->numSubMeshes++;
 			}
+
+			offsets[sub + 1] += offsets[sub];
 		}
-	}
-	*/
 
-	//Generate a display list for drawing
-	model->glListID = glGenLists(1);
-	glNewList(model->glListID, GL_COMPILE);
-		loadASE_generateList(modelPtr);
-	glEndList();
+		object->faceOrder = (int *)memory_alloc(MEMORY_TAG_MODELS, sizeof(int) * (object->mesh.numFaces ? object->mesh.numFaces : 1));
+
+		for(j = 0; j < object->mesh.numFaces; j++)
+			object->faceOrder[offsets[abs(object->mesh.faceList[j].materialID) % numSubs]++] = j;
+
+		//A multi material none of whose submaterials are used
+		if(object->numSubMeshes == 0)
+		{
+			object->numSubMeshes = 1;
+			object->subMeshes[0].materialRef = object->materialRef;
+			object->subMeshes[0].firstFace	 = 0;
+			object->subMeshes[0].numFaces	 = 0;
+		}
 
-	modelPtr++;
+		memory_free(offsets);
+	}
 }
 
 /*
- * loadASE_generateList
+ * loadASE_generateObjectList
+ * Compiles each submesh of one geomobject into a list holding a single
+ * triangle batch, and records the bounding box center for depth sorting.
  */
-static void loadASE_generateList(int index)
+static void loadASE_generateObjectList(ase_geomObject_t *object)
 {
-	int i, j;
-	ase_model_t 		*model;
+	int j, k, face;
+	ase_subMesh_t		*sub;
 	ase_mesh_vertex_t 	*vertexList;
 	ase_mesh_face_t 	*faceList;
 	ase_mesh_tface_t 	*tfaceList;
 	ase_mesh_tvertex_t 	*tvertList;
+	vec3_t				mins, maxs;
 
-	model = &(modelStack[index]);
+	vertexList  = object->mesh.vertexList;
+	tvertList   = object->mesh.tvertList;
+	faceList    = object->mesh.faceList;
+	tfaceList   = object->mesh.tfaceList;
 
-	for(i = 0; i < model->numObjects; i++)
+	VectorClear(mins);
+	VectorClear(maxs);
+
+	for(j = 0; j < object->mesh.numVertex; j++)
 	{
-		vertexList  = model->objects[i].mesh.vertexList;
-		tvertList   = model->objects[i].mesh.tvertList;
-		faceList    = model->objects[i].mesh.faceList;
-		tfaceList   = model->objects[i].mesh.tfaceList;
+		if(j == 0 || vertexList[j].coords[_X] < mins[_X]) mins[_X] = vertexList[j].coords[_X];
+		if(j == 0 || vertexList[j].coords[_Y] < mins[_Y]) mins[_Y] = vertexList[j].coords[_Y];
+		if(j == 0 || vertexList[j].coords[_Z] < mins[_Z]) mins[_Z] = vertexList[j].coords[_Z];
+		if(j == 0 || vertexList[j].coords[_X] > maxs[_X]) maxs[_X] = vertexList[j].coords[_X];
+		if(j == 0 || vertexList[j].coords[_Y] > maxs[_Y]) maxs[_Y] = vertexList[j].coords[_Y];
+		if(j == 0 || vertexList[j].coords[_Z] > maxs[_Z]) maxs[_Z] = vertexList[j].coords[_Z];
+	}
 
-		glBindTexture(GL_TEXTURE_2D,
-				renderer_img_getMatGLID(model->objects[i].materialRef));
+	VectorAdd(mins, maxs, object->center);
+	VectorScale(object->center, 0.5f, object->center);
+	VectorCopy(mins, object->mins);
+	VectorCopy(maxs, object->maxs);
 
-		for(j = 0; j < model->objects[i].mesh.numFaces; j++)
+	if(object->mesh.numFaces >= ASE_OCCLUSION_MIN_FACES)
+		glGenQueries(1, &(object->query));
+
+	object->glListID = glGenLists(object->numSubMeshes);
+	memory_trackGPU(MEMORY_TAG_MODELS, object->mesh.numFaces * ASE_LIST_FACE_BYTES, object->numSubMeshes);
+
+	for(k = 0; k < object->numSubMeshes; k++)
+	{
+		sub = &(object->subMeshes[k]);
+
+		glNewList(object->glListID + k, GL_COMPILE);
+		glBegin(GL_TRIANGLES);
+
+		for(j = sub->firstFace; j < sub->firstFace + sub->numFaces; j++)
 		{
-			glBegin(GL_POLYGON);
-				glNormal3fv(faceList[j].normal);
+			face = object->faceOrder != NULL ? object->faceOrder[j] : j;
+
+			glNormal3fv(faceList[face].normal);
 
-				//glNormal3fv(vertexList[faceList[j].A].normal);
-				glTexCoord3fv(tvertList[tfaceList[j].a].coords);
-				glVertex3fv(vertexList[faceList[j].A].coords);
+			//glNormal3fv(vertexList[faceList[face].A].normal);
+			glTexCoord3fv(tvertList[tfaceList[face].a].coords);
+			glVertex3fv(vertexList[faceList[face].A].coords);
 
-				//glNormal3fv(vertexList[faceList[j].B].normal);
-				glTexCoord3fv(tvertList[tfaceList[j].b].coords);
-				glVertex3fv(vertexList[faceList[j].B].coords);
+			//glNormal3fv(vertexList[faceList[face].B].normal);
+			glTexCoord3fv(tvertList[tfaceList[face].b].coords);
+			glVertex3fv(vertexList[faceList[face].B].coords);
 
-				//glNormal3fv(vertexList[faceList[j].C].normal);
-				glTexCoord3fv(tvertList[tfaceList[j].c].coords);
-				glVertex3fv(vertexList[faceList[j].C].coords);
-			glEnd();
+			//glNormal3fv(vertexList[faceList[face].C].normal);
+			glTexCoord3fv(tvertList[tfaceList[face].c].coords);
+			glVertex3fv(vertexList[faceList[face].C].coords);
+		}
+
+		glEnd();
+		glEndList();
+	}
+}
+
+/*
+ * loadASE_generateList
+ */
+static void loadASE_generateList(int index)
+{
+	int i, j;
+	ase_model_t *model;
+
+	model = &(modelStack[index]);
+
+	for(i = 0; i < model->numObjects; i++)
+	{
+		for(j = 0; j < model->objects[i].numSubMeshes; j++)
+		{
+			glBindTexture(GL_TEXTURE_2D,
+					renderer_img_getMatGLID(model->objects[i].subMeshes[j].materialRef));
+			glCallList(model->objects[i].glListID + j);
 		}
 	}
 }
@@ -515,6 +1171,216 @@ void renderer_model_drawASE(int index)
 	glCallList(modelStack[index].glListID);
 }
 
+static void loadASE_callList(int listID)
+{
+	glCallList(listID);
+}
+
+/*
+ * loadASE_callAnimated
+ * Render queue callback, param is from ASE_SUBMESH_PARAM.
+ */
+static void loadASE_callAnimated(int param)
+{
+	ase_model_t	*model = &(modelStack[param >> 24]);
+	int			obj = (param >> 8) & 0xFFFF;
+
+	glPushMatrix();
+	glMultMatrixf(model->nodeMatrices[obj]);
+	glCallList(model->objects[obj].glListID + (param & 0xFF));
+	glPopMatrix();
+}
+
+static void loadASE_beginOcclusion()
+{
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_FALSE);
+	glDisable(GL_TEXTURE_2D);
+}
+
+static void loadASE_endOcclusion()
+{
+	glEnable(GL_TEXTURE_2D);
+	glDepthMask(GL_TRUE);
+	glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+/*
+ * loadASE_drawOcclusionBox
+ * Render queue callback, param is the model index in the high 16 bits and
+ * the object in the low 16. Draws the object's bounding box, with color and
+ * depth writes off, inside a samples passed query.
+ */
+static void loadASE_drawOcclusionBox(int param)
+{
+	ase_geomObject_t	*object;
+	const vec_t			*a, *b;
+
+	object = &(modelStack[param >> 16].objects[param & 0xFFFF]);
+	a = object->mins;
+	b = object->maxs;
+
+	glBeginQuery(GL_SAMPLES_PASSED, object->query);
+
+	glBegin(GL_QUADS);
+		glVertex3f(a[0], a[1], a[2]); glVertex3f(b[0], a[1], a[2]); glVertex3f(b[0], b[1], a[2]); glVertex3f(a[0], b[1], a[2]);
+		glVertex3f(a[0], a[1], b[2]); glVertex3f(a[0], b[1], b[2]); glVertex3f(b[0], b[1], b[2]); glVertex3f(b[0], a[1], b[2]);
+		glVertex3f(a[0], a[1], a[2]); glVertex3f(a[0], b[1], a[2]); glVertex3f(a[0], b[1], b[2]); glVertex3f(a[0], a[1], b[2]);
+		glVertex3f(b[0], a[1], a[2]); glVertex3f(b[0], a[1], b[2]); glVertex3f(b[0], b[1], b[2]); glVertex3f(b[0], b[1], a[2]);
+		glVertex3f(a[0], a[1], a[2]); glVertex3f(a[0], a[1], b[2]); glVertex3f(b[0], a[1], b[2]); glVertex3f(b[0], a[1], a[2]);
+		glVertex3f(a[0], b[1], a[2]); glVertex3f(b[0], b[1], a[2]); glVertex3f(b[0], b[1], b[2]); glVertex3f(a[0], b[1], b[2]);
+	glEnd();
+
+	glEndQuery(GL_SAMPLES_PASSED);
+
+	object->queryPending = etrue;
+}
+
+/*
+ * loadASE_testOcclusion
+ * Returns etrue if the object should be skipped this frame. Decisions use
+ * the query issued on an earlier frame, so this never waits on the GPU; an
+ * object whose result isn't back yet is drawn. A fresh query is queued
+ * whenever the previous one has been read.
+ */
+static eboolean loadASE_testOcclusion(ase_geomObject_t *object, int param, const vec3_t eye)
+{
+	GLuint available, samples;
+
+	if(!object->query)
+		return efalse;
+
+	if(object->queryPending)
+	{
+		glGetQueryObjectuiv(object->query, GL_QUERY_RESULT_AVAILABLE, &available);
+
+		if(available)
+		{
+			glGetQueryObjectuiv(object->query, GL_QUERY_RESULT, &samples);
+			object->occluded	 = (samples == 0);
+			object->queryPending = efalse;
+		}
+		else
+			object->occluded = efalse;
+	}
+
+	if(eye[_X] > object->mins[_X] - ASE_OCCLUSION_MARGIN && eye[_X] < object->maxs[_X] + ASE_OCCLUSION_MARGIN &&
+	   eye[_Y] > object->mins[_Y] - ASE_OCCLUSION_MARGIN && eye[_Y] < object->maxs[_Y] + ASE_OCCLUSION_MARGIN &&
+	   eye[_Z] > object->mins[_Z] - ASE_OCCLUSION_MARGIN && eye[_Z] < object->maxs[_Z] + ASE_OCCLUSION_MARGIN)
+	{
+		object->occluded = efalse;
+		return efalse;
+	}
+
+	if(!object->queryPending)
+	{
+		renderer_queue_add(QUEUE_LAYER_OCCLUSION, efalse, 0, object->center,
+				occlusionSource, loadASE_drawOcclusionBox, param);
+		statQueries++;
+	}
+
+	return object->occluded;
+}
+
+/*
+ * renderer_model_queueASE
+ * Submits each submesh of every geomobject to the render queue. Materials with any
+ * transparency are drawn in the translucent pass, back to front. Large
+ * objects whose bounding box was fully hidden last time it was tested are
+ * left out.
+ */
+void renderer_model_queueASE(int index)
+{
+	int i, j, mat;
+	ase_model_t *model;
+	ase_subMesh_t *sub;
+	vec3_t eye, center;
+
+	model = &(modelStack[index]);
+
+	if(occlusionSource < 0)
+		occlusionSource = renderer_queue_addSource(loadASE_beginOcclusion, loadASE_endOcclusion);
+
+	renderer_queue_getViewOrigin(eye);
+
+	for(i = 0; i < model->numObjects; i++)
+	{
+		//Animated objects move away from their bounding boxes, so they are
+		//never occlusion tested
+		if(model->anim != NULL)
+		{
+			mat4_transformPoints(model->nodeMatrices[i], model->objects[i].center, center, 1);
+
+			for(j = 0; j < model->objects[i].numSubMeshes; j++)
+			{
+				mat = model->objects[i].subMeshes[j].materialRef;
+				renderer_queue_add(QUEUE_LAYER_WORLD, renderer_img_isMatTranslucent(mat),
+						renderer_img_getMatGLID(mat), center,
+						QUEUE_SOURCE_NONE, loadASE_callAnimated, ASE_SUBMESH_PARAM(index, i, j));
+			}
+
+			statDrawn++;
+			continue;
+		}
+
+		if(loadASE_testOcclusion(&(model->objects[i]), (index << 16) | i, eye))
+		{
+			statOccluded++;
+			continue;
+		}
+
+		statDrawn++;
+
+		for(j = 0; j < model->objects[i].numSubMeshes; j++)
+		{
+			sub = &(model->objects[i].subMeshes[j]);
+			renderer_queue_add(QUEUE_LAYER_WORLD, renderer_img_isMatTranslucent(sub->materialRef),
+					renderer_img_getMatGLID(sub->materialRef), model->objects[i].center,
+					QUEUE_SOURCE_NONE, loadASE_callList, model->objects[i].glListID + j);
+		}
+	}
+}
+
+/*
+ * renderer_model_animateASE
+ * Poses an animated model at time seconds for the next queue, looping over
+ * its scene frames. Does nothing for static models.
+ */
+void renderer_model_animateASE(int index, float seconds)
+{
+	ase_model_t *model;
+
+	if(index < 0 || index >= MAX_MODELS || !modelStack[index].inUse || modelStack[index].anim == NULL)
+		return;
+
+	model = &(modelStack[index]);
+	renderer_anim_sample(model->anim, seconds, model->nodeMatrices);
+}
+
+/*
+ * renderer_model_getOcclusionStats
+ * Running totals of geomobjects drawn, skipped as occluded and queries
+ * issued, for checks that sample them between frames.
+ */
+void renderer_model_getOcclusionStats(double *drawn, double *occluded, double *queries)
+{
+	*drawn	  = statDrawn;
+	*occluded = statOccluded;
+	*queries  = statQueries;
+}
+
+/*
+ * renderer_model_printStats
+ */
+void renderer_model_printStats()
+{
+	if(statDrawn + statOccluded == 0)
+		return;
+
+	printf("ASE occlusion: %.0f objects drawn, %.0f occluded (%.1f%%), %.0f queries issued.\n",
+			statDrawn, statOccluded, 100.0 * statOccluded / (statDrawn + statOccluded), statQueries);
+}
+
 /*
 ===========================================================================
 Debugging
@@ -12,8 +12,24 @@ Created on: Feb 19, 2011
 #define MAX_MODELS   128
 
 #include "common.h"
+#include "vmath.h"
+
+//Parsed but not yet uploaded model, see renderer_model_parseASE
+typedef struct ase_model_s ase_model_t;
+
+int           renderer_model_loadASE(char *name, eboolean collidable);
+ase_model_t * renderer_model_parseASE(char *name, eboolean collidable);
+int           renderer_model_uploadASE(ase_model_t *parsed);
+void          renderer_model_discardASE(ase_model_t *parsed);
+void          renderer_model_freeASE(int index);
+int           renderer_model_reloadASE(char *name);
+vec_t *       renderer_model_loadCollisionASE(char *name, int *numTris);
+vec_t *       renderer_model_takeCollisionASE(ase_model_t *parsed, int *numTris);
 
-void renderer_model_loadASE(char *name, eboolean collidable);
 void renderer_model_drawASE(int index);
+void renderer_model_queueASE(int index);
+void renderer_model_animateASE(int index, float seconds);
+void renderer_model_getOcclusionStats(double *drawn, double *occluded, double *queries);
+void renderer_model_printStats();
 
 #endif /* RENDERER_MODELS_H_ */
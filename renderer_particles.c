@@ -0,0 +1,482 @@
+/*
+===========================================================================
+File:		renderer_particles.c
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+Description:	Lava embers and smoke. Particles are kept structure-of-
+				arrays, one aligned float array per component, so the
+				per frame integration is the same few SSE operations on
+				four particles at a time, which also counts how many died,
+				split into ranges across the job workers once there are
+				enough particles to be worth it.
+				Dead particles stay in place, fully faded, until they make
+				up PARTICLES_COMPACT_FRACTION of the arrays. Then one
+				branchless pass lists the survivors and each component is
+				gathered down after it, so compaction is a handful of
+				streaming loops every few frames instead of a shuffle of
+				every array every frame. Everything up to the count is
+				written into one streamed vertex buffer and drawn as a
+				single batch of points, additively blended.
+
+				Every PARTICLES_SMOKE_EVERY-th particle emitted is a slower,
+				longer lived grey smoke puff instead of an ember, both
+				share the arrays and the kernel.
+===========================================================================
+*/
+
+#define GL_GLEXT_PROTOTYPES
+
+#include <SDL/SDL_opengl.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+
+#include "renderer_particles.h"
+#include "renderer_profile.h"
+#include "renderer_queue.h"
+#include "system_jobs.h"
+#include "system_memory.h"
+
+#define PARTICLES_SMOKE_EVERY	8
+
+//Upward acceleration from the heat, and the fraction of velocity lost
+//per second to drag
+#define PARTICLES_BUOYANCY		12.0f
+#define PARTICLES_DRAG			0.35f
+
+#define PARTICLES_POINT_SIZE	3.0f
+
+//Compact once one particle in this many is dead
+#define PARTICLES_COMPACT_FRACTION	8
+
+//Frames longer than this are integrated as this long, after a stall the
+//embers shouldn't jump
+#define PARTICLES_MAX_STEP		0.1f
+
+//Groups of four particles per integration job, fewer than this many run on
+//the calling thread alone
+#define PARTICLES_JOB_GROUPS	4096
+
+enum
+{
+	P_PX, P_PY, P_PZ,
+	P_VX, P_VY, P_VZ,
+	P_LIFE, P_INVLIFE,			//seconds left, 1 / seconds at birth
+	P_R, P_G, P_B,
+	P_COMPONENTS
+};
+
+typedef struct
+{
+	vec3_t	pos;
+	byte	color[4];
+}
+particles_vertex_t;
+
+static float		*component[P_COMPONENTS];
+static float		*block = NULL;
+static int			*keep = NULL;				//compaction scratch
+static int			capacity = 0, count = 0, dead = 0;
+
+static vec3_t		emitOrigin;
+static float		emitRadius = 0.0f, emitRate = 0.0f, emitCarry = 0.0f;
+static unsigned int	emitted = 0, rngState = 2463534242u;
+
+static GLuint		particleBuffer = 0;
+static int			particleBytes = 0;
+static int			particleSource = -1, drawCount = 0;
+
+static unsigned int	statFrames = 0, statPeak = 0, statCompactions = 0;
+static double		statUpdateMsec = 0.0;
+
+/*
+ * renderer_particles_init
+ * Allocates room for maxParticles. Nothing is emitted until an emitter is
+ * set.
+ */
+void renderer_particles_init(int maxParticles)
+{
+	void	*mem;
+	int		i;
+
+	renderer_particles_shutdown();
+
+	//Padded so the SIMD kernel can always run whole groups of four
+	capacity = (maxParticles + 3) & ~3;
+
+	if(capacity <= 0 || (mem = memory_alloc(MEMORY_TAG_PARTICLES, sizeof(float) * P_COMPONENTS * capacity)) == NULL)
+	{
+		printf("Particles: could not allocate %d particles.\n", maxParticles);
+		capacity = 0;
+		return;
+	}
+
+	block = (float *)mem;
+	keep  = (int *)memory_alloc(MEMORY_TAG_PARTICLES, sizeof(int) * capacity);
+	memset(block, 0, sizeof(float) * P_COMPONENTS * capacity);
+
+	for(i = 0; i < P_COMPONENTS; i++)
+		component[i] = block + i * capacity;
+}
+
+/*
+ * renderer_particles_setEmitter
+ * Embers rise from a square of the given half width around origin, rate
+ * particles a second. A rate of 0 stops emission.
+ */
+void renderer_particles_setEmitter(const vec3_t origin, float radius, float rate)
+{
+	VectorCopy(origin, emitOrigin);
+	emitRadius = radius;
+	emitRate   = rate > 0.0f ? rate : 0.0f;
+}
+
+/*
+ * particles_random
+ * xorshift32, uniform in [0, 1).
+ */
+static float particles_random()
+{
+	rngState ^= rngState << 13;
+	rngState ^= rngState >> 17;
+	rngState ^= rngState << 5;
+
+	return (rngState >> 8) * (1.0f / 16777216.0f);
+}
+
+/*
+ * particles_clearPadding
+ * Lanes between count and the next multiple of four are run through the
+ * kernel too. Giving them no life keeps them out of the dead count.
+ */
+static void particles_clearPadding()
+{
+	int i;
+
+	for(i = count; i & 3; i++)
+		component[P_LIFE][i] = 0.0f;
+}
+
+/*
+ * particles_emit
+ * Appends up to n new particles at the end of the arrays.
+ */
+static void particles_emit(int n)
+{
+	float	life;
+	int		i;
+
+	if(n > capacity - count)
+		n = capacity - count;
+
+	for(i = count; i < count + n; i++, emitted++)
+	{
+		component[P_PX][i] = emitOrigin[_X] + (particles_random() * 2.0f - 1.0f) * emitRadius;
+		component[P_PY][i] = emitOrigin[_Y];
+		component[P_PZ][i] = emitOrigin[_Z] + (particles_random() * 2.0f - 1.0f) * emitRadius;
+
+		if(emitted % PARTICLES_SMOKE_EVERY == 0)
+		{
+			component[P_VX][i] = (particles_random() - 0.5f) * 6.0f;
+			component[P_VY][i] = 6.0f + particles_random() * 8.0f;
+			component[P_VZ][i] = (particles_random() - 0.5f) * 6.0f;
+			life = 4.0f + particles_random() * 2.0f;
+
+			component[P_R][i] = component[P_G][i] = component[P_B][i] = 0.25f + particles_random() * 0.1f;
+		}
+		else
+		{
+			component[P_VX][i] = (particles_random() - 0.5f) * 16.0f;
+			component[P_VY][i] = 20.0f + particles_random() * 40.0f;
+			component[P_VZ][i] = (particles_random() - 0.5f) * 16.0f;
+			life = 1.5f + particles_random() * 1.5f;
+
+			component[P_R][i] = 1.0f;
+			component[P_G][i] = 0.3f + particles_random() * 0.4f;
+			component[P_B][i] = 0.05f;
+		}
+
+		component[P_LIFE][i]	= life;
+		component[P_INVLIFE][i]	= 1.0f / life;
+	}
+
+	count += n;
+	particles_clearPadding();
+}
+
+typedef struct
+{
+	float	dt;
+	int		died;
+}
+particles_step_t;
+
+/*
+ * particles_integrateRange
+ * Moves groups [first, last) of four particles on by dt and ages them,
+ * adding how many died this step to the step's count.
+ */
+static void particles_integrateRange(void *param, int first, int last)
+{
+	particles_step_t *step = (particles_step_t *)param;
+	float	*px = component[P_PX], *py = component[P_PY], *pz = component[P_PZ];
+	float	*vx = component[P_VX], *vy = component[P_VY], *vz = component[P_VZ];
+	float	*life = component[P_LIFE];
+	float	dt = step->dt, drag = 1.0f - PARTICLES_DRAG * dt, lift = PARTICLES_BUOYANCY * dt;
+	int		i, end, died = 0;
+
+#ifdef VMATH_SSE
+	__m128	vdt = _mm_set1_ps(dt), vdrag = _mm_set1_ps(drag), vlift = _mm_set1_ps(lift);
+	__m128	zero = _mm_setzero_ps(), x, y, z, l0, l1;
+
+	for(i = first * 4, end = last * 4; i < end; i += 4)
+	{
+		x = _mm_mul_ps(_mm_load_ps(vx + i), vdrag);
+		y = _mm_mul_ps(_mm_add_ps(_mm_load_ps(vy + i), vlift), vdrag);
+		z = _mm_mul_ps(_mm_load_ps(vz + i), vdrag);
+
+		_mm_store_ps(vx + i, x);
+		_mm_store_ps(vy + i, y);
+		_mm_store_ps(vz + i, z);
+
+		_mm_store_ps(px + i, _mm_add_ps(_mm_load_ps(px + i), _mm_mul_ps(x, vdt)));
+		_mm_store_ps(py + i, _mm_add_ps(_mm_load_ps(py + i), _mm_mul_ps(y, vdt)));
+		_mm_store_ps(pz + i, _mm_add_ps(_mm_load_ps(pz + i), _mm_mul_ps(z, vdt)));
+
+		l0 = _mm_load_ps(life + i);
+		l1 = _mm_sub_ps(l0, vdt);
+		_mm_store_ps(life + i, l1);
+
+		//Alive before, not after
+		died += __builtin_popcount(_mm_movemask_ps(_mm_and_ps(_mm_cmpgt_ps(l0, zero), _mm_cmple_ps(l1, zero))));
+	}
+#else
+	end = last * 4 < count ? last * 4 : count;
+
+	for(i = first * 4; i < end; i++)
+	{
+		vx[i] *= drag;
+		vy[i] = (vy[i] + lift) * drag;
+		vz[i] *= drag;
+
+		px[i] += vx[i] * dt;
+		py[i] += vy[i] * dt;
+		pz[i] += vz[i] * dt;
+
+		died += (life[i] > 0.0f) & (life[i] - dt <= 0.0f);
+		life[i] -= dt;
+	}
+#endif
+
+	__atomic_add_fetch(&step->died, died, __ATOMIC_RELAXED);
+}
+
+/*
+ * particles_integrate
+ * Moves every particle on by dt and ages it, and returns how many died
+ * this step. Large systems are split across the job workers.
+ */
+static int particles_integrate(float dt)
+{
+	particles_step_t step;
+
+	step.dt	  = dt;
+	step.died = 0;
+
+	jobs_parallelFor((count + 3) / 4, PARTICLES_JOB_GROUPS, particles_integrateRange, &step);
+
+	return step.died;
+}
+
+/*
+ * particles_compact
+ * Removes dead particles, keeping the order of the rest. One branchless
+ * pass lists the survivors, then each component is gathered down on its
+ * own, which keeps every loop a plain stream over one array. Starts at the
+ * first dead particle, everything before it is already in place.
+ */
+static void particles_compact()
+{
+	float	*life = component[P_LIFE], *dst;
+	int		i, c, first, live;
+
+	for(first = 0; first < count && life[first] > 0.0f; first++)
+		;
+
+	for(i = first, live = first; i < count; i++)
+	{
+		keep[live] = i;
+		live += life[i] > 0.0f;
+	}
+
+	//keep[i] >= i, so gathering in place never reads an overwritten slot
+	for(c = 0; c < P_COMPONENTS; c++)
+	{
+		dst = component[c];
+
+		for(i = first; i < live; i++)
+			dst[i] = dst[keep[i]];
+	}
+
+	count = live;
+	dead  = 0;
+	particles_clearPadding();
+	statCompactions++;
+}
+
+/*
+ * renderer_particles_update
+ * Emits, integrates and retires particles for seconds of elapsed time.
+ * CPU only, may run before or after renderer_particles_queue.
+ */
+void renderer_particles_update(float seconds)
+{
+	struct timespec	t0, t1;
+	int				n;
+
+	if(capacity == 0)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	if(seconds > PARTICLES_MAX_STEP)
+		seconds = PARTICLES_MAX_STEP;
+	if(seconds < 0.0f)
+		seconds = 0.0f;
+
+	dead += particles_integrate(seconds);
+
+	if(dead * PARTICLES_COMPACT_FRACTION > count)
+		particles_compact();
+
+	emitCarry += emitRate * seconds;
+	n = (int)emitCarry;
+	emitCarry -= n;
+	particles_emit(n);
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+
+	statUpdateMsec += (t1.tv_sec - t0.tv_sec) * 1000.0 + (t1.tv_nsec - t0.tv_nsec) / 1000000.0;
+	statFrames++;
+
+	if((unsigned int)count > statPeak)
+		statPeak = count;
+}
+
+static void particles_beginSource()
+{
+	glBindBuffer(GL_ARRAY_BUFFER, particleBuffer);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(3, GL_FLOAT, sizeof(particles_vertex_t), (void *)offsetof(particles_vertex_t, pos));
+	glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(particles_vertex_t), (void *)offsetof(particles_vertex_t, color));
+
+	glDisable(GL_TEXTURE_2D);
+	glEnable(GL_POINT_SMOOTH);
+	glPointSize(PARTICLES_POINT_SIZE);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+}
+
+static void particles_endSource()
+{
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glPointSize(1.0f);
+	glDisable(GL_POINT_SMOOTH);
+	glEnable(GL_TEXTURE_2D);
+
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	//Everything else draws with white vertex color
+	glColor4f(1, 1, 1, 1);
+}
+
+static void particles_draw(int unused)
+{
+	glDrawArrays(GL_POINTS, 0, drawCount);
+}
+
+/*
+ * renderer_particles_queue
+ * GL thread. Streams the live particles into the vertex buffer and
+ * submits them as one translucent render queue item.
+ */
+void renderer_particles_queue()
+{
+	particles_vertex_t	*v;
+	float				a;
+	int					i;
+
+	if(count == 0)
+		return;
+
+	if(!particleBuffer)
+	{
+		glGenBuffers(1, &particleBuffer);
+		memory_trackGPU(MEMORY_TAG_PARTICLES, 0, 1);
+	}
+
+	memory_trackGPU(MEMORY_TAG_PARTICLES, (int)sizeof(particles_vertex_t) * count - particleBytes, 0);
+	particleBytes = sizeof(particles_vertex_t) * count;
+
+	if(particleSource < 0)
+		particleSource = renderer_queue_addSource(particles_beginSource, particles_endSource);
+
+	//Orphan last frame's storage so the driver needn't wait on it
+	glBindBuffer(GL_ARRAY_BUFFER, particleBuffer);
+	glBufferData(GL_ARRAY_BUFFER, particleBytes, NULL, GL_STREAM_DRAW);
+	v = (particles_vertex_t *)glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+
+	if(v == NULL)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		return;
+	}
+
+	for(i = 0; i < count; i++, v++)
+	{
+		v->pos[_X] = component[P_PX][i];
+		v->pos[_Y] = component[P_PY][i];
+		v->pos[_Z] = component[P_PZ][i];
+
+		//Fade out over the whole life, dead ones are invisible
+		a = fmaxf(component[P_LIFE][i], 0.0f) * component[P_INVLIFE][i];
+
+		v->color[_R] = (byte)(component[P_R][i] * 255.0f);
+		v->color[_G] = (byte)(component[P_G][i] * 255.0f);
+		v->color[_B] = (byte)(component[P_B][i] * 255.0f);
+		v->color[_A] = (byte)(a * 255.0f);
+	}
+
+	glUnmapBuffer(GL_ARRAY_BUFFER);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	drawCount = count;
+	renderer_queue_add(QUEUE_LAYER_WORLD, etrue, 0, emitOrigin, particleSource, particles_draw, 0);
+}
+
+/*
+ * renderer_particles_shutdown
+ */
+void renderer_particles_shutdown()
+{
+	memory_free(block);
+	memory_free(keep);
+	block	 = NULL;
+	keep	 = NULL;
+	capacity = count = 0;
+}
+
+/*
+ * renderer_particles_printStats
+ */
+void renderer_particles_printStats()
+{
+	if(statFrames == 0)
+		return;
+
+	printf("Particles: %u emitted, %u peak, %.3f ms average update, compacted every %.1f frames.\n",
+			emitted, statPeak, statUpdateMsec / statFrames,
+			statCompactions ? (float)statFrames / statCompactions : 0.0f);
+}
@@ -0,0 +1,24 @@
+/*
+===========================================================================
+File:		renderer_particles.h
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+===========================================================================
+*/
+
+#ifndef RENDERER_PARTICLES_H_
+#define RENDERER_PARTICLES_H_
+
+#include "common.h"
+#include "vmath.h"
+
+#define PARTICLES_DEFAULT_MAX	100000
+
+void renderer_particles_init(int maxParticles);
+void renderer_particles_setEmitter(const vec3_t origin, float radius, float rate);
+void renderer_particles_update(float seconds);
+void renderer_particles_queue();
+void renderer_particles_shutdown();
+void renderer_particles_printStats();
+
+#endif /* RENDERER_PARTICLES_H_ */
@@ -0,0 +1,208 @@
+/*
+===========================================================================
+File:		renderer_profile.c
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+Description:	CPU and GPU time per render pass. Each renderer_profile_mark
+				records a CPU clock reading and, where GL_ARB_timer_query
+				is available, a GPU timestamp. The time between two marks
+				is charged to the earlier mark's pass, so passes that the
+				render queue interleaves still add up correctly.
+
+				GPU timestamps are kept in a ring PROFILE_FRAMES_IN_FLIGHT
+				frames deep and read back when their slot comes around
+				again. A frame whose results still aren't ready by then is
+				dropped rather than waited for.
+===========================================================================
+*/
+
+#define GL_GLEXT_PROTOTYPES
+
+#include <SDL/SDL_opengl.h>
+#include <string.h>
+#include <time.h>
+
+#include "renderer_profile.h"
+
+#define PROFILE_FRAMES_IN_FLIGHT	4
+#define PROFILE_MAX_MARKS			32
+
+typedef struct
+{
+	GLuint	queries[PROFILE_MAX_MARKS];
+	int		passes[PROFILE_MAX_MARKS];
+	int		numMarks;
+	double	cpuTime[PROFILE_MAX_MARKS];
+}
+profile_frame_t;
+
+static const char *passNames[PROFILE_NUM_PASSES] =
+{
+	"setup", "terrain", "static quads", "world models", "skybox", "particles", "HUD"
+};
+
+static profile_frame_t	frameRing[PROFILE_FRAMES_IN_FLIGHT];
+static profile_frame_t	*curFrame = NULL;
+static int				frameCount = 0;
+static eboolean			initialized = efalse, gpuTimers = efalse;
+
+static double			cpuTotal[PROFILE_NUM_PASSES], gpuTotal[PROFILE_NUM_PASSES];
+static unsigned int		cpuFrames = 0, gpuFrames = 0, droppedFrames = 0, droppedMarks = 0;
+
+/*
+ * profile_cpuMsec
+ */
+static double profile_cpuMsec()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void profile_init()
+{
+	const char	*extensions;
+	int			i;
+
+	extensions = (const char *)glGetString(GL_EXTENSIONS);
+	gpuTimers  = (extensions != NULL && strstr(extensions, "GL_ARB_timer_query") != NULL);
+
+	if(gpuTimers)
+		for(i = 0; i < PROFILE_FRAMES_IN_FLIGHT; i++)
+			glGenQueries(PROFILE_MAX_MARKS, frameRing[i].queries);
+	else
+		printf("Profile: GL_ARB_timer_query not supported, CPU timings only.\n");
+
+	initialized = etrue;
+}
+
+/*
+ * profile_collect
+ * Adds a finished frame's GPU timings to the totals, if they are ready.
+ */
+static void profile_collect(profile_frame_t *frame)
+{
+	GLuint		available;
+	GLuint64	t0, t1;
+	int			i;
+
+	if(frame->numMarks < 2)
+		return;
+
+	//Timestamps complete in order, so the last one being ready covers all
+	glGetQueryObjectuiv(frame->queries[frame->numMarks-1], GL_QUERY_RESULT_AVAILABLE, &available);
+
+	if(!available)
+	{
+		droppedFrames++;
+		return;
+	}
+
+	glGetQueryObjectui64v(frame->queries[0], GL_QUERY_RESULT, &t0);
+
+	for(i = 1; i < frame->numMarks; i++, t0 = t1)
+	{
+		glGetQueryObjectui64v(frame->queries[i], GL_QUERY_RESULT, &t1);
+		gpuTotal[frame->passes[i-1]] += (t1 - t0) / 1000000.0;
+	}
+
+	gpuFrames++;
+}
+
+/*
+ * renderer_profile_beginFrame
+ * Starts a frame in the setup pass. GL thread only.
+ */
+void renderer_profile_beginFrame()
+{
+	if(!initialized)
+		profile_init();
+
+	curFrame = &frameRing[frameCount % PROFILE_FRAMES_IN_FLIGHT];
+
+	if(gpuTimers && frameCount >= PROFILE_FRAMES_IN_FLIGHT)
+		profile_collect(curFrame);
+
+	curFrame->numMarks = 0;
+	frameCount++;
+
+	renderer_profile_mark(PROFILE_PASS_SETUP);
+}
+
+/*
+ * renderer_profile_mark
+ * Everything from here to the next mark is charged to pass. The last slot
+ * is kept for renderer_profile_endFrame, marks beyond that are dropped and
+ * their time goes to the pass before.
+ */
+void renderer_profile_mark(int pass)
+{
+	int i;
+
+	if(curFrame == NULL)
+		return;
+
+	if(curFrame->numMarks >= PROFILE_MAX_MARKS-1)
+	{
+		droppedMarks++;
+		return;
+	}
+
+	i = curFrame->numMarks++;
+	curFrame->passes[i]  = pass;
+	curFrame->cpuTime[i] = profile_cpuMsec();
+
+	if(gpuTimers)
+		glQueryCounter(curFrame->queries[i], GL_TIMESTAMP);
+}
+
+/*
+ * renderer_profile_endFrame
+ * Closes the last pass. Call before swapping, so waiting on vsync isn't
+ * charged to anything.
+ */
+void renderer_profile_endFrame()
+{
+	int i;
+
+	if(curFrame == NULL)
+		return;
+
+	i = curFrame->numMarks++;
+	curFrame->passes[i]  = PROFILE_PASS_SETUP;
+	curFrame->cpuTime[i] = profile_cpuMsec();
+
+	if(gpuTimers)
+		glQueryCounter(curFrame->queries[i], GL_TIMESTAMP);
+
+	for(i = 1; i < curFrame->numMarks; i++)
+		cpuTotal[curFrame->passes[i-1]] += curFrame->cpuTime[i] - curFrame->cpuTime[i-1];
+
+	cpuFrames++;
+	curFrame = NULL;
+}
+
+/*
+ * renderer_profile_printStats
+ */
+void renderer_profile_printStats()
+{
+	int i;
+
+	if(cpuFrames == 0)
+		return;
+
+	printf("Profile: average ms per frame over %u frames (%u GPU frames, %u dropped, %u marks dropped)\n",
+			cpuFrames, gpuFrames, droppedFrames, droppedMarks);
+	printf("  %-14s %8s %8s\n", "pass", "cpu", "gpu");
+
+	for(i = 0; i < PROFILE_NUM_PASSES; i++)
+	{
+		if(gpuFrames)
+			printf("  %-14s %8.3f %8.3f\n", passNames[i], cpuTotal[i] / cpuFrames, gpuTotal[i] / gpuFrames);
+		else
+			printf("  %-14s %8.3f %8s\n", passNames[i], cpuTotal[i] / cpuFrames, "-");
+	}
+}
@@ -0,0 +1,29 @@
+/*
+===========================================================================
+File:		renderer_profile.h
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+===========================================================================
+*/
+
+#ifndef RENDERER_PROFILE_H_
+#define RENDERER_PROFILE_H_
+
+#include "common.h"
+
+//Work is charged to whichever pass was marked last
+#define PROFILE_PASS_SETUP		0
+#define PROFILE_PASS_TERRAIN	1
+#define PROFILE_PASS_STATIC		2
+#define PROFILE_PASS_MODELS		3
+#define PROFILE_PASS_SKY		4
+#define PROFILE_PASS_PARTICLES	5
+#define PROFILE_PASS_HUD		6
+#define PROFILE_NUM_PASSES		7
+
+void renderer_profile_beginFrame();
+void renderer_profile_mark(int pass);
+void renderer_profile_endFrame();
+void renderer_profile_printStats();
+
+#endif /* RENDERER_PROFILE_H_ */
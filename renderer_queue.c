@@ -0,0 +1,307 @@
+/*
+===========================================================================
+File:		renderer_queue.c
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+Description:	Per-frame render queue. Every draw gets a 64 bit sort key,
+				the keys are radix sorted, and the items are submitted in
+				that order so texture binds and vertex source switches only
+				happen when something actually changes.
+
+				Key layout, most significant first:
+				  63..60  layer
+				  59      translucent
+				  58..35  opaque: texture    translucent: inverted depth
+				  34..11  opaque: depth      translucent: texture
+				Opaque items therefore group by texture and go front to back
+				within a texture, translucent ones go strictly back to front.
+===========================================================================
+*/
+
+#include <SDL/SDL_opengl.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "renderer_materials.h"
+#include "renderer_profile.h"
+#include "renderer_queue.h"
+#include "system_memory.h"
+
+#define QUEUE_MAX_SOURCES	16
+#define QUEUE_MAX_DEPTH		1024.0f
+#define QUEUE_FIELD_BITS	24
+#define QUEUE_FIELD_MASK	((1 << QUEUE_FIELD_BITS) - 1)
+
+typedef struct
+{
+	int						glTexID, source, param, pass;
+	eboolean				translucent;
+	renderer_queue_func_t	draw;
+}
+queue_item_t;
+
+typedef struct
+{
+	uint64_t	key;
+	int			item;
+}
+queue_key_t;
+
+typedef struct
+{
+	void (*begin)(void);
+	void (*end)(void);
+}
+queue_source_t;
+
+static queue_item_t		*itemList = NULL;
+static queue_key_t		*keyList = NULL, *keyScratch = NULL;
+static int				numItems = 0, itemsAllocated = 0;
+
+//Slot 0 is QUEUE_SOURCE_NONE
+static queue_source_t	sourceList[QUEUE_MAX_SOURCES];
+static int				numSources = 1;
+
+static mat4_t			queueView;
+static int				curPass = 0;
+
+static unsigned int		statFrames = 0, statItems = 0, statBinds = 0, statSwitches = 0;
+static unsigned int		lastBinds = 0;
+
+/*
+ * renderer_queue_addSource
+ * Registers a vertex source, e.g. a buffer with its array pointers. begin is
+ * called before the first item drawn from it, end when the queue moves on.
+ */
+int renderer_queue_addSource(void (*begin)(void), void (*end)(void))
+{
+	if(numSources == QUEUE_MAX_SOURCES)
+	{
+		printf("Render queue: out of vertex sources.\n");
+		return QUEUE_SOURCE_NONE;
+	}
+
+	sourceList[numSources].begin = begin;
+	sourceList[numSources].end   = end;
+
+	return numSources++;
+}
+
+/*
+ * renderer_queue_begin
+ * Starts a new frame. viewMatrix is used to compute item depths.
+ */
+void renderer_queue_begin(const mat4_t viewMatrix)
+{
+	memcpy(queueView, viewMatrix, sizeof(mat4_t));
+	numItems = 0;
+	curPass	 = PROFILE_PASS_SETUP;
+}
+
+/*
+ * renderer_queue_setPass
+ * Profiling pass charged for items added from now on.
+ */
+void renderer_queue_setPass(int pass)
+{
+	curPass = pass;
+}
+
+/*
+ * renderer_queue_getViewOrigin
+ * World space camera position of the current frame.
+ */
+void renderer_queue_getViewOrigin(vec3_t origin)
+{
+	int i;
+
+	//The view is rotation then translation, so the eye is -R^T * t
+	for(i = 0; i < 3; i++)
+		origin[i] = -(queueView[i*4+0]*queueView[12] + queueView[i*4+1]*queueView[13] +
+					  queueView[i*4+2]*queueView[14]);
+}
+
+static unsigned int queue_quantizeDepth(const vec3_t center)
+{
+	float dist;
+
+	if(center == NULL)
+		return 0;
+
+	//Distance along the view direction, the camera looks down -Z
+	dist = -(queueView[2]*center[0] + queueView[6]*center[1] + queueView[10]*center[2] + queueView[14]);
+
+	if(dist <= 0.0f)
+		return 0;
+	if(dist >= QUEUE_MAX_DEPTH)
+		return QUEUE_FIELD_MASK;
+
+	return (unsigned int)(dist / QUEUE_MAX_DEPTH * QUEUE_FIELD_MASK);
+}
+
+/*
+ * renderer_queue_add
+ * center is the world space point used for depth sorting, or NULL.
+ * A glTexID of 0 means the item binds nothing.
+ */
+void renderer_queue_add(int layer, eboolean translucent, int glTexID, const vec3_t center,
+		int source, renderer_queue_func_t draw, int param)
+{
+	queue_item_t	*item;
+	uint64_t		key, tex, depth;
+
+	if(numItems >= itemsAllocated)
+	{
+		itemsAllocated = itemsAllocated ? itemsAllocated * 2 : 256;
+		itemList   = (queue_item_t *)memory_realloc(MEMORY_TAG_RENDERER, itemList,   sizeof(queue_item_t) * itemsAllocated);
+		keyList    = (queue_key_t  *)memory_realloc(MEMORY_TAG_RENDERER, keyList,    sizeof(queue_key_t)  * itemsAllocated);
+		keyScratch = (queue_key_t  *)memory_realloc(MEMORY_TAG_RENDERER, keyScratch, sizeof(queue_key_t)  * itemsAllocated);
+	}
+
+	if(translucent && layer == QUEUE_LAYER_WORLD)
+		layer = QUEUE_LAYER_TRANSLUCENT;
+
+	item = &itemList[numItems];
+	item->glTexID		= glTexID;
+	item->source		= source;
+	item->draw			= draw;
+	item->param			= param;
+	item->translucent	= translucent;
+	item->pass			= curPass;
+
+	tex   = (uint64_t)(glTexID & QUEUE_FIELD_MASK);
+	depth = queue_quantizeDepth(center);
+
+	key = (uint64_t)(layer & 0xF) << 60;
+
+	if(translucent)
+		key |= (uint64_t)1 << 59 | (QUEUE_FIELD_MASK - depth) << 35 | tex << 11;
+	else
+		key |= tex << 35 | depth << 11;
+
+	keyList[numItems].key  = key;
+	keyList[numItems].item = numItems;
+
+	numItems++;
+}
+
+/*
+ * queue_radixSort
+ * LSD radix sort on 8 bit digits. All histograms are built in one read,
+ * and any digit that is the same for every key is skipped entirely, which
+ * in practice drops most of the eight passes.
+ */
+static void queue_radixSort()
+{
+	unsigned int	counts[8][256], offsets[256], sum;
+	queue_key_t		*src = keyList, *dst = keyScratch, *tmp;
+	int				i, pass, digit;
+
+	memset(counts, 0, sizeof(counts));
+
+	for(i = 0; i < numItems; i++)
+		for(pass = 0; pass < 8; pass++)
+			counts[pass][(keyList[i].key >> (pass * 8)) & 0xFF]++;
+
+	for(pass = 0; pass < 8; pass++)
+	{
+		if(counts[pass][(keyList[0].key >> (pass * 8)) & 0xFF] == (unsigned int)numItems)
+			continue;
+
+		for(sum = 0, digit = 0; digit < 256; digit++)
+		{
+			offsets[digit] = sum;
+			sum += counts[pass][digit];
+		}
+
+		for(i = 0; i < numItems; i++)
+			dst[offsets[(src[i].key >> (pass * 8)) & 0xFF]++] = src[i];
+
+		tmp = src; src = dst; dst = tmp;
+	}
+
+	if(src != keyList)
+		memcpy(keyList, src, sizeof(queue_key_t) * numItems);
+}
+
+/*
+ * renderer_queue_flush
+ * Sorts and submits everything added since renderer_queue_begin.
+ */
+void renderer_queue_flush()
+{
+	queue_item_t	*item;
+	int				i, curSource = QUEUE_SOURCE_NONE, curTex = -1, drawPass = -1;
+	eboolean		depthWrites = etrue;
+
+	lastBinds = 0;
+
+	if(numItems == 0)
+		return;
+
+	queue_radixSort();
+
+	for(i = 0; i < numItems; i++)
+	{
+		item = &itemList[keyList[i].item];
+
+		if(item->pass != drawPass)
+		{
+			renderer_profile_mark(item->pass);
+			drawPass = item->pass;
+		}
+
+		if(item->source != curSource)
+		{
+			if(sourceList[curSource].end)
+				sourceList[curSource].end();
+
+			curSource = item->source;
+
+			if(sourceList[curSource].begin)
+				sourceList[curSource].begin();
+
+			statSwitches++;
+		}
+
+		if(item->glTexID > 0 && item->glTexID != curTex)
+		{
+			renderer_img_touchTexture(item->glTexID);
+			glBindTexture(GL_TEXTURE_2D, item->glTexID);
+			curTex = item->glTexID;
+			lastBinds++;
+		}
+
+		//Translucent surfaces test against depth but don't write it
+		if(item->translucent == depthWrites)
+		{
+			depthWrites = !item->translucent;
+			glDepthMask(depthWrites ? GL_TRUE : GL_FALSE);
+		}
+
+		item->draw(item->param);
+	}
+
+	if(sourceList[curSource].end)
+		sourceList[curSource].end();
+
+	if(!depthWrites)
+		glDepthMask(GL_TRUE);
+
+	statFrames++;
+	statItems += numItems;
+	statBinds += lastBinds;
+}
+
+/*
+ * renderer_queue_printStats
+ */
+void renderer_queue_printStats()
+{
+	if(statFrames == 0)
+		return;
+
+	printf("Render queue: %.1f items, %.1f texture binds, %.1f source switches per frame (last frame %u binds).\n",
+			(float)statItems / statFrames, (float)statBinds / statFrames,
+			(float)statSwitches / statFrames, lastBinds);
+}
@@ -0,0 +1,41 @@
+/*
+===========================================================================
+File:		renderer_queue.h
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+===========================================================================
+*/
+
+#ifndef RENDERER_QUEUE_H_
+#define RENDERER_QUEUE_H_
+
+#include "common.h"
+#include "vmath.h"
+
+//Layers are drawn in this order. Translucent world items are moved into
+//QUEUE_LAYER_TRANSLUCENT automatically so they land after the sky.
+//QUEUE_LAYER_OCCLUSION runs once the opaque world has filled the depth
+//buffer, for occlusion query proxies.
+#define QUEUE_LAYER_WORLD		0
+#define QUEUE_LAYER_OCCLUSION	1
+#define QUEUE_LAYER_SKY			2
+#define QUEUE_LAYER_TRANSLUCENT	3
+#define QUEUE_LAYER_HUD			4
+
+//Items without a vertex source (display lists, immediate mode)
+#define QUEUE_SOURCE_NONE		0
+
+typedef void (*renderer_queue_func_t)(int param);
+
+int  renderer_queue_addSource(void (*begin)(void), void (*end)(void));
+
+void renderer_queue_begin(const mat4_t viewMatrix);
+void renderer_queue_getViewOrigin(vec3_t origin);
+void renderer_queue_setPass(int pass);
+void renderer_queue_add(int layer, eboolean translucent, int glTexID, const vec3_t center,
+		int source, renderer_queue_func_t draw, int param);
+void renderer_queue_flush();
+
+void renderer_queue_printStats();
+
+#endif /* RENDERER_QUEUE_H_ */
@@ -0,0 +1,199 @@
+/*
+===========================================================================
+File:		renderer_sky.c
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+Description:	Cubemap skybox. The sky is drawn after the opaque world with
+				its depth pinned to the far plane, so only pixels nothing
+				else covered are ever shaded.
+===========================================================================
+*/
+
+#define GL_GLEXT_PROTOTYPES
+
+#include <SDL/SDL_opengl.h>
+
+#include "common.h"
+#include "renderer_materials.h"
+#include "renderer_sky.h"
+#include "system_memory.h"
+
+#define SKY_NUM_VERTS 36
+
+static GLuint	skyTexture;
+static GLuint	skyBuffer;
+static eboolean	skyLoaded = efalse;
+
+//Fill rate accounting. Queries are read a frame late so we never wait on them.
+static GLuint	skyQueries[2];
+static int		skyQueryFrame = 0;
+static double	skySamples = 0, skyPixels = 0;
+
+//Two triangles per face, wound to face inward. The positions double as the
+//cubemap lookup direction.
+static const GLfloat skyVerts[SKY_NUM_VERTS * 3] =
+{
+	//+X
+	 1, -1, -1,   1, -1,  1,   1,  1,  1,
+	 1, -1, -1,   1,  1,  1,   1,  1, -1,
+	//-X
+	-1, -1,  1,  -1, -1, -1,  -1,  1, -1,
+	-1, -1,  1,  -1,  1, -1,  -1,  1,  1,
+	//+Y
+	-1,  1, -1,   1,  1, -1,   1,  1,  1,
+	-1,  1, -1,   1,  1,  1,  -1,  1,  1,
+	//-Y
+	-1, -1,  1,   1, -1,  1,   1, -1, -1,
+	-1, -1,  1,   1, -1, -1,  -1, -1, -1,
+	//+Z
+	 1, -1,  1,  -1, -1,  1,  -1,  1,  1,
+	 1, -1,  1,  -1,  1,  1,   1,  1,  1,
+	//-Z
+	-1, -1, -1,   1, -1, -1,   1,  1, -1,
+	-1, -1, -1,   1,  1, -1,  -1,  1, -1,
+};
+
+/*
+ * renderer_sky_init
+ * Decodes the sky image once and uploads it to all six cubemap faces, then
+ * builds the static cube buffer. Safe to call more than once.
+ */
+void renderer_sky_init(char *name)
+{
+	int		width, height, bpp;
+	byte	*imageData;
+
+	if(skyLoaded)
+		return;
+
+	imageData = renderer_img_decodeTGA(name, &width, &height, &bpp);
+
+	if(imageData == NULL)
+		return;
+
+	renderer_sky_initFromImage(imageData, width, height, bpp);
+
+	memory_free(imageData);
+}
+
+/*
+ * renderer_sky_initFromImage
+ * Same as renderer_sky_init, with the image already decoded. The caller
+ * keeps ownership of imageData.
+ */
+void renderer_sky_initFromImage(byte *imageData, int width, int height, int bpp)
+{
+	int		i;
+	GLenum	type;
+
+	if(skyLoaded || imageData == NULL)
+		return;
+
+	type = (bpp == 24) ? GL_RGB : GL_RGBA;
+
+	glGenTextures(1, &skyTexture);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, skyTexture);
+
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	for(i = 0; i < 6; i++)
+		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, type, width, height,
+				0, type, GL_UNSIGNED_BYTE, imageData);
+
+	glGenBuffers(1, &skyBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, skyBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(skyVerts), skyVerts, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	memory_trackGPU(MEMORY_TAG_TEXTURES, 6 * width * height * (bpp / 8), 1);
+	memory_trackGPU(MEMORY_TAG_RENDERER, sizeof(skyVerts), 1);
+
+	glGenQueries(2, skyQueries);
+
+	skyLoaded = etrue;
+}
+
+/*
+ * renderer_sky_draw
+ * Call after the opaque world. rotMatrix is the camera rotation without
+ * translation; the caller's modelview is left untouched.
+ */
+void renderer_sky_draw(const mat4_t rotMatrix)
+{
+	GLuint	query, samples, available;
+	GLint	viewport[4];
+
+	if(!skyLoaded)
+		return;
+
+	//Collect what this query object counted two frames ago, if the GPU is done
+	query = skyQueries[skyQueryFrame & 1];
+	if(skyQueryFrame >= 2)
+	{
+		glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if(available)
+		{
+			glGetQueryObjectuiv(query, GL_QUERY_RESULT, &samples);
+			glGetIntegerv(GL_VIEWPORT, viewport);
+
+			skySamples += samples;
+			skyPixels  += viewport[2] * viewport[3];
+		}
+	}
+
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadMatrixf(rotMatrix);
+
+	//Pin every sky fragment to the far plane. The depth buffer was cleared
+	//to 1.0, so only untouched pixels pass.
+	glDepthRange(1.0, 1.0);
+	glDepthFunc(GL_LEQUAL);
+	glDepthMask(GL_FALSE);
+
+	glDisable(GL_TEXTURE_2D);
+	glEnable(GL_TEXTURE_CUBE_MAP);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, skyTexture);
+
+	glBindBuffer(GL_ARRAY_BUFFER, skyBuffer);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, 0);
+	glTexCoordPointer(3, GL_FLOAT, 0, 0);
+
+	glBeginQuery(GL_SAMPLES_PASSED, query);
+	glDrawArrays(GL_TRIANGLES, 0, SKY_NUM_VERTS);
+	glEndQuery(GL_SAMPLES_PASSED);
+	skyQueryFrame++;
+
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glDisable(GL_TEXTURE_CUBE_MAP);
+	glEnable(GL_TEXTURE_2D);
+
+	glDepthMask(GL_TRUE);
+	glDepthFunc(GL_LESS);
+	glDepthRange(0.0, 1.0);
+
+	glPopMatrix();
+}
+
+/*
+ * renderer_sky_printStats
+ * The old sky was six full quads drawn first, so it shaded every pixel at
+ * least once. This reports how much of that the far-plane pass still pays.
+ */
+void renderer_sky_printStats()
+{
+	if(skyPixels <= 0)
+		return;
+
+	printf("Sky: shaded %.0f of %.0f pixels (%.1f%%), saved %.1f%% of the old sky fill.\n",
+			skySamples, skyPixels, 100.0 * skySamples / skyPixels,
+			100.0 * (1.0 - skySamples / skyPixels));
+}
@@ -0,0 +1,20 @@
+/*
+===========================================================================
+File:		renderer_sky.h
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+===========================================================================
+*/
+
+#ifndef RENDERER_SKY_H_
+#define RENDERER_SKY_H_
+
+#include "common.h"
+#include "vmath.h"
+
+void renderer_sky_init(char *name);
+void renderer_sky_initFromImage(byte *imageData, int width, int height, int bpp);
+void renderer_sky_draw(const mat4_t rotMatrix);
+void renderer_sky_printStats();
+
+#endif /* RENDERER_SKY_H_ */
@@ -0,0 +1,568 @@
+/*
+===========================================================================
+File:		renderer_terrain.c
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+Description:	Heightfield terrain, geomipmapped. The heightmap is cut into
+				square patches of TERRAIN_PATCH_CELLS cells that all share
+				one vertex buffer. Every patch is drawn at one of
+				TERRAIN_NUM_LODS levels, where level n skips every 2^n
+				samples. Where a neighbour is one level coarser, the
+				odd vertices along that edge are folded onto their even
+				neighbours so the two meshes meet without cracks. Index
+				lists for every level and edge combination are built once
+				and shared by all patches.
+
+				Patches are selected by walking a min/max quadtree: whole
+				subtrees outside the view frustum are skipped, so the cost
+				of a frame depends on what is visible, not on map size.
+===========================================================================
+*/
+
+#define GL_GLEXT_PROTOTYPES
+
+#include <SDL/SDL.h>
+#include <SDL/SDL_opengl.h>
+#include <string.h>
+
+#include "common.h"
+#include "renderer_materials.h"
+#include "renderer_queue.h"
+#include "renderer_terrain.h"
+#include "system_memory.h"
+
+#define TERRAIN_PATCH_SHIFT		5
+#define TERRAIN_PATCH_CELLS		(1 << TERRAIN_PATCH_SHIFT)
+#define TERRAIN_NUM_LODS		(TERRAIN_PATCH_SHIFT + 1)
+#define TERRAIN_MAX_LEVELS		16
+
+//A patch stays at full detail until it is this many patch widths away, and
+//each doubling of distance drops one level. Anything >= 1 guarantees that
+//edge neighbours never differ by more than one level.
+#define TERRAIN_LOD_DISTANCE	2.0f
+
+//Samples per texture repeat
+#define TERRAIN_TEX_CELLS		16.0f
+
+//Edge flags, set when that neighbour is one level coarser
+#define STITCH_NORTH			1		//-z
+#define STITCH_SOUTH			2		//+z
+#define STITCH_WEST				4		//-x
+#define STITCH_EAST				8		//+x
+#define STITCH_COMBINATIONS		16
+
+//Patch index, level and edge flags packed into a render queue param
+#define PATCH_PARAM(patch, lod, mask)	(((patch) << 7) | ((lod) << 4) | (mask))
+
+//Sample coordinates in x/z, raw height in y. Scaled into world space by the
+//modelview, which keeps the vertex at 8 bytes.
+typedef struct
+{
+	GLshort	x, y, z, pad;
+}
+terrain_vertex_t;
+
+static eboolean	terrainLoaded = efalse;
+static GLuint	vertexBuffer = 0, indexBuffer = 0;
+static int		bufferBytes = 0;
+static int		terrainTexture;
+static int		terrainSource = -1;
+
+static int		gridW, gridH;				//vertices, padded to whole patches
+static int		patchesX, patchesZ;
+static vec3_t	corner;						//world position of sample (0, 0)
+static float	spacing, heightScale, midY;
+
+static int		lodFirst[TERRAIN_NUM_LODS][STITCH_COMBINATIONS];
+static int		lodCount[TERRAIN_NUM_LODS][STITCH_COMBINATIONS];
+
+//Min/max raw height per quadtree node, level 0 is one node per patch
+static int		numLevels;
+static int		levelW[TERRAIN_MAX_LEVELS], levelH[TERRAIN_MAX_LEVELS];
+static byte		*levelMin[TERRAIN_MAX_LEVELS], *levelMax[TERRAIN_MAX_LEVELS];
+
+//Per frame
+static vec4_t	frustum[6];
+static vec3_t	eyePos;
+
+static unsigned int	statFrames = 0;
+static double		statPatches = 0, statTris = 0, statNodes = 0;
+
+/*
+ * terrain_stitchIndex
+ * Index of sample (x, z) within a patch, relative to the patch's first
+ * vertex. Odd vertices on stitched edges are moved onto the even vertex
+ * before them, leaving a degenerate triangle the caller drops.
+ */
+static GLuint terrain_stitchIndex(int x, int z, int step, int mask)
+{
+	if(z == 0 && (mask & STITCH_NORTH) && ((x / step) & 1))
+		x -= step;
+	if(z == TERRAIN_PATCH_CELLS && (mask & STITCH_SOUTH) && ((x / step) & 1))
+		x -= step;
+	if(x == 0 && (mask & STITCH_WEST) && ((z / step) & 1))
+		z -= step;
+	if(x == TERRAIN_PATCH_CELLS && (mask & STITCH_EAST) && ((z / step) & 1))
+		z -= step;
+
+	return z * gridW + x;
+}
+
+/*
+ * terrain_buildIndices
+ * Writes the triangle list for one level and edge combination to out, and
+ * returns the number of indices.
+ */
+static int terrain_buildIndices(GLuint *out, int lod, int mask)
+{
+	static const int	triOrder[6] = {0, 1, 2, 2, 1, 3};
+	GLuint				corners[4];
+	int					step, x, z, i, n;
+
+	step = 1 << lod;
+	n = 0;
+
+	for(z = 0; z < TERRAIN_PATCH_CELLS; z += step)
+		for(x = 0; x < TERRAIN_PATCH_CELLS; x += step)
+		{
+			corners[0] = terrain_stitchIndex(x,		 z,		 step, mask);
+			corners[1] = terrain_stitchIndex(x,		 z+step, step, mask);
+			corners[2] = terrain_stitchIndex(x+step, z,		 step, mask);
+			corners[3] = terrain_stitchIndex(x+step, z+step, step, mask);
+
+			for(i = 0; i < 6; i += 3)
+			{
+				GLuint a = corners[triOrder[i]], b = corners[triOrder[i+1]], c = corners[triOrder[i+2]];
+
+				if(a == b || b == c || a == c)
+					continue;
+
+				out[n++] = a;
+				out[n++] = b;
+				out[n++] = c;
+			}
+		}
+
+	return n;
+}
+
+/*
+ * terrain_buildTree
+ * Fills the min/max pyramid from the raw heights.
+ */
+static void terrain_buildTree(const byte *heights)
+{
+	int l, x, z, px, pz, i, j, w, h;
+	byte lo, hi, v;
+
+	levelW[0] = patchesX;
+	levelH[0] = patchesZ;
+	levelMin[0] = (byte *)memory_alloc(MEMORY_TAG_TERRAIN, patchesX * patchesZ);
+	levelMax[0] = (byte *)memory_alloc(MEMORY_TAG_TERRAIN, patchesX * patchesZ);
+
+	for(pz = 0; pz < patchesZ; pz++)
+		for(px = 0; px < patchesX; px++)
+		{
+			lo = 255; hi = 0;
+
+			for(z = 0; z <= TERRAIN_PATCH_CELLS; z++)
+				for(x = 0; x <= TERRAIN_PATCH_CELLS; x++)
+				{
+					v = heights[(pz*TERRAIN_PATCH_CELLS + z) * gridW + px*TERRAIN_PATCH_CELLS + x];
+					if(v < lo) lo = v;
+					if(v > hi) hi = v;
+				}
+
+			levelMin[0][pz * patchesX + px] = lo;
+			levelMax[0][pz * patchesX + px] = hi;
+		}
+
+	for(l = 1; l < TERRAIN_MAX_LEVELS && (levelW[l-1] > 1 || levelH[l-1] > 1); l++)
+	{
+		w = levelW[l] = (levelW[l-1] + 1) / 2;
+		h = levelH[l] = (levelH[l-1] + 1) / 2;
+		levelMin[l] = (byte *)memory_alloc(MEMORY_TAG_TERRAIN, w * h);
+		levelMax[l] = (byte *)memory_alloc(MEMORY_TAG_TERRAIN, w * h);
+
+		for(z = 0; z < h; z++)
+			for(x = 0; x < w; x++)
+			{
+				lo = 255; hi = 0;
+
+				for(j = 2*z; j <= 2*z+1 && j < levelH[l-1]; j++)
+					for(i = 2*x; i <= 2*x+1 && i < levelW[l-1]; i++)
+					{
+						if(levelMin[l-1][j * levelW[l-1] + i] < lo) lo = levelMin[l-1][j * levelW[l-1] + i];
+						if(levelMax[l-1][j * levelW[l-1] + i] > hi) hi = levelMax[l-1][j * levelW[l-1] + i];
+					}
+
+				levelMin[l][z * w + x] = lo;
+				levelMax[l][z * w + x] = hi;
+			}
+	}
+
+	numLevels = l;
+}
+
+/*
+ * renderer_terrain_init
+ * Loads an 8 bit grayscale (or the red channel of a 24/32 bit) TGA as a
+ * heightmap. origin is the world position of the map's centre at height 0;
+ * samples are spacing apart and each step of the 0-255 range is heightScale
+ * units. The whole map lives in one static vertex buffer, about 8 bytes per
+ * sample.
+ */
+eboolean renderer_terrain_init(char *heightmap, int glTexID, const vec3_t origin,
+		float spacing_, float heightScale_)
+{
+	byte				*image, *heights;
+	terrain_vertex_t	*v;
+	GLuint				*indices;
+	int					w, h, bpp, x, z, lod, mask, total;
+	Uint32				start;
+
+	renderer_terrain_free();
+	start = SDL_GetTicks();
+
+	image = renderer_img_decodeTGA(heightmap, &w, &h, &bpp);
+	if(image == NULL)
+		return efalse;
+
+	patchesX = (w - 1 + TERRAIN_PATCH_CELLS - 1) / TERRAIN_PATCH_CELLS;
+	patchesZ = (h - 1 + TERRAIN_PATCH_CELLS - 1) / TERRAIN_PATCH_CELLS;
+
+	if(patchesX < 1 || patchesZ < 1 || w > 32767 || h > 32767)
+	{
+		printf("Terrain: %s, unusable heightmap size %dx%d.\n", heightmap, w, h);
+		memory_free(image);
+		return efalse;
+	}
+
+	gridW = patchesX * TERRAIN_PATCH_CELLS + 1;
+	gridH = patchesZ * TERRAIN_PATCH_CELLS + 1;
+
+	//Pull out one channel, repeating the last row/column to fill whole patches
+	heights = (byte *)memory_alloc(MEMORY_TAG_TERRAIN, gridW * gridH);
+	for(z = 0; z < gridH; z++)
+		for(x = 0; x < gridW; x++)
+			heights[z * gridW + x] = image[((z < h ? z : h-1) * w + (x < w ? x : w-1)) * (bpp / 8)];
+	memory_free(image);
+
+	spacing		= spacing_;
+	heightScale = heightScale_;
+	corner[_X]	= origin[_X] - 0.5f * (w - 1) * spacing;
+	corner[_Y]	= origin[_Y];
+	corner[_Z]	= origin[_Z] - 0.5f * (h - 1) * spacing;
+
+	terrain_buildTree(heights);
+	midY = corner[_Y] + 0.5f * (levelMin[numLevels-1][0] + levelMax[numLevels-1][0]) * heightScale;
+
+	//Vertices, written straight into the mapped buffer so a large map isn't
+	//held in memory twice
+	glGenBuffers(1, &vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(terrain_vertex_t) * gridW * gridH, NULL, GL_STATIC_DRAW);
+	bufferBytes = sizeof(terrain_vertex_t) * gridW * gridH;
+	memory_trackGPU(MEMORY_TAG_TERRAIN, bufferBytes, 1);
+
+	v = (terrain_vertex_t *)glMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+	if(v == NULL)
+	{
+		printf("Terrain: %s, could not map a %dx%d vertex buffer.\n", heightmap, gridW, gridH);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		memory_free(heights);
+		renderer_terrain_free();
+		return efalse;
+	}
+
+	for(z = 0; z < gridH; z++)
+		for(x = 0; x < gridW; x++, v++)
+		{
+			v->x   = x;
+			v->y   = heights[z * gridW + x];
+			v->z   = z;
+			v->pad = 0;
+		}
+
+	glUnmapBuffer(GL_ARRAY_BUFFER);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	memory_free(heights);
+
+	//Index lists for every level and edge combination, back to back
+	indices = (GLuint *)memory_alloc(MEMORY_TAG_TERRAIN, sizeof(GLuint) * TERRAIN_NUM_LODS * STITCH_COMBINATIONS *
+			TERRAIN_PATCH_CELLS * TERRAIN_PATCH_CELLS * 6);
+	total = 0;
+
+	for(lod = 0; lod < TERRAIN_NUM_LODS; lod++)
+		for(mask = 0; mask < STITCH_COMBINATIONS; mask++)
+		{
+			lodFirst[lod][mask] = total;
+			lodCount[lod][mask] = terrain_buildIndices(indices + total, lod, mask);
+			total += lodCount[lod][mask];
+		}
+
+	glGenBuffers(1, &indexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint) * total, indices, GL_STATIC_DRAW);
+	bufferBytes += sizeof(GLuint) * total;
+	memory_trackGPU(MEMORY_TAG_TERRAIN, sizeof(GLuint) * total, 1);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	memory_free(indices);
+
+	terrainTexture = glTexID;
+	terrainLoaded  = etrue;
+
+	printf("Terrain: %s, %dx%d samples, %dx%d patches, %d quadtree levels, %.1f MB of buffers, loaded in %u ms.\n",
+			heightmap, w, h, patchesX, patchesZ, numLevels, bufferBytes / (1024.0 * 1024.0), SDL_GetTicks() - start);
+
+	return etrue;
+}
+
+/*
+ * renderer_terrain_free
+ */
+void renderer_terrain_free()
+{
+	int l;
+
+	memory_trackGPU(MEMORY_TAG_TERRAIN, -bufferBytes, -(vertexBuffer != 0) - (indexBuffer != 0));
+
+	if(vertexBuffer)
+		glDeleteBuffers(1, &vertexBuffer);
+	if(indexBuffer)
+		glDeleteBuffers(1, &indexBuffer);
+	vertexBuffer = indexBuffer = 0;
+	bufferBytes  = 0;
+
+	for(l = 0; l < numLevels; l++)
+	{
+		memory_free(levelMin[l]);
+		memory_free(levelMax[l]);
+	}
+	numLevels = 0;
+
+	terrainLoaded = efalse;
+}
+
+static void terrain_beginSource()
+{
+	static const GLfloat planeS[4] = {1.0f / TERRAIN_TEX_CELLS, 0, 0, 0};
+	static const GLfloat planeT[4] = {0, 0, 1.0f / TERRAIN_TEX_CELLS, 0};
+
+	glPushMatrix();
+	glTranslatef(corner[_X], corner[_Y], corner[_Z]);
+	glScalef(spacing, heightScale, spacing);
+
+	//Texture coordinates come from the sample position, so the buffer
+	//doesn't have to store them
+	glTexGeni(GL_S, GL_TEXTURE_GEN_MODE, GL_OBJECT_LINEAR);
+	glTexGeni(GL_T, GL_TEXTURE_GEN_MODE, GL_OBJECT_LINEAR);
+	glTexGenfv(GL_S, GL_OBJECT_PLANE, planeS);
+	glTexGenfv(GL_T, GL_OBJECT_PLANE, planeT);
+	glEnable(GL_TEXTURE_GEN_S);
+	glEnable(GL_TEXTURE_GEN_T);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	glEnableClientState(GL_VERTEX_ARRAY);
+}
+
+static void terrain_endSource()
+{
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glDisable(GL_TEXTURE_GEN_T);
+	glDisable(GL_TEXTURE_GEN_S);
+
+	glPopMatrix();
+}
+
+/*
+ * terrain_drawPatch
+ * Render queue callback. Moving the vertex pointer to the patch's first
+ * sample is what lets every patch share the same index lists.
+ */
+static void terrain_drawPatch(int param)
+{
+	int patch, lod, mask, px, pz;
+
+	patch = param >> 7;
+	lod   = (param >> 4) & 7;
+	mask  = param & 15;
+	px	  = patch % patchesX;
+	pz	  = patch / patchesX;
+
+	glVertexPointer(3, GL_SHORT, sizeof(terrain_vertex_t), (void *)(sizeof(terrain_vertex_t) *
+			((size_t)pz * TERRAIN_PATCH_CELLS * gridW + px * TERRAIN_PATCH_CELLS)));
+	glDrawElements(GL_TRIANGLES, lodCount[lod][mask], GL_UNSIGNED_INT,
+			(void *)(sizeof(GLuint) * lodFirst[lod][mask]));
+}
+
+/*
+ * terrain_patchLod
+ * Detail level from the distance to the patch centre, measured at a fixed
+ * height so that neighbouring centres are exactly one patch width apart.
+ */
+static int terrain_patchLod(int px, int pz)
+{
+	float dx, dy, dz, d;
+	int lod;
+
+	dx = corner[_X] + (px + 0.5f) * TERRAIN_PATCH_CELLS * spacing - eyePos[_X];
+	dy = midY - eyePos[_Y];
+	dz = corner[_Z] + (pz + 0.5f) * TERRAIN_PATCH_CELLS * spacing - eyePos[_Z];
+
+	d = sqrtf(dx*dx + dy*dy + dz*dz) / (TERRAIN_LOD_DISTANCE * TERRAIN_PATCH_CELLS * spacing);
+
+	for(lod = 0; d >= 2.0f && lod < TERRAIN_NUM_LODS-1; lod++)
+		d *= 0.5f;
+
+	return lod;
+}
+
+static void terrain_queuePatch(int px, int pz, const vec3_t mins, const vec3_t maxs)
+{
+	vec3_t	center;
+	int		lod, mask;
+
+	lod  = terrain_patchLod(px, pz);
+	mask = 0;
+
+	if(pz > 0			&& terrain_patchLod(px, pz-1) > lod) mask |= STITCH_NORTH;
+	if(pz < patchesZ-1	&& terrain_patchLod(px, pz+1) > lod) mask |= STITCH_SOUTH;
+	if(px > 0			&& terrain_patchLod(px-1, pz) > lod) mask |= STITCH_WEST;
+	if(px < patchesX-1	&& terrain_patchLod(px+1, pz) > lod) mask |= STITCH_EAST;
+
+	center[_X] = 0.5f * (mins[_X] + maxs[_X]);
+	center[_Y] = 0.5f * (mins[_Y] + maxs[_Y]);
+	center[_Z] = 0.5f * (mins[_Z] + maxs[_Z]);
+
+	renderer_queue_add(QUEUE_LAYER_WORLD, efalse, terrainTexture, center, terrainSource,
+			terrain_drawPatch, PATCH_PARAM(pz * patchesX + px, lod, mask));
+
+	statPatches++;
+	statTris += lodCount[lod][mask] / 3;
+}
+
+/*
+ * terrain_visitNode
+ * inside has a bit set for each frustum plane the parent was already fully
+ * inside of, those planes are not tested again further down.
+ */
+static void terrain_visitNode(int level, int nx, int nz, int inside)
+{
+	vec3_t	mins, maxs;
+	float	cellWorld;
+	int		i, first, last, idx;
+
+	if(nx >= levelW[level] || nz >= levelH[level])
+		return;
+
+	statNodes++;
+
+	idx		  = nz * levelW[level] + nx;
+	cellWorld = TERRAIN_PATCH_CELLS * spacing;
+
+	first = nx << level;
+	last  = (nx + 1) << level;
+	if(last > patchesX)
+		last = patchesX;
+	mins[_X] = corner[_X] + first * cellWorld;
+	maxs[_X] = corner[_X] + last  * cellWorld;
+
+	first = nz << level;
+	last  = (nz + 1) << level;
+	if(last > patchesZ)
+		last = patchesZ;
+	mins[_Z] = corner[_Z] + first * cellWorld;
+	maxs[_Z] = corner[_Z] + last  * cellWorld;
+
+	mins[_Y] = corner[_Y] + levelMin[level][idx] * heightScale;
+	maxs[_Y] = corner[_Y] + levelMax[level][idx] * heightScale;
+
+	for(i = 0; i < 6; i++)
+	{
+		const vec_t *p = frustum[i];
+
+		if(inside & (1 << i))
+			continue;
+
+		//Farthest corner along the plane normal is behind it: all outside
+		if(p[0] * (p[0] > 0 ? maxs[_X] : mins[_X]) +
+		   p[1] * (p[1] > 0 ? maxs[_Y] : mins[_Y]) +
+		   p[2] * (p[2] > 0 ? maxs[_Z] : mins[_Z]) + p[3] < 0)
+			return;
+
+		//Nearest corner is in front of it: all inside
+		if(p[0] * (p[0] > 0 ? mins[_X] : maxs[_X]) +
+		   p[1] * (p[1] > 0 ? mins[_Y] : maxs[_Y]) +
+		   p[2] * (p[2] > 0 ? mins[_Z] : maxs[_Z]) + p[3] >= 0)
+			inside |= 1 << i;
+	}
+
+	if(level == 0)
+	{
+		terrain_queuePatch(nx, nz, mins, maxs);
+		return;
+	}
+
+	terrain_visitNode(level-1, 2*nx,   2*nz,   inside);
+	terrain_visitNode(level-1, 2*nx+1, 2*nz,   inside);
+	terrain_visitNode(level-1, 2*nx,   2*nz+1, inside);
+	terrain_visitNode(level-1, 2*nx+1, 2*nz+1, inside);
+}
+
+/*
+ * renderer_terrain_queue
+ * Submits every patch that intersects the view frustum. Call between
+ * renderer_queue_begin and renderer_queue_flush; uses the projection matrix
+ * currently loaded in GL.
+ */
+void renderer_terrain_queue(const mat4_t viewMatrix, const vec3_t eye)
+{
+	mat4_t	proj, clip;
+	int		i;
+
+	if(!terrainLoaded)
+		return;
+
+	if(terrainSource < 0)
+		terrainSource = renderer_queue_addSource(terrain_beginSource, terrain_endSource);
+
+	glGetFloatv(GL_PROJECTION_MATRIX, proj);
+	mat4_multiply(proj, viewMatrix, clip);
+
+	//Planes are row 3 +/- rows 0..2 of the column-major clip matrix
+	for(i = 0; i < 3; i++)
+	{
+		frustum[i*2+0][0] = clip[3]  + clip[i];
+		frustum[i*2+0][1] = clip[7]  + clip[4+i];
+		frustum[i*2+0][2] = clip[11] + clip[8+i];
+		frustum[i*2+0][3] = clip[15] + clip[12+i];
+
+		frustum[i*2+1][0] = clip[3]  - clip[i];
+		frustum[i*2+1][1] = clip[7]  - clip[4+i];
+		frustum[i*2+1][2] = clip[11] - clip[8+i];
+		frustum[i*2+1][3] = clip[15] - clip[12+i];
+	}
+
+	VectorCopy(eye, eyePos);
+
+	terrain_visitNode(numLevels-1, 0, 0, 0);
+
+	statFrames++;
+}
+
+/*
+ * renderer_terrain_printStats
+ */
+void renderer_terrain_printStats()
+{
+	if(!statFrames)
+		return;
+
+	printf("Terrain: %.1f patches, %.0f triangles, %.1f quadtree nodes visited per frame.\n",
+			statPatches / statFrames, statTris / statFrames, statNodes / statFrames);
+}
@@ -0,0 +1,21 @@
+/*
+===========================================================================
+File:		renderer_terrain.h
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+===========================================================================
+*/
+
+#ifndef RENDERER_TERRAIN_H_
+#define RENDERER_TERRAIN_H_
+
+#include "common.h"
+#include "vmath.h"
+
+eboolean renderer_terrain_init(char *heightmap, int glTexID, const vec3_t origin,
+		float spacing, float heightScale);
+void     renderer_terrain_queue(const mat4_t viewMatrix, const vec3_t eye);
+void     renderer_terrain_free();
+void     renderer_terrain_printStats();
+
+#endif /* RENDERER_TERRAIN_H_ */
@@ -0,0 +1,424 @@
+/*
+===========================================================================
+File:		renderer_textures.c
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+Description:	Texture residency. Every texture loaded from a file is
+				tracked with its size in bytes and the frame it was last
+				bound. Once the resident total passes the budget, the
+				least recently used textures are swapped down to a small
+				thumbnail (their lowest useful mip level) in place, so the
+				GL name stays valid everywhere it is referenced. The next
+				time an evicted texture is bound it draws with the
+				thumbnail straight away while the full image is decoded
+				from its file again on the job workers, and is uploaded
+				on the GL thread once the pixels are ready.
+===========================================================================
+*/
+
+#include <SDL/SDL_opengl.h>
+#include <string.h>
+
+#include "common.h"
+#include "files.h"
+#include "renderer_materials.h"
+#include "system_jobs.h"
+#include "system_memory.h"
+
+//Longest side of the thumbnail kept in memory for every tracked texture
+#define TEX_THUMB_SIZE			32
+
+//Textures bound within this many frames are never evicted
+#define TEX_EVICT_GRACE			2
+
+#define TEX_RELOADS_PER_FRAME	1
+#define TEX_MAX_DECODES			4
+
+#define TEX_DEFAULT_BUDGET		(64 * 1024 * 1024)
+
+typedef enum
+{
+	TEX_UNTRACKED,
+	TEX_FULL,
+	TEX_THUMB,
+	TEX_RELOAD,				//thumbnail bound, full image wanted
+	TEX_DECODING			//thumbnail bound, full image on the way
+}
+tex_state_t;
+
+//A full image being decoded on the job workers. Allocated on its own, since
+//texList can move while the job runs.
+typedef struct
+{
+	char			name[MAX_FILEPATH];
+	byte			*pixels;
+	int				width, height, bpp;
+	jobs_counter_t	decoded;
+}
+tex_decode_t;
+
+typedef struct
+{
+	tex_state_t		state;
+	char			name[MAX_FILEPATH];
+	int				width, height, bpp;
+	unsigned int	bytes;				//currently on the GPU
+	unsigned int	lastUsed;
+
+	byte			*thumb;
+	int				thumbW, thumbH;
+
+	tex_decode_t	*decode;			//while TEX_DECODING
+}
+tex_entry_t;
+
+//Indexed directly by GL texture name
+static tex_entry_t	*texList = NULL;
+static int			texAllocated = 0;
+
+static unsigned int	texFrame = TEX_EVICT_GRACE + 1;
+static unsigned int	texBudget = TEX_DEFAULT_BUDGET;
+static unsigned int	residentBytes = 0, peakBytes = 0;
+static unsigned int	statEvictions = 0, statReloads = 0;
+
+static tex_entry_t * tex_lookup(int glTexID)
+{
+	if(glTexID <= 0 || glTexID >= texAllocated || texList[glTexID].state == TEX_UNTRACKED)
+		return NULL;
+
+	return &texList[glTexID];
+}
+
+/*
+ * tex_makeThumb
+ * Box filters the image down by halves until it fits in TEX_THUMB_SIZE.
+ */
+static void tex_makeThumb(tex_entry_t *tex, const byte *pixels)
+{
+	byte	*src, *dst;
+	int		w, h, nw, nh, c, x, y, k, comps;
+
+	comps = tex->bpp / 8;
+	w = tex->width;
+	h = tex->height;
+
+	src = (byte *)memory_alloc(MEMORY_TAG_IMAGES, w * h * comps);
+	memcpy(src, pixels, w * h * comps);
+
+	while(w > TEX_THUMB_SIZE || h > TEX_THUMB_SIZE)
+	{
+		nw = w > 1 ? w / 2 : 1;
+		nh = h > 1 ? h / 2 : 1;
+		dst = (byte *)memory_alloc(MEMORY_TAG_IMAGES, nw * nh * comps);
+
+		for(y = 0; y < nh; y++)
+			for(x = 0; x < nw; x++)
+				for(c = 0; c < comps; c++)
+				{
+					int x0 = x * w / nw, y0 = y * h / nh;
+					int x1 = x0 + (w > 1), y1 = y0 + (h > 1);
+
+					k  = src[(y0 * w + x0) * comps + c] + src[(y0 * w + x1) * comps + c];
+					k += src[(y1 * w + x0) * comps + c] + src[(y1 * w + x1) * comps + c];
+					dst[(y * nw + x) * comps + c] = (byte)((k + 2) / 4);
+				}
+
+		memory_free(src);
+		src = dst;
+		w = nw;
+		h = nh;
+	}
+
+	memory_free(tex->thumb);
+	tex->thumb	= src;
+	tex->thumbW	= w;
+	tex->thumbH	= h;
+}
+
+static void tex_setResident(tex_entry_t *tex, unsigned int bytes)
+{
+	memory_trackGPU(MEMORY_TAG_TEXTURES, (int)bytes - (int)tex->bytes, 0);
+
+	residentBytes = residentBytes - tex->bytes + bytes;
+	tex->bytes	  = bytes;
+
+	if(residentBytes > peakBytes)
+		peakBytes = residentBytes;
+}
+
+/*
+ * tex_decodeJob
+ * Job worker.
+ */
+static void tex_decodeJob(void *param)
+{
+	tex_decode_t *decode = (tex_decode_t *)param;
+
+	decode->pixels = renderer_img_decodeTGA(decode->name, &decode->width, &decode->height, &decode->bpp);
+}
+
+/*
+ * tex_startDecode
+ */
+static void tex_startDecode(tex_entry_t *tex)
+{
+	tex->decode = (tex_decode_t *)memory_calloc(MEMORY_TAG_IMAGES, 1, sizeof(tex_decode_t));
+	strcpy(tex->decode->name, tex->name);
+	tex->state = TEX_DECODING;
+
+	jobs_submit(&tex->decode->decoded, tex_decodeJob, tex->decode);
+}
+
+/*
+ * tex_cancelDecode
+ * Waits out a decode nothing wants any more and throws the pixels away.
+ */
+static void tex_cancelDecode(tex_entry_t *tex)
+{
+	if(tex->decode == NULL)
+		return;
+
+	jobs_wait(&tex->decode->decoded);
+	memory_free(tex->decode->pixels);
+	memory_free(tex->decode);
+	tex->decode = NULL;
+}
+
+/*
+ * renderer_img_trackTexture
+ * Puts a texture that was just uploaded from pixels under budget control.
+ * name is the file it can be decoded from again.
+ */
+void renderer_img_trackTexture(int glTexID, char *name, byte *pixels, int width, int height, int bpp)
+{
+	tex_entry_t *tex;
+
+	if(glTexID <= 0 || pixels == NULL || name == NULL || !name[0])
+		return;
+
+	if(glTexID >= texAllocated)
+	{
+		int grow = texAllocated ? texAllocated : 64;
+
+		while(grow <= glTexID)
+			grow *= 2;
+
+		texList = (tex_entry_t *)memory_realloc(MEMORY_TAG_TEXTURES, texList, sizeof(tex_entry_t) * grow);
+		memset(texList + texAllocated, 0, sizeof(tex_entry_t) * (grow - texAllocated));
+		texAllocated = grow;
+	}
+
+	tex = &texList[glTexID];
+
+	if(tex->state == TEX_UNTRACKED)
+		memory_trackGPU(MEMORY_TAG_TEXTURES, 0, 1);
+
+	strncpy(tex->name, name, MAX_FILEPATH-1);
+	tex->name[MAX_FILEPATH-1] = '\0';
+	tex->width	  = width;
+	tex->height	  = height;
+	tex->bpp	  = bpp;
+	tex->lastUsed = texFrame;
+	tex->state	  = TEX_FULL;
+
+	tex_makeThumb(tex, pixels);
+	tex_setResident(tex, width * height * (bpp / 8));
+}
+
+/*
+ * renderer_img_deleteTexture
+ * Stops tracking and deletes the GL texture. Use instead of
+ * glDeleteTextures for anything that may be tracked.
+ */
+void renderer_img_deleteTexture(int glTexID)
+{
+	tex_entry_t	*tex;
+	GLuint		id;
+
+	if(glTexID <= 0)
+		return;
+
+	if((tex = tex_lookup(glTexID)) != NULL)
+	{
+		tex_cancelDecode(tex);
+		tex_setResident(tex, 0);
+		memory_trackGPU(MEMORY_TAG_TEXTURES, 0, -1);
+		memory_free(tex->thumb);
+		memset(tex, 0, sizeof(tex_entry_t));
+	}
+
+	id = glTexID;
+	glDeleteTextures(1, &id);
+}
+
+/*
+ * renderer_img_touchTexture
+ * Call whenever a texture is bound for drawing. Cheap, never touches GL.
+ */
+void renderer_img_touchTexture(int glTexID)
+{
+	tex_entry_t *tex;
+
+	if((tex = tex_lookup(glTexID)) == NULL)
+		return;
+
+	tex->lastUsed = texFrame;
+
+	if(tex->state == TEX_THUMB)
+		tex->state = TEX_RELOAD;
+}
+
+/*
+ * tex_evictOne
+ * Drops the least recently used full texture to its thumbnail. Returns
+ * efalse if everything resident is in use.
+ */
+static eboolean tex_evictOne()
+{
+	tex_entry_t	*tex, *oldest = NULL;
+	int			i;
+
+	for(i = 1; i < texAllocated; i++)
+	{
+		tex = &texList[i];
+
+		if(tex->state != TEX_FULL || tex->lastUsed + TEX_EVICT_GRACE >= texFrame)
+			continue;
+
+		if(oldest == NULL || tex->lastUsed < oldest->lastUsed)
+			oldest = tex;
+	}
+
+	if(oldest == NULL)
+		return efalse;
+
+	renderer_img_updateImage(oldest - texList, oldest->thumb, oldest->thumbW, oldest->thumbH, oldest->bpp);
+	tex_setResident(oldest, oldest->thumbW * oldest->thumbH * (oldest->bpp / 8));
+	oldest->state = TEX_THUMB;
+	statEvictions++;
+
+	return etrue;
+}
+
+/*
+ * renderer_img_updateTextures
+ * Once per frame on the GL thread. Uploads a few textures the job workers
+ * finished decoding, starts decoding the ones bound while evicted, then
+ * evicts until the budget is met again.
+ */
+void renderer_img_updateTextures()
+{
+	tex_entry_t		*tex;
+	tex_decode_t	*decode;
+	int				i, reloads, decoding;
+
+	texFrame++;
+
+	for(i = 1, reloads = 0, decoding = 0; i < texAllocated; i++)
+	{
+		tex = &texList[i];
+
+		if(tex->state != TEX_DECODING)
+			continue;
+
+		if(reloads >= TEX_RELOADS_PER_FRAME || !jobs_done(&tex->decode->decoded))
+		{
+			decoding++;
+			continue;
+		}
+
+		decode		= tex->decode;
+		tex->decode	= NULL;
+
+		//Keep drawing the thumbnail if the file went missing
+		if(decode->pixels == NULL)
+		{
+			tex->state = TEX_THUMB;
+			memory_free(decode);
+			continue;
+		}
+
+		renderer_img_updateImage(i, decode->pixels, decode->width, decode->height, decode->bpp);
+
+		tex->width	= decode->width;
+		tex->height = decode->height;
+		tex->bpp	= decode->bpp;
+		tex->state	= TEX_FULL;
+		tex_setResident(tex, tex->width * tex->height * (tex->bpp / 8));
+
+		memory_free(decode->pixels);
+		memory_free(decode);
+		reloads++;
+		statReloads++;
+	}
+
+	for(i = 1; i < texAllocated && decoding < TEX_MAX_DECODES; i++)
+		if(texList[i].state == TEX_RELOAD)
+		{
+			tex_startDecode(&texList[i]);
+			decoding++;
+		}
+
+	while(residentBytes > texBudget && tex_evictOne())
+		;
+}
+
+/*
+ * renderer_img_reloadTexture
+ * Decodes a changed file again and swaps it into every tracked texture that
+ * was loaded from it. Returns how many textures were updated.
+ */
+int renderer_img_reloadTexture(char *name)
+{
+	tex_entry_t	*tex;
+	byte		*pixels = NULL;
+	int			i, count, w, h, bpp;
+
+	for(i = 1, count = 0; i < texAllocated; i++)
+	{
+		tex = &texList[i];
+
+		if(tex->state == TEX_UNTRACKED || !files_sameBaseName(tex->name, name))
+			continue;
+
+		if(pixels == NULL && (pixels = renderer_img_decodeTGA(tex->name, &w, &h, &bpp)) == NULL)
+			return 0;
+
+		//Whatever a worker is decoding may be the old file
+		tex_cancelDecode(tex);
+
+		renderer_img_updateImage(i, pixels, w, h, bpp);
+
+		tex->width	  = w;
+		tex->height	  = h;
+		tex->bpp	  = bpp;
+		tex->state	  = TEX_FULL;
+		tex->lastUsed = texFrame;
+		tex_makeThumb(tex, pixels);
+		tex_setResident(tex, w * h * (bpp / 8));
+
+		count++;
+	}
+
+	memory_free(pixels);
+
+	return count;
+}
+
+/*
+ * renderer_img_setTextureBudget
+ */
+void renderer_img_setTextureBudget(unsigned int bytes)
+{
+	texBudget = bytes;
+}
+
+/*
+ * renderer_img_printTextureStats
+ */
+void renderer_img_printTextureStats()
+{
+	printf("Textures: %.1f MB resident (peak %.1f MB, budget %.1f MB), %u evictions, %u reloads.\n",
+			residentBytes / 1048576.0, peakBytes / 1048576.0, texBudget / 1048576.0,
+			statEvictions, statReloads);
+}
@@ -6,8 +6,262 @@ Created on: Oct 17, 2010
 ===========================================================================
 */
 
+#include <time.h>
+#include <zlib.h>
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+#elif defined(__SSE2__)
+	#include <emmintrin.h>
+#endif
+
 #include "common.h"
 #include "files.h"
+#include "system_memory.h"
+#include "system_pack.h"
+
+/*
+===========================================================================
+Delimiter scanning. Text is classified 64 bytes at a time into a bitmask
+with one bit per byte, set for delimiters, using SSE2 (or AVX2 when the
+build enables it) compares against each delimiter. Shifting the mask by
+one gives the bytes that follow a delimiter, which turns it into masks of
+token starts and ends, and those are pulled out into position lists with
+a count of trailing zeros per token. Tokens are then read straight off the
+lists. Text is indexed a FILES_INDEX_BYTES window at a time so the lists
+stay small whatever the text size. Quotes are rare and found with memchr;
+tokens that a quoted string swallowed are skipped over afterwards.
+===========================================================================
+*/
+
+//Delimiter sets larger than this are classified a byte at a time
+#define FILES_MAX_SIMD_DELIMITERS	8
+
+//Bytes indexed at once, a multiple of 64. At most every other byte starts
+//a token, plus one left open from the window before.
+#define FILES_INDEX_BYTES			4096
+#define FILES_INDEX_TOKENS			(FILES_INDEX_BYTES / 2 + 1)
+
+typedef struct
+{
+	byte			isDelimiter[256];
+	unsigned int	count;
+	char			list[FILES_MAX_SIMD_DELIMITERS];
+}
+files_delimiters_t;
+
+typedef struct
+{
+	const files_delimiters_t	*delimiters;
+	const char					*data;
+	unsigned int				length;
+
+	//Everything before pos has been returned
+	unsigned int				pos, indexedTo;
+	unsigned long long			lastIsDelimiter;
+
+	//Token bounds found in the current window. A start without an end yet
+	//is a token that runs on into the next one.
+	unsigned int				numStarts, numEnds, next;
+	unsigned int				starts[FILES_INDEX_TOKENS];
+	unsigned int				ends[FILES_INDEX_TOKENS];
+}
+files_index_t;
+
+//What the token streams split on. Nulls have always counted as whitespace
+//here, pack entries can contain them.
+static const files_delimiters_t whitespace =
+{
+	{ [' '] = 1, ['\t'] = 1, ['\n'] = 1, ['\r'] = 1, ['\0'] = 1 },
+	5, { ' ', '\t', '\n', '\r', '\0' }
+};
+
+static void files_initDelimiters(files_delimiters_t *set, const char *delimiters)
+{
+	memset(set, 0, sizeof(files_delimiters_t));
+
+	for(; *delimiters; delimiters++)
+	{
+		if(set->isDelimiter[(byte)*delimiters])
+			continue;
+
+		set->isDelimiter[(byte)*delimiters] = 1;
+
+		if(set->count < FILES_MAX_SIMD_DELIMITERS)
+			set->list[set->count] = *delimiters;
+		set->count++;
+	}
+}
+
+/*
+ * files_classify
+ * Returns a mask with bit i set if text[i] is a delimiter, for the first
+ * 64 bytes of text. Bytes past length count as delimiters.
+ */
+static unsigned long long files_classify(const files_delimiters_t *set, const char *text, unsigned int length)
+{
+	unsigned long long	bits = 0;
+	unsigned int		i, j;
+
+#if defined(__AVX2__)
+	__m256i v, m;
+
+	if(length >= 64 && set->count <= FILES_MAX_SIMD_DELIMITERS)
+	{
+		for(i = 0; i < 64; i += 32)
+		{
+			v = _mm256_loadu_si256((const __m256i *)(text + i));
+			m = _mm256_setzero_si256();
+
+			for(j = 0; j < set->count; j++)
+				m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(set->list[j])));
+
+			bits |= (unsigned long long)(unsigned int)_mm256_movemask_epi8(m) << i;
+		}
+
+		return bits;
+	}
+#elif defined(__SSE2__)
+	__m128i v[4], m[4], d;
+
+	if(length >= 64 && set->count <= FILES_MAX_SIMD_DELIMITERS)
+	{
+		for(i = 0; i < 4; i++)
+		{
+			v[i] = _mm_loadu_si128((const __m128i *)(text + i * 16));
+			m[i] = _mm_setzero_si128();
+		}
+
+		for(j = 0; j < set->count; j++)
+		{
+			d = _mm_set1_epi8(set->list[j]);
+
+			for(i = 0; i < 4; i++)
+				m[i] = _mm_or_si128(m[i], _mm_cmpeq_epi8(v[i], d));
+		}
+
+		for(i = 0; i < 4; i++)
+			bits |= (unsigned long long)(unsigned int)_mm_movemask_epi8(m[i]) << (i * 16);
+
+		return bits;
+	}
+#endif
+
+	for(i = 0; i < 64; i++)
+		if(i >= length || set->isDelimiter[(byte)text[i]])
+			bits |= 1ULL << i;
+
+	return bits;
+}
+
+static void files_setIndexText(files_index_t *index, const char *data, unsigned int length)
+{
+	index->data		 = data;
+	index->length	 = length;
+	index->pos		 = index->indexedTo = 0;
+	index->numStarts = index->numEnds = index->next = 0;
+
+	//As if the text were preceded by a delimiter
+	index->lastIsDelimiter = 1;
+}
+
+/*
+ * files_indexWindow
+ * Lists where tokens start and end in the next window of text.
+ */
+static void files_indexWindow(files_index_t *index)
+{
+	unsigned long long	delimiter, follows, starts, ends;
+	unsigned int		base, last;
+
+	//A token left open by the last window carries over
+	if(index->numStarts > index->numEnds)
+	{
+		index->starts[0] = index->starts[index->numStarts - 1];
+		index->numStarts = 1;
+	}
+	else
+		index->numStarts = 0;
+
+	index->numEnds = index->next = 0;
+
+	last = index->indexedTo + FILES_INDEX_BYTES;
+	if(last > index->length)
+		last = index->length;
+
+	for(base = index->indexedTo; base < last; base += 64)
+	{
+		delimiter = files_classify(index->delimiters, index->data + base, index->length - base);
+
+		//Bit i set if byte i - 1 is a delimiter
+		follows = (delimiter << 1) | index->lastIsDelimiter;
+		index->lastIsDelimiter = delimiter >> 63;
+
+		starts = ~delimiter & follows;
+		ends   = delimiter & ~follows;
+
+		for(; starts != 0; starts &= starts - 1)
+			index->starts[index->numStarts++] = base + __builtin_ctzll(starts);
+
+		for(; ends != 0; ends &= ends - 1)
+			index->ends[index->numEnds++] = base + __builtin_ctzll(ends);
+	}
+
+	index->indexedTo = base;
+
+	//Bytes past the end count as delimiters, unless the end falls exactly
+	//on a block boundary
+	if(index->indexedTo >= index->length && index->numStarts > index->numEnds)
+		index->ends[index->numEnds++] = index->length;
+}
+
+/*
+ * files_peekToken
+ * Finds the next token from pos without consuming it, files_takeToken
+ * does that. Returns efalse at the end of the text. A quoted string may
+ * have left pos part way into a token, the rest of it is returned.
+ */
+static inline eboolean files_peekToken(files_index_t *index, unsigned int *start, unsigned int *end)
+{
+	for(;;)
+	{
+		while(index->next < index->numEnds && index->ends[index->next] <= index->pos)
+			index->next++;
+
+		if(index->next < index->numEnds)
+		{
+			*start = index->starts[index->next];
+			*end   = index->ends[index->next];
+
+			if(*start < index->pos)
+				*start = index->pos;
+
+			return etrue;
+		}
+
+		if(index->indexedTo >= index->length)
+			return efalse;
+
+		files_indexWindow(index);
+	}
+}
+
+static inline void files_takeToken(files_index_t *index, unsigned int end)
+{
+	index->pos = end;
+	index->next++;
+}
+
+/*
+ * files_findQuote
+ * Returns the position of the next double quote from pos, or the length.
+ */
+static unsigned int files_findQuote(const files_index_t *index, unsigned int pos)
+{
+	const char *quote = memchr(index->data + pos, '"', index->length - pos);
+
+	return quote != NULL ? quote - index->data : index->length;
+}
 
 /*
  * Function: files_tokenizeStr
@@ -23,60 +277,49 @@ Created on: Oct 17, 2010
 
 int files_tokenizeStr(char *str, const char *delimiters, char ***tokens)
 {
-	unsigned int	curToken, tokenLen, numTokens, spaceAllocated, numDelimiters;
+	files_delimiters_t	set;
+	files_index_t		*index;
+	unsigned int		numTokens, spaceAllocated, start, end;
 
-	const char *quote = "\"";
+	index = (files_index_t *)memory_alloc(MEMORY_TAG_FILES, sizeof(files_index_t));
+	files_initDelimiters(&set, delimiters);
+	index->delimiters = &set;
+	files_setIndexText(index, str, strlen(str));
 
-	curToken = tokenLen = numTokens = numDelimiters = 0;
+	numTokens = 0;
 
 	//Begin by making a guess about how many tokens we will end up having
 	spaceAllocated = ALLOCGUESS;
-	(*tokens) = (char **)malloc(sizeof(char *) * spaceAllocated);
+	(*tokens) = (char **)memory_alloc(MEMORY_TAG_FILES, sizeof(char *) * spaceAllocated);
 
-	while(*str)
+	while(files_peekToken(index, &start, &end))
 	{
 		//If we find that we need more space
 		if(numTokens >= spaceAllocated-1)
 		{
 			spaceAllocated *= 2;
-			(*tokens) = (char **)realloc((*tokens), (sizeof(char *) * spaceAllocated));
+			(*tokens) = (char **)memory_realloc(MEMORY_TAG_FILES, (*tokens), (sizeof(char *) * spaceAllocated));
 		}
 
-		//Quoted strings must be handled a little bit differently
-		//TODO: gross code duplication
-		if(*str == '"')
+		//Quoted strings run to the closing quote, delimiters and all
+		if(str[start] == '"')
 		{
-			tokenLen = strcspn(++str, quote);
-
-			//Allocate space, copy characters, null-terminate
-			(*tokens)[curToken] = (char *)malloc(sizeof(char) * tokenLen+1);
-			strncpy((*tokens)[curToken], str, tokenLen);
-			(*tokens)[curToken][tokenLen] = '\0';
-
-			str += tokenLen;
-			numDelimiters = strspn(++str, delimiters);
-			str += numDelimiters;
+			end = files_findQuote(index, ++start);
+			index->pos = end < index->length ? end + 1 : end;
 		}
 		else
-		{
-			tokenLen = strcspn(str, delimiters);
+			files_takeToken(index, end);
 
-			//Allocate space, copy characters, null-terminate
-			(*tokens)[curToken] = (char *)malloc(sizeof(char) * tokenLen+1);
-			strncpy((*tokens)[curToken], str, tokenLen);
-			(*tokens)[curToken][tokenLen] = '\0';
+		//Allocate space, copy characters, null-terminate
+		(*tokens)[numTokens] = (char *)memory_alloc(MEMORY_TAG_FILES, sizeof(char) * (end - start + 1));
+		memcpy((*tokens)[numTokens], str + start, end - start);
+		(*tokens)[numTokens][end - start] = '\0';
 
-			//Advance to the beginning delimiter character, scan the string
-			//until we reach a non-delimiting character, skip the cluster
-			str += tokenLen;
-			numDelimiters = strspn(str, delimiters);
-			str += numDelimiters;
-		}
-
-		//printf("%s\n", (*tokens)[curToken]);
-		numTokens++; curToken++;
+		numTokens++;
 	}
 
+	memory_free(index);
+
 	return numTokens;
 }
 
@@ -85,12 +328,19 @@ int files_tokenizeStr(char *str, const char *delimiters, char ***tokens)
  */
 char * files_readTextFile(char *filename)
 {
-	FILE	*file;
+	FILE			*file;
+	const byte		*packed;
+	unsigned int	packedSize;
 
 	int		count		= 0;
 	char 	*textData	= NULL;
 
-	if(filename != NULL)
+	if(filename != NULL && (packed = pack_find(filename, &packedSize)) != NULL)
+	{
+		textData = (char *)memory_alloc(MEMORY_TAG_FILES, sizeof(char) * (packedSize+1));
+		memcpy(textData, packed, packedSize+1);
+	}
+	else if(filename != NULL)
 	{
 		file = fopen(filename, "rt");
 
@@ -102,7 +352,7 @@ char * files_readTextFile(char *filename)
 
 			if(count > 0)
 			{
-				textData = (char *)malloc(sizeof(char) * (count+1));
+				textData = (char *)memory_alloc(MEMORY_TAG_FILES, sizeof(char) * (count+1));
 				count 	 = fread(textData, sizeof(char), count, file);
 
 				//Null terminate
@@ -121,3 +371,461 @@ char * files_readTextFile(char *filename)
 	return textData;
 }
 
+
+/*
+ * Function: files_sameBaseName
+ * Description: Compares the file name parts of two paths, ignoring any
+ * directories. Handles both slash styles, since exporters write either.
+ */
+int files_sameBaseName(const char *a, const char *b)
+{
+	const char *p;
+
+	if((p = strrchr(a, '/')) != NULL)  a = p + 1;
+	if((p = strrchr(a, '\\')) != NULL) a = p + 1;
+	if((p = strrchr(b, '/')) != NULL)  b = p + 1;
+	if((p = strrchr(b, '\\')) != NULL) b = p + 1;
+
+	return !strcmp(a, b);
+}
+
+/*
+===========================================================================
+Token streams. Text is pulled through a fixed FILES_STREAM_CHUNK buffer and
+split on whitespace as it arrives; a token that straddles two chunks is
+carried over in its own buffer. The source can be a plain or gzip file
+(zlib reads both), or a pack entry, which is used in place when plain and
+inflated chunk by chunk when gzipped. Either way the whole text is never
+held in memory at once. Quoted strings are returned without their quotes
+and may contain whitespace.
+===========================================================================
+*/
+
+#define FILES_STREAM_CHUNK	(64 * 1024)
+
+struct files_tokenStream_s
+{
+	gzFile			file;			//loose file, plain or gzip
+	z_stream		inflater;		//gzipped pack entry
+	eboolean		inflating;
+	const char		*packed;		//plain pack entry, one big chunk
+	unsigned int	packedSize;
+
+	char			*chunk;
+	files_index_t	index;			//over the current chunk
+	eboolean		ended;
+
+	char			*token;
+	unsigned int	tokenLength, tokenAllocated;
+};
+
+/*
+ * files_openStreamSource
+ * Looks for name in the pack, then on disk.
+ */
+static eboolean files_openStreamSource(files_tokenStream_t *stream, char *name)
+{
+	const byte		*packed;
+	unsigned int	size;
+
+	if((packed = pack_find(name, &size)) != NULL)
+	{
+		//gzip magic
+		if(size >= 2 && packed[0] == 0x1F && packed[1] == 0x8B)
+		{
+			memset(&stream->inflater, 0, sizeof(z_stream));
+			stream->inflater.next_in  = (Bytef *)packed;
+			stream->inflater.avail_in = size;
+
+			if(inflateInit2(&stream->inflater, 16 + MAX_WBITS) != Z_OK)
+				return efalse;
+
+			stream->inflating = etrue;
+		}
+		else
+		{
+			stream->packed	   = (const char *)packed;
+			stream->packedSize = size;
+		}
+
+		return etrue;
+	}
+
+	stream->file = gzopen(name, "rb");
+
+	if(stream->file != NULL)
+		gzbuffer(stream->file, FILES_STREAM_CHUNK);
+
+	return stream->file != NULL;
+}
+
+/*
+ * files_openTokenStream
+ * Opens filename, or filename.gz if there is no such file. Returns NULL if
+ * neither exists.
+ */
+files_tokenStream_t * files_openTokenStream(char *filename)
+{
+	files_tokenStream_t	*stream;
+	char				gzName[MAX_FILEPATH];
+
+	stream = (files_tokenStream_t *)memory_calloc(MEMORY_TAG_FILES, 1, sizeof(files_tokenStream_t));
+
+	if(!files_openStreamSource(stream, filename))
+	{
+		snprintf(gzName, sizeof(gzName), "%s.gz", filename);
+
+		if(!files_openStreamSource(stream, gzName))
+		{
+			memory_free(stream);
+			return NULL;
+		}
+	}
+
+	if(stream->packed == NULL)
+		stream->chunk = (char *)memory_alloc(MEMORY_TAG_FILES, FILES_STREAM_CHUNK);
+
+	stream->index.delimiters = &whitespace;
+	stream->tokenAllocated = 256;
+	stream->token = (char *)memory_alloc(MEMORY_TAG_FILES, stream->tokenAllocated);
+
+	return stream;
+}
+
+/*
+ * files_refill
+ * Replaces the current chunk with the next one. Returns efalse at the end
+ * of the text, or on a read error, which is treated the same way.
+ */
+static eboolean files_refill(files_tokenStream_t *stream)
+{
+	int ret, n;
+
+	files_setIndexText(&stream->index, NULL, 0);
+
+	if(stream->ended)
+		return efalse;
+
+	if(stream->packed != NULL)
+	{
+		files_setIndexText(&stream->index, stream->packed, stream->packedSize);
+		stream->ended = etrue;
+	}
+	else if(stream->inflating)
+	{
+		do
+		{
+			stream->inflater.next_out  = (Bytef *)stream->chunk;
+			stream->inflater.avail_out = FILES_STREAM_CHUNK;
+
+			ret = inflate(&stream->inflater, Z_NO_FLUSH);
+
+			if(ret != Z_OK)
+				stream->ended = etrue;
+
+			files_setIndexText(&stream->index, stream->chunk, FILES_STREAM_CHUNK - stream->inflater.avail_out);
+		}
+		while(stream->index.length == 0 && !stream->ended);
+	}
+	else
+	{
+		n = gzread(stream->file, stream->chunk, FILES_STREAM_CHUNK);
+
+		if(n < FILES_STREAM_CHUNK)
+			stream->ended = etrue;
+
+		files_setIndexText(&stream->index, stream->chunk, n > 0 ? n : 0);
+	}
+
+	return stream->index.length > 0;
+}
+
+static inline void files_appendToken(files_tokenStream_t *stream, const char *text, unsigned int length)
+{
+	if(stream->tokenLength + length + 1 > stream->tokenAllocated)
+	{
+		while(stream->tokenLength + length + 1 > stream->tokenAllocated)
+			stream->tokenAllocated *= 2;
+
+		stream->token = (char *)memory_realloc(MEMORY_TAG_FILES, stream->token, stream->tokenAllocated);
+	}
+
+	memcpy(stream->token + stream->tokenLength, text, length);
+	stream->tokenLength += length;
+}
+
+/*
+ * files_nextToken
+ * Returns the next token, or NULL at the end of the text. The string is
+ * only valid until the next call.
+ */
+char * files_nextToken(files_tokenStream_t *stream)
+{
+	files_index_t	*index = &stream->index;
+	unsigned int	start, end;
+
+	//Find the next token, across as many chunks as it takes
+	while(!files_peekToken(index, &start, &end))
+		if(!files_refill(stream))
+			return NULL;
+
+	stream->tokenLength = 0;
+
+	if(index->data[start] == '"')
+	{
+		start++;
+
+		for(;;)
+		{
+			end = files_findQuote(index, start);
+			files_appendToken(stream, index->data + start, end - start);
+
+			//Consume the closing quote
+			if(end < index->length)
+			{
+				index->pos = end + 1;
+				break;
+			}
+
+			//The string runs on into the next chunk
+			if(!files_refill(stream))
+				break;
+
+			start = 0;
+		}
+	}
+	else
+	{
+		for(;;)
+		{
+			files_appendToken(stream, index->data + start, end - start);
+			files_takeToken(index, end);
+
+			//The token runs on into the next chunk if that starts with
+			//more of it
+			if(end < index->length || !files_refill(stream) ||
+			   !files_peekToken(index, &start, &end) || start != 0)
+				break;
+		}
+	}
+
+	stream->token[stream->tokenLength] = '\0';
+
+	return stream->token;
+}
+
+/*
+ * files_closeTokenStream
+ */
+void files_closeTokenStream(files_tokenStream_t *stream)
+{
+	if(stream == NULL)
+		return;
+
+	if(stream->file != NULL)
+		gzclose(stream->file);
+	if(stream->inflating)
+		inflateEnd(&stream->inflater);
+
+	memory_free(stream->chunk);
+	memory_free(stream->token);
+	memory_free(stream);
+}
+
+/*
+===========================================================================
+Benchmark. The reference tokenizer is the strspn/strcspn loop the delimiter
+masks replaced, kept here to time against and to check the tokens match.
+===========================================================================
+*/
+
+#define BENCH_RUNS	20
+
+static double files_msec()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/*
+ * files_refTokenizeStr
+ * The old files_tokenizeStr, less its empty first token for text that
+ * starts with a delimiter and its read past an unterminated quote.
+ */
+static int files_refTokenizeStr(char *str, const char *delimiters, char ***tokens)
+{
+	unsigned int	tokenLen, numTokens, spaceAllocated;
+	eboolean		quoted;
+
+	numTokens = 0;
+	spaceAllocated = ALLOCGUESS;
+	(*tokens) = (char **)memory_alloc(MEMORY_TAG_FILES, sizeof(char *) * spaceAllocated);
+
+	str += strspn(str, delimiters);
+
+	while(*str)
+	{
+		if(numTokens >= spaceAllocated-1)
+		{
+			spaceAllocated *= 2;
+			(*tokens) = (char **)memory_realloc(MEMORY_TAG_FILES, (*tokens), (sizeof(char *) * spaceAllocated));
+		}
+
+		quoted = (*str == '"');
+		if(quoted)
+			tokenLen = strcspn(++str, "\"");
+		else
+			tokenLen = strcspn(str, delimiters);
+
+		(*tokens)[numTokens] = (char *)memory_alloc(MEMORY_TAG_FILES, sizeof(char) * (tokenLen+1));
+		memcpy((*tokens)[numTokens], str, tokenLen);
+		(*tokens)[numTokens][tokenLen] = '\0';
+
+		str += tokenLen;
+		if(quoted && *str)
+			str++;
+		str += strspn(str, delimiters);
+
+		numTokens++;
+	}
+
+	return numTokens;
+}
+
+/*
+ * files_refScan
+ * Counts tokens the way the old tokenizer found them, without copying.
+ */
+static int files_refScan(const char *str, const char *delimiters)
+{
+	int count = 0;
+
+	for(str += strspn(str, delimiters); *str; str += strspn(str, delimiters), count++)
+		str += strcspn(str, delimiters);
+
+	return count;
+}
+
+/*
+ * files_scan
+ * Counts tokens off the delimiter masks, without copying.
+ */
+static int files_scan(char *str, const char *delimiters)
+{
+	files_delimiters_t	set;
+	files_index_t		*index;
+	unsigned int		start, end;
+	int					count = 0;
+
+	index = (files_index_t *)memory_alloc(MEMORY_TAG_FILES, sizeof(files_index_t));
+	files_initDelimiters(&set, delimiters);
+	index->delimiters = &set;
+	files_setIndexText(index, str, strlen(str));
+
+	for(; files_peekToken(index, &start, &end); count++)
+		files_takeToken(index, end);
+
+	memory_free(index);
+
+	return count;
+}
+
+static void files_freeTokens(char **tokens, int count)
+{
+	int i;
+
+	for(i = 0; i < count; i++)
+		memory_free(tokens[i]);
+	memory_free(tokens);
+}
+
+/*
+ * files_benchmark
+ * Tokenizes a file with the reference and the current code, checks they
+ * agree and prints the best of BENCH_RUNS times for each.
+ * Returns 0 if the tokens differ or the file could not be read.
+ */
+int files_benchmark(char *filename)
+{
+	files_tokenStream_t	*stream;
+	const char			*delimiters = " \t\n\r";
+	char				*text, **refTokens, **tokens;
+	double				start, t, best[5];
+	int					run, i, refCount, count, mismatch, scanned[2];
+	unsigned int		length;
+
+	text = files_readTextFile(filename);
+	if(text == NULL)
+	{
+		printf("Tokenizer benchmark: could not read %s.\n", filename);
+		return 0;
+	}
+	length = strlen(text);
+
+	refCount = files_refTokenizeStr(text, delimiters, &refTokens);
+	count = files_tokenizeStr(text, delimiters, &tokens);
+
+	for(i = 0, mismatch = (count != refCount); !mismatch && i < count; i++)
+		mismatch = strcmp(tokens[i], refTokens[i]) != 0;
+
+	files_freeTokens(refTokens, refCount);
+	files_freeTokens(tokens, count);
+
+	if(mismatch)
+	{
+		printf("Tokenizer benchmark: %s, token %d differs, FAILED.\n", filename, i - 1);
+		memory_free(text);
+		return 0;
+	}
+
+	for(i = 0; i < 5; i++)
+		best[i] = 1e9;
+
+	for(run = 0; run < BENCH_RUNS; run++)
+	{
+		start = files_msec();
+		scanned[0] = files_refScan(text, delimiters);
+		if((t = files_msec() - start) < best[0])	best[0] = t;
+
+		start = files_msec();
+		scanned[1] = files_scan(text, delimiters);
+		if((t = files_msec() - start) < best[1])	best[1] = t;
+
+		start = files_msec();
+		files_freeTokens(refTokens, files_refTokenizeStr(text, delimiters, &refTokens));
+		if((t = files_msec() - start) < best[2])	best[2] = t;
+
+		start = files_msec();
+		files_freeTokens(tokens, files_tokenizeStr(text, delimiters, &tokens));
+		if((t = files_msec() - start) < best[3])	best[3] = t;
+
+		start = files_msec();
+		stream = files_openTokenStream(filename);
+		while(files_nextToken(stream) != NULL)
+			;
+		files_closeTokenStream(stream);
+		if((t = files_msec() - start) < best[4])	best[4] = t;
+	}
+
+	//Neither scan treats quotes specially, so they agree with each other
+	//rather than with the tokenizers
+	if(scanned[0] != scanned[1])
+	{
+		printf("Tokenizer benchmark: %s, scans found %d and %d tokens, FAILED.\n", filename, scanned[0], scanned[1]);
+		memory_free(text);
+		return 0;
+	}
+
+	printf("Tokenizer benchmark: %s, %u bytes, %d tokens, best of %d.\n", filename, length, count, BENCH_RUNS);
+	printf("                   reference ms   ms   GB/s  speedup\n");
+	printf("  boundary scan    %12.3f %8.3f %6.2f %8.2f\n", best[0], best[1], length / best[1] / 1e6, best[0] / best[1]);
+	printf("  files_tokenizeStr%12.3f %8.3f %6.2f %8.2f\n", best[2], best[3], length / best[3] / 1e6, best[2] / best[3]);
+	printf("  files_nextToken  %12s %8.3f %6.2f\n", "-", best[4], length / best[4] / 1e6);
+
+	memory_free(text);
+
+	return 1;
+}
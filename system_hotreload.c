@@ -0,0 +1,134 @@
+/*
+===========================================================================
+File:		system_hotreload.c
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+Description:	Development mode asset reloading. The asset directory is
+				watched with inotify, and each frame any .tga or .ASE (or
+				.ASE.gz) written since the last poll is decoded again and
+				swapped into the texture or model slots that came from it.
+				Nothing else is touched, so the game keeps running.
+===========================================================================
+*/
+
+#include <string.h>
+#include <strings.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "files.h"
+#include "renderer_materials.h"
+#include "renderer_models.h"
+#include "system_hotreload.h"
+
+//Editors often produce several events per save, these are merged per poll
+#define HOTRELOAD_MAX_PENDING	32
+
+static int	watchFD = -1;
+
+static eboolean hotreload_hasExtension(const char *name, const char *ext)
+{
+	size_t n = strlen(name), e = strlen(ext);
+
+	return n > e && !strcasecmp(name + n - e, ext);
+}
+
+/*
+ * hotreload_init
+ */
+eboolean hotreload_init(char *directory)
+{
+#ifdef __linux__
+	watchFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+	if(watchFD < 0)
+	{
+		printf("Hot reload: inotify unavailable.\n");
+		return efalse;
+	}
+
+	//IN_MOVED_TO catches editors that save to a temp file and rename it
+	if(inotify_add_watch(watchFD, directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+	{
+		printf("Hot reload: unable to watch %s.\n", directory);
+		close(watchFD);
+		watchFD = -1;
+		return efalse;
+	}
+
+	printf("Hot reload: watching %s.\n", directory);
+	return etrue;
+#else
+	printf("Hot reload: only supported on Linux.\n");
+	return efalse;
+#endif
+}
+
+/*
+ * hotreload_poll
+ * GL thread, once per frame. Never blocks.
+ */
+void hotreload_poll()
+{
+#ifdef __linux__
+	char					buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	char					pending[HOTRELOAD_MAX_PENDING][MAX_FILEPATH];
+	const struct inotify_event	*ev;
+	ssize_t					len;
+	char					*p;
+	int						numPending, i, count;
+
+	if(watchFD < 0)
+		return;
+
+	numPending = 0;
+
+	while((len = read(watchFD, buf, sizeof(buf))) > 0)
+	{
+		for(p = buf; p < buf + len; p += sizeof(struct inotify_event) + ev->len)
+		{
+			ev = (const struct inotify_event *)p;
+
+			if(ev->len == 0 || (!hotreload_hasExtension(ev->name, ".tga") && !hotreload_hasExtension(ev->name, ".ase") &&
+			   !hotreload_hasExtension(ev->name, ".ase.gz")))
+				continue;
+
+			for(i = 0; i < numPending; i++)
+				if(!strcmp(pending[i], ev->name))
+					break;
+
+			if(i == numPending && numPending < HOTRELOAD_MAX_PENDING)
+			{
+				strncpy(pending[numPending], ev->name, MAX_FILEPATH-1);
+				pending[numPending][MAX_FILEPATH-1] = '\0';
+				numPending++;
+			}
+		}
+	}
+
+	for(i = 0; i < numPending; i++)
+	{
+		if(hotreload_hasExtension(pending[i], ".tga"))
+			count = renderer_img_reloadTexture(pending[i]);
+		else
+			count = renderer_model_reloadASE(pending[i]);
+
+		printf("Hot reload: %s, %d slot(s) updated.\n", pending[i], count);
+	}
+#endif
+}
+
+/*
+ * hotreload_shutdown
+ */
+void hotreload_shutdown()
+{
+#ifdef __linux__
+	if(watchFD >= 0)
+		close(watchFD);
+	watchFD = -1;
+#endif
+}
@@ -0,0 +1,18 @@
+/*
+===========================================================================
+File:		system_hotreload.h
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+===========================================================================
+*/
+
+#ifndef SYSTEM_HOTRELOAD_H_
+#define SYSTEM_HOTRELOAD_H_
+
+#include "common.h"
+
+eboolean hotreload_init(char *directory);
+void     hotreload_poll();
+void     hotreload_shutdown();
+
+#endif /* SYSTEM_HOTRELOAD_H_ */
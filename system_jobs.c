@@ -0,0 +1,664 @@
+/*
+===========================================================================
+File:		system_jobs.c
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+Description:	Work-stealing job system. There is one worker per core
+				besides the thread that called jobs_init, and every one of
+				those threads owns a Chase-Lev deque: it pushes and pops
+				its own jobs at the bottom without taking a lock, and
+				threads that run dry steal from the top of someone else's.
+				Jobs submitted from threads outside the pool (the world
+				loader) go through one small locked queue instead.
+
+				A thread waiting on a counter runs jobs itself rather than
+				sleeping, so waiting from inside a job (a model waiting on
+				its bitmaps) can't deadlock the pool, and nothing needs a
+				worker at all before jobs_init. Idle threads spin briefly,
+				then sleep on one condition variable that is only touched
+				when somebody is actually asleep.
+
+				Counters can be chained: a child counter counts as one
+				pending job of its parent for as long as it has any of its
+				own, so waiting on the parent covers the whole tree.
+===========================================================================
+*/
+
+#include <SDL/SDL.h>
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "system_jobs.h"
+
+#define JOBS_MAX_WORKERS	16
+#define JOBS_MAX_THREADS	(JOBS_MAX_WORKERS + 1)
+#define JOBS_DEQUE_SIZE		1024		//per thread, power of two
+#define JOBS_QUEUE_SIZE		256			//for threads outside the pool, power of two
+#define JOBS_MAX_CHUNKS		64			//a parallel for never splits finer
+#define JOBS_IDLE_SPINS		64			//yields before an idle thread sleeps
+
+typedef struct
+{
+	jobs_func_t		func;
+	void			*param;
+	jobs_counter_t	*counter;
+}
+jobs_job_t;
+
+//top is advanced by thieves, bottom only by the owner. Kept on separate
+//cache lines so stealing doesn't slow the owner down.
+typedef struct
+{
+	long		top;
+	char		pad0[64 - sizeof(long)];
+	long		bottom;
+	char		pad1[64 - sizeof(long)];
+	jobs_job_t	slots[JOBS_DEQUE_SIZE];
+}
+jobs_deque_t;
+
+typedef struct
+{
+	jobs_rangeFunc_t	func;
+	void				*param;
+	int					first, last;
+}
+jobs_range_t;
+
+static jobs_deque_t		deques[JOBS_MAX_THREADS];
+static SDL_Thread		*workers[JOBS_MAX_WORKERS];
+static int				numWorkers = 0;
+
+//Index into deques of the calling thread, -1 outside the pool
+static __thread int		threadIndex = -1;
+
+//Shared queue, guarded by queueLock, which also guards sleeping
+static jobs_job_t		queue[JOBS_QUEUE_SIZE];
+static unsigned int		queueHead = 0, queueTail = 0;
+static SDL_mutex		*queueLock = NULL;
+static SDL_cond			*wake = NULL;
+
+//Jobs queued anywhere and not yet taken, and threads asleep on wake
+static int				available = 0, sleepers = 0, quitting = 0;
+
+static unsigned int		statWorkerJobs = 0, statHelperJobs = 0, statInlineJobs = 0;
+static unsigned int		statSteals = 0, statShared = 0, statSleeps = 0;
+
+/*
+===========================================================================
+	Chase-Lev deque
+===========================================================================
+*/
+
+/*
+ * jobs_push
+ * Owner only. Returns efalse if the deque is full.
+ */
+static eboolean jobs_push(jobs_deque_t *deque, const jobs_job_t *job)
+{
+	long b = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+	long t = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+
+	if(b - t >= JOBS_DEQUE_SIZE)
+		return efalse;
+
+	deque->slots[b & (JOBS_DEQUE_SIZE - 1)] = *job;
+	__atomic_store_n(&deque->bottom, b + 1, __ATOMIC_RELEASE);
+
+	return etrue;
+}
+
+/*
+ * jobs_pop
+ * Owner only, takes the newest job. Only the last job left can be contended,
+ * that one goes to whoever moves top first.
+ */
+static eboolean jobs_pop(jobs_deque_t *deque, jobs_job_t *job)
+{
+	long		b, t;
+	eboolean	found = etrue;
+
+	b = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+	__atomic_store_n(&deque->bottom, b, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	t = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+
+	if(t > b)
+	{
+		__atomic_store_n(&deque->bottom, b + 1, __ATOMIC_RELAXED);
+		return efalse;
+	}
+
+	*job = deque->slots[b & (JOBS_DEQUE_SIZE - 1)];
+
+	if(t == b)
+	{
+		found = __atomic_compare_exchange_n(&deque->top, &t, t + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+		__atomic_store_n(&deque->bottom, b + 1, __ATOMIC_RELAXED);
+	}
+
+	return found;
+}
+
+/*
+ * jobs_steal
+ * Any thread, takes the oldest job. A slot can't be reused by the owner
+ * while top still points at it, so a copy read here is only ever torn if
+ * the CAS below fails anyway.
+ */
+static eboolean jobs_steal(jobs_deque_t *deque, jobs_job_t *job)
+{
+	long t, b;
+
+	t = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	b = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+
+	if(t >= b)
+		return efalse;
+
+	*job = deque->slots[t & (JOBS_DEQUE_SIZE - 1)];
+
+	return __atomic_compare_exchange_n(&deque->top, &t, t + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+/*
+===========================================================================
+	Scheduling
+===========================================================================
+*/
+
+/*
+ * jobs_wakeSleepers
+ * Callers change what sleepers wait on before calling, sleepers count
+ * themselves before checking it, so one side always sees the other.
+ */
+static void jobs_wakeSleepers()
+{
+	if(__atomic_load_n(&sleepers, __ATOMIC_SEQ_CST) == 0)
+		return;
+
+	SDL_LockMutex(queueLock);
+	SDL_CondBroadcast(wake);
+	SDL_UnlockMutex(queueLock);
+}
+
+/*
+ * jobs_sleep
+ * Blocks until there may be a job to take, counter (if any) has finished,
+ * or the pool is shutting down.
+ */
+static void jobs_sleep(jobs_counter_t *counter)
+{
+	SDL_LockMutex(queueLock);
+	__atomic_add_fetch(&sleepers, 1, __ATOMIC_SEQ_CST);
+	statSleeps++;
+
+	while(__atomic_load_n(&available, __ATOMIC_SEQ_CST) <= 0 && !quitting &&
+		  (counter == NULL || __atomic_load_n(&counter->pending, __ATOMIC_SEQ_CST) > 0))
+		SDL_CondWait(wake, queueLock);
+
+	__atomic_sub_fetch(&sleepers, 1, __ATOMIC_SEQ_CST);
+	SDL_UnlockMutex(queueLock);
+}
+
+/*
+ * jobs_addPending
+ * Counts a job against counter, and the counter against its parent if it
+ * was idle.
+ */
+static void jobs_addPending(jobs_counter_t *counter)
+{
+	for(; counter != NULL; counter = counter->parent)
+		if(__atomic_fetch_add(&counter->pending, 1, __ATOMIC_SEQ_CST) != 0)
+			break;
+}
+
+/*
+ * jobs_run
+ * Runs a job and retires it from its counter, and the counter from its
+ * parent if that was its last job.
+ */
+static void jobs_run(jobs_job_t *job)
+{
+	jobs_counter_t	*counter, *parent;
+	eboolean		finished = efalse;
+
+	job->func(job->param);
+
+	//A counter that reaches zero may be on the stack of a jobs_wait that
+	//returns straight away, so its parent is read before the decrement
+	for(counter = job->counter; counter != NULL; counter = parent)
+	{
+		parent = counter->parent;
+
+		if(__atomic_sub_fetch(&counter->pending, 1, __ATOMIC_SEQ_CST) != 0)
+			break;
+
+		finished = etrue;
+	}
+
+	if(finished)
+		jobs_wakeSleepers();
+}
+
+/*
+ * jobs_find
+ * Own deque first, newest job first, then the shared queue, then the
+ * oldest job of any other thread.
+ */
+static eboolean jobs_find(jobs_job_t *job)
+{
+	static unsigned int	nextVictim = 0;
+	int					i, victim, numThreads = numWorkers + 1;
+	eboolean			found = efalse;
+
+	if(threadIndex >= 0 && jobs_pop(&deques[threadIndex], job))
+	{
+		__atomic_sub_fetch(&available, 1, __ATOMIC_SEQ_CST);
+		return etrue;
+	}
+
+	if(__atomic_load_n(&queueHead, __ATOMIC_RELAXED) != __atomic_load_n(&queueTail, __ATOMIC_RELAXED))
+	{
+		SDL_LockMutex(queueLock);
+
+		if(queueHead != queueTail)
+		{
+			*job = queue[queueTail++ & (JOBS_QUEUE_SIZE - 1)];
+			found = etrue;
+		}
+
+		SDL_UnlockMutex(queueLock);
+
+		if(found)
+		{
+			__atomic_sub_fetch(&available, 1, __ATOMIC_SEQ_CST);
+			return etrue;
+		}
+	}
+
+	//Start somewhere different each time so one victim isn't hammered
+	victim = __atomic_fetch_add(&nextVictim, 1, __ATOMIC_RELAXED) % numThreads;
+
+	for(i = 0; i < numThreads; i++, victim = (victim + 1) % numThreads)
+	{
+		if(victim != threadIndex && jobs_steal(&deques[victim], job))
+		{
+			__atomic_sub_fetch(&available, 1, __ATOMIC_SEQ_CST);
+			__atomic_add_fetch(&statSteals, 1, __ATOMIC_RELAXED);
+			return etrue;
+		}
+	}
+
+	return efalse;
+}
+
+static int jobs_workerThread(void *index)
+{
+	jobs_job_t	job;
+	int			spins = 0;
+
+	threadIndex = (int)(intptr_t)index;
+
+	while(!__atomic_load_n(&quitting, __ATOMIC_ACQUIRE))
+	{
+		if(jobs_find(&job))
+		{
+			__atomic_add_fetch(&statWorkerJobs, 1, __ATOMIC_RELAXED);
+			jobs_run(&job);
+			spins = 0;
+		}
+		else if(++spins < JOBS_IDLE_SPINS)
+			sched_yield();
+		else
+		{
+			jobs_sleep(NULL);
+			spins = 0;
+		}
+	}
+
+	return 0;
+}
+
+/*
+===========================================================================
+	Interface
+===========================================================================
+*/
+
+/*
+ * jobs_init
+ * Starts the workers. count <= 0 picks one per core besides the
+ * calling thread, which gets a deque of its own and helps out whenever it
+ * waits.
+ */
+void jobs_init(int count)
+{
+	long cores;
+
+	if(numWorkers > 0)
+		return;
+
+	if(count <= 0)
+	{
+		cores = sysconf(_SC_NPROCESSORS_ONLN);
+		count = cores > 1 ? cores - 1 : 1;
+	}
+
+	if(count > JOBS_MAX_WORKERS)
+		count = JOBS_MAX_WORKERS;
+
+	memset(deques, 0, sizeof(deques));
+	queueHead = queueTail = 0;
+	available = sleepers = quitting = 0;
+
+	queueLock	= SDL_CreateMutex();
+	wake		= SDL_CreateCond();
+	threadIndex	= 0;
+
+	for(numWorkers = 0; numWorkers < count; numWorkers++)
+		workers[numWorkers] = SDL_CreateThread(jobs_workerThread, (void *)(intptr_t)(numWorkers + 1));
+}
+
+/*
+ * jobs_initCounter
+ * Zeroes counter and makes it a child of parent, which may be NULL.
+ */
+void jobs_initCounter(jobs_counter_t *counter, jobs_counter_t *parent)
+{
+	counter->pending = 0;
+	counter->parent	 = parent;
+}
+
+/*
+ * jobs_submit
+ * Queues func(param) and counts it against counter, which may be NULL for
+ * fire and forget. Before jobs_init, or with the queue full, the job simply
+ * runs here and now.
+ */
+void jobs_submit(jobs_counter_t *counter, jobs_func_t func, void *param)
+{
+	jobs_job_t	job;
+	eboolean	queued = efalse;
+
+	job.func	= func;
+	job.param	= param;
+	job.counter	= counter;
+
+	if(numWorkers == 0)
+	{
+		statInlineJobs++;
+		func(param);
+		return;
+	}
+
+	jobs_addPending(counter);
+
+	if(threadIndex >= 0)
+		queued = jobs_push(&deques[threadIndex], &job);
+	else
+	{
+		SDL_LockMutex(queueLock);
+
+		if(queueHead - queueTail < JOBS_QUEUE_SIZE)
+		{
+			queue[queueHead++ & (JOBS_QUEUE_SIZE - 1)] = job;
+			statShared++;
+			queued = etrue;
+		}
+
+		SDL_UnlockMutex(queueLock);
+	}
+
+	if(!queued)
+	{
+		__atomic_add_fetch(&statInlineJobs, 1, __ATOMIC_RELAXED);
+		jobs_run(&job);
+		return;
+	}
+
+	__atomic_add_fetch(&available, 1, __ATOMIC_SEQ_CST);
+	jobs_wakeSleepers();
+}
+
+/*
+ * jobs_wait
+ * Returns once every job submitted against counter, and against any of its
+ * children, has finished. Runs queued jobs, anyone's, while it waits.
+ */
+void jobs_wait(jobs_counter_t *counter)
+{
+	jobs_job_t	job;
+	int			spins = 0;
+
+	if(numWorkers == 0)
+		return;
+
+	while(__atomic_load_n(&counter->pending, __ATOMIC_ACQUIRE) > 0)
+	{
+		if(jobs_find(&job))
+		{
+			__atomic_add_fetch(&statHelperJobs, 1, __ATOMIC_RELAXED);
+			jobs_run(&job);
+			spins = 0;
+		}
+		else if(++spins < JOBS_IDLE_SPINS)
+			sched_yield();
+		else
+		{
+			jobs_sleep(counter);
+			spins = 0;
+		}
+	}
+}
+
+/*
+ * jobs_done
+ * Whether every job submitted against counter, and against any of its
+ * children, has finished. Never blocks, for polling once a frame.
+ */
+eboolean jobs_done(jobs_counter_t *counter)
+{
+	return __atomic_load_n(&counter->pending, __ATOMIC_ACQUIRE) == 0;
+}
+
+static void jobs_runRange(void *param)
+{
+	jobs_range_t *range = (jobs_range_t *)param;
+
+	range->func(range->param, range->first, range->last);
+}
+
+/*
+ * jobs_parallelFor
+ * Calls func(param, first, last) over [0, count) split into ranges of at
+ * least grain, and returns when all of them are done. The calling thread
+ * takes the first range itself.
+ */
+void jobs_parallelFor(int count, int grain, jobs_rangeFunc_t func, void *param)
+{
+	jobs_range_t	ranges[JOBS_MAX_CHUNKS];
+	jobs_counter_t	counter;
+	int				chunks, size, i;
+
+	if(count <= 0)
+		return;
+
+	if(grain < 1)
+		grain = 1;
+
+	chunks = (count + grain - 1) / grain;
+
+	if(chunks > JOBS_MAX_CHUNKS)
+		chunks = JOBS_MAX_CHUNKS;
+
+	if(numWorkers == 0 || chunks == 1)
+	{
+		func(param, 0, count);
+		return;
+	}
+
+	size = (count + chunks - 1) / chunks;
+	jobs_initCounter(&counter, NULL);
+
+	for(i = 0; i < chunks && i * size < count; i++)
+	{
+		ranges[i].func	= func;
+		ranges[i].param	= param;
+		ranges[i].first	= i * size;
+		ranges[i].last	= (i + 1) * size < count ? (i + 1) * size : count;
+
+		if(i > 0)
+			jobs_submit(&counter, jobs_runRange, &ranges[i]);
+	}
+
+	jobs_runRange(&ranges[0]);
+	jobs_wait(&counter);
+}
+
+/*
+ * jobs_numThreads
+ * Threads that run jobs, counting the one that called jobs_init.
+ */
+int jobs_numThreads()
+{
+	return numWorkers + 1;
+}
+
+/*
+ * jobs_shutdown
+ * Workers finish the job they are on, anything still queued is dropped.
+ * Wait on your counters first.
+ */
+void jobs_shutdown()
+{
+	int i;
+
+	if(numWorkers == 0)
+		return;
+
+	SDL_LockMutex(queueLock);
+	__atomic_store_n(&quitting, 1, __ATOMIC_RELEASE);
+	SDL_CondBroadcast(wake);
+	SDL_UnlockMutex(queueLock);
+
+	for(i = 0; i < numWorkers; i++)
+		SDL_WaitThread(workers[i], NULL);
+
+	SDL_DestroyCond(wake);
+	SDL_DestroyMutex(queueLock);
+
+	numWorkers	= 0;
+	threadIndex	= -1;
+}
+
+/*
+===========================================================================
+	Benchmark
+===========================================================================
+*/
+
+#define BENCH_ITEMS		(1 << 18)
+#define BENCH_GRAIN		(BENCH_ITEMS / JOBS_MAX_CHUNKS)
+#define BENCH_TINY_JOBS	20000
+
+static volatile float benchSums[JOBS_MAX_CHUNKS];
+
+static double jobs_msec()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+//A few hundred flops per item, no memory traffic to speak of
+static void jobs_benchRange(void *param, int first, int last)
+{
+	float	sum = 0.0f, x;
+	int		i, k;
+
+	for(i = first; i < last; i++)
+	{
+		x = i * 1e-6f;
+
+		for(k = 0; k < 100; k++)
+			x = x * 0.999f + 0.001f;
+
+		sum += x;
+	}
+
+	benchSums[first / BENCH_GRAIN] = sum;
+}
+
+static void jobs_benchNothing(void *param)
+{
+}
+
+/*
+ * jobs_benchmark
+ * Runs the same parallel for with one thread up to one per core, then
+ * times submitting and waiting on many empty jobs, and prints both.
+ */
+void jobs_benchmark()
+{
+	jobs_counter_t	counter;
+	double			start, best, single = 0.0;
+	long			cores;
+	int				threads, run, i;
+
+	cores = sysconf(_SC_NPROCESSORS_ONLN);
+	if(cores > JOBS_MAX_THREADS)
+		cores = JOBS_MAX_THREADS;
+
+	jobs_shutdown();
+
+	printf("Jobs benchmark: parallel for over %d items, %d ranges.\n", BENCH_ITEMS, JOBS_MAX_CHUNKS);
+	printf("  threads        ms  speedup   per empty job\n");
+
+	for(threads = 1; threads <= cores; threads++)
+	{
+		if(threads > 1)
+			jobs_init(threads - 1);
+
+		for(run = 0, best = 1e9; run < 5; run++)
+		{
+			start = jobs_msec();
+			jobs_parallelFor(BENCH_ITEMS, BENCH_GRAIN, jobs_benchRange, NULL);
+			if(jobs_msec() - start < best)
+				best = jobs_msec() - start;
+		}
+
+		if(threads == 1)
+			single = best;
+
+		jobs_initCounter(&counter, NULL);
+		start = jobs_msec();
+
+		for(i = 0; i < BENCH_TINY_JOBS; i++)
+			jobs_submit(&counter, jobs_benchNothing, NULL);
+		jobs_wait(&counter);
+
+		printf("  %7d %9.3f %8.2f %12.3f us\n", threads, best, single / best,
+				(jobs_msec() - start) * 1000.0 / BENCH_TINY_JOBS);
+
+		jobs_shutdown();
+	}
+
+	jobs_printStats();
+}
+
+/*
+ * jobs_printStats
+ */
+void jobs_printStats()
+{
+	printf("Jobs: %d workers, %u jobs on workers, %u run by waiting threads, %u run inline, "
+			"%u stolen, %u through the shared queue, %u sleeps.\n",
+			numWorkers, statWorkerJobs, statHelperJobs, statInlineJobs, statSteals, statShared, statSleeps);
+}
@@ -0,0 +1,38 @@
+/*
+===========================================================================
+File:		system_jobs.h
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+===========================================================================
+*/
+
+#ifndef SYSTEM_JOBS_H_
+#define SYSTEM_JOBS_H_
+
+#include "common.h"
+
+typedef void (*jobs_func_t)(void *param);
+typedef void (*jobs_rangeFunc_t)(void *param, int first, int last);
+
+//Number of submitted jobs that haven't finished yet. Zero it before use, or
+//use jobs_initCounter to make it a child: a parent counter stays pending
+//while any of its children are.
+typedef struct jobs_counter_s
+{
+	int						pending;
+	struct jobs_counter_s	*parent;
+}
+jobs_counter_t;
+
+void jobs_init(int numWorkers);
+void jobs_initCounter(jobs_counter_t *counter, jobs_counter_t *parent);
+void jobs_submit(jobs_counter_t *counter, jobs_func_t func, void *param);
+void jobs_wait(jobs_counter_t *counter);
+eboolean jobs_done(jobs_counter_t *counter);
+void jobs_parallelFor(int count, int grain, jobs_rangeFunc_t func, void *param);
+int  jobs_numThreads();
+void jobs_shutdown();
+void jobs_benchmark();
+void jobs_printStats();
+
+#endif /* SYSTEM_JOBS_H_ */
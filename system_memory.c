@@ -0,0 +1,283 @@
+/*
+===========================================================================
+File:		system_memory.c
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+Description:	Tagged heap allocations. Every block carries a small
+				header with its size and tag in front of it, so freeing
+				needs only the pointer and the bytes are credited back to
+				whoever allocated them, even when ownership has passed to
+				another subsystem (decoded pixels, token arrays). Live
+				bytes, peak bytes and allocation counts are kept per tag
+				with atomics, since the loader thread and the job workers
+				allocate too.
+
+				GPU memory can't be measured from here, so subsystems
+				report an estimate as they create, resize and delete
+				textures, buffers and display lists. Both are printed on
+				demand and at exit, which is enough to see a leak as a
+				number that only ever grows.
+===========================================================================
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "system_memory.h"
+
+//Keeps the payload 16 byte aligned for SSE loads
+#define MEMORY_HEADER	16
+#define MEMORY_MAGIC	0x4D454D54		//"MEMT"
+
+typedef struct
+{
+	size_t			size;
+	unsigned int	tag;
+	unsigned int	magic;
+}
+memory_header_t;
+
+typedef struct
+{
+	size_t			live, peak;
+	unsigned int	blocks, allocs;
+	long			gpuBytes, gpuPeak;
+	int				gpuObjects;
+}
+memory_stats_t;
+
+static const char *tagNames[MEMORY_NUM_TAGS] =
+{
+	"misc", "files", "pack", "images", "textures", "materials",
+	"models", "anim", "terrain", "world", "renderer", "particles",
+	"collision"
+};
+
+//One per tag, then the total
+static memory_stats_t stats[MEMORY_NUM_TAGS + 1];
+
+static unsigned int statBadFrees = 0;
+
+static void memory_raisePeak(size_t *peak, size_t value)
+{
+	size_t old = __atomic_load_n(peak, __ATOMIC_RELAXED);
+
+	while(value > old && !__atomic_compare_exchange_n(peak, &old, value, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+static void memory_charge(unsigned int tag, size_t size)
+{
+	memory_stats_t	*s;
+	int				i;
+
+	for(i = 0; i < 2; i++)
+	{
+		s = &stats[i ? MEMORY_NUM_TAGS : tag];
+		memory_raisePeak(&s->peak, __atomic_add_fetch(&s->live, size, __ATOMIC_RELAXED));
+		__atomic_add_fetch(&s->blocks, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch(&s->allocs, 1, __ATOMIC_RELAXED);
+	}
+}
+
+static void memory_credit(unsigned int tag, size_t size)
+{
+	memory_stats_t	*s;
+	int				i;
+
+	for(i = 0; i < 2; i++)
+	{
+		s = &stats[i ? MEMORY_NUM_TAGS : tag];
+		__atomic_sub_fetch(&s->live, size, __ATOMIC_RELAXED);
+		__atomic_sub_fetch(&s->blocks, 1, __ATOMIC_RELAXED);
+	}
+}
+
+/*
+ * memory_header
+ * Returns the header of a block from memory_alloc, or NULL (and counts it)
+ * for anything else, including a block that was already freed.
+ */
+static memory_header_t * memory_header(void *ptr)
+{
+	memory_header_t *header = (memory_header_t *)((byte *)ptr - MEMORY_HEADER);
+
+	if(header->magic != MEMORY_MAGIC || header->tag >= MEMORY_NUM_TAGS)
+	{
+		if(__atomic_fetch_add(&statBadFrees, 1, __ATOMIC_RELAXED) == 0)
+			printf("Memory: %p was not allocated by memory_alloc, or was freed twice.\n", ptr);
+		return NULL;
+	}
+
+	return header;
+}
+
+/*
+ * memory_alloc
+ * Like malloc, charged to tag. The block is 16 byte aligned. Returns NULL
+ * if out of memory.
+ */
+void * memory_alloc(memory_tag_t tag, size_t size)
+{
+	memory_header_t	*header;
+	void			*raw;
+
+	if(posix_memalign(&raw, MEMORY_HEADER, MEMORY_HEADER + size))
+	{
+		printf("Memory: out of memory allocating %lu bytes for %s.\n", (unsigned long)size, tagNames[tag]);
+		return NULL;
+	}
+
+	header			= (memory_header_t *)raw;
+	header->size	= size;
+	header->tag		= tag;
+	header->magic	= MEMORY_MAGIC;
+
+	memory_charge(tag, size);
+
+	return (byte *)raw + MEMORY_HEADER;
+}
+
+/*
+ * memory_calloc
+ */
+void * memory_calloc(memory_tag_t tag, size_t count, size_t size)
+{
+	void *ptr = memory_alloc(tag, count * size);
+
+	if(ptr != NULL)
+		memset(ptr, 0, count * size);
+
+	return ptr;
+}
+
+/*
+ * memory_realloc
+ * Like realloc. A NULL ptr is charged to tag, otherwise the block stays
+ * charged to the tag it was allocated with.
+ */
+void * memory_realloc(memory_tag_t tag, void *ptr, size_t size)
+{
+	memory_header_t	*header;
+	void			*raw, *moved;
+	size_t			oldSize;
+
+	if(ptr == NULL)
+		return memory_alloc(tag, size);
+
+	if((header = memory_header(ptr)) == NULL)
+		return NULL;
+
+	oldSize = header->size;
+	tag		= header->tag;
+
+	if((raw = realloc(header, MEMORY_HEADER + size)) == NULL)
+	{
+		printf("Memory: out of memory growing a block to %lu bytes for %s.\n", (unsigned long)size, tagNames[tag]);
+		return NULL;
+	}
+
+	//realloc only promises malloc's alignment, which is 8 on some targets
+	if(((uintptr_t)raw & (MEMORY_HEADER - 1)) && !posix_memalign(&moved, MEMORY_HEADER, MEMORY_HEADER + size))
+	{
+		memcpy(moved, raw, MEMORY_HEADER + (size < oldSize ? size : oldSize));
+		free(raw);
+		raw = moved;
+	}
+
+	header		 = (memory_header_t *)raw;
+	header->size = size;
+
+	//Counts as a free and an allocation
+	memory_credit(tag, oldSize);
+	memory_charge(tag, size);
+
+	return (byte *)raw + MEMORY_HEADER;
+}
+
+/*
+ * memory_strdup
+ */
+char * memory_strdup(memory_tag_t tag, const char *str)
+{
+	size_t	length = strlen(str) + 1;
+	char	*copy  = (char *)memory_alloc(tag, length);
+
+	if(copy != NULL)
+		memcpy(copy, str, length);
+
+	return copy;
+}
+
+/*
+ * memory_free
+ * Like free. A pointer that didn't come from memory_alloc is reported and
+ * leaked rather than handed to free.
+ */
+void memory_free(void *ptr)
+{
+	memory_header_t *header;
+
+	if(ptr == NULL || (header = memory_header(ptr)) == NULL)
+		return;
+
+	memory_credit(header->tag, header->size);
+	header->magic = 0;
+
+	free(header);
+}
+
+/*
+ * memory_trackGPU
+ * Adjusts the estimate of what tag holds on the GPU. Call with the change
+ * in bytes and in objects as they are created (+), resized (0 objects) or
+ * deleted (-).
+ */
+void memory_trackGPU(memory_tag_t tag, int bytes, int objects)
+{
+	memory_stats_t	*s;
+	long			now, old;
+	int				i;
+
+	for(i = 0; i < 2; i++)
+	{
+		s	= &stats[i ? MEMORY_NUM_TAGS : tag];
+		now	= __atomic_add_fetch(&s->gpuBytes, bytes, __ATOMIC_RELAXED);
+		old	= __atomic_load_n(&s->gpuPeak, __ATOMIC_RELAXED);
+
+		while(now > old && !__atomic_compare_exchange_n(&s->gpuPeak, &old, now, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			;
+
+		__atomic_add_fetch(&s->gpuObjects, objects, __ATOMIC_RELAXED);
+	}
+}
+
+/*
+ * memory_printStats
+ * One line per tag that has ever allocated anything, then the totals.
+ * Counts are read without a lock, so mid frame they may be a little out of
+ * step with each other.
+ */
+void memory_printStats()
+{
+	memory_stats_t	*s;
+	int				i;
+
+	printf("Memory:        live KB   peak KB   blocks   allocs |  GPU KB  peak KB  objects\n");
+
+	for(i = 0; i <= MEMORY_NUM_TAGS; i++)
+	{
+		s = &stats[i];
+
+		if(i < MEMORY_NUM_TAGS && s->allocs == 0 && s->gpuPeak == 0)
+			continue;
+
+		printf("  %-10s %10.1f %9.1f %8u %8u | %7.1f %8.1f %8d\n",
+				i < MEMORY_NUM_TAGS ? tagNames[i] : "total",
+				s->live / 1024.0, s->peak / 1024.0, s->blocks, s->allocs,
+				s->gpuBytes / 1024.0, s->gpuPeak / 1024.0, s->gpuObjects);
+	}
+
+	if(statBadFrees)
+		printf("  %u frees of blocks not from memory_alloc.\n", statBadFrees);
+}
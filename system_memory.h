@@ -0,0 +1,44 @@
+/*
+===========================================================================
+File:		system_memory.h
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+===========================================================================
+*/
+
+#ifndef SYSTEM_MEMORY_H_
+#define SYSTEM_MEMORY_H_
+
+#include "common.h"
+
+//Who an allocation is charged to. A block keeps its tag for life, so it is
+//credited back to the same tag whoever frees it.
+typedef enum
+{
+	MEMORY_TAG_MISC,
+	MEMORY_TAG_FILES,			//text files, token arrays, stream buffers
+	MEMORY_TAG_PACK,
+	MEMORY_TAG_IMAGES,			//decoded pixels, texture thumbnails
+	MEMORY_TAG_TEXTURES,		//residency bookkeeping, GL textures
+	MEMORY_TAG_MATERIALS,
+	MEMORY_TAG_MODELS,			//ASE models and meshes, their display lists
+	MEMORY_TAG_ANIM,
+	MEMORY_TAG_TERRAIN,
+	MEMORY_TAG_WORLD,
+	MEMORY_TAG_RENDERER,		//batch and queue lists, sky
+	MEMORY_TAG_PARTICLES,
+	MEMORY_TAG_COLLISION,
+	MEMORY_NUM_TAGS
+}
+memory_tag_t;
+
+void * memory_alloc(memory_tag_t tag, size_t size);
+void * memory_calloc(memory_tag_t tag, size_t count, size_t size);
+void * memory_realloc(memory_tag_t tag, void *ptr, size_t size);
+char * memory_strdup(memory_tag_t tag, const char *str);
+void   memory_free(void *ptr);
+
+void   memory_trackGPU(memory_tag_t tag, int bytes, int objects);
+void   memory_printStats();
+
+#endif /* SYSTEM_MEMORY_H_ */
@@ -0,0 +1,378 @@
+/*
+===========================================================================
+File:		system_pack.c
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+Description:	Asset pack. Every asset the game loads can be concatenated
+				into one file that is mapped read-only at startup, so a
+				cold start is one open and one mmap instead of a stat,
+				fopen and fread per file. Names that aren't in the pack
+				(or every name, when no pack is open) fall back to loose
+				files in the working directory.
+
+				Layout, all integers little-endian and read in place:
+				  header:	"CSPK", u32 version, u32 numEntries,
+							u32 hashSize, u32 stringsSize, u32 dataStart
+				  entries:	numEntries x { u32 hash, u32 nameOffset,
+							u32 offset, u32 size }
+				  slots:	hashSize x u32, entry index + 1, 0 if empty.
+							Open addressing, linear probing on FNV-1a.
+				  strings:	NUL terminated names, nameOffset indexes here
+				  data:		each entry starts on a PACK_ALIGN boundary and
+							is followed by at least one zero byte, so text
+							assets can be parsed straight from the mapping.
+===========================================================================
+*/
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "system_memory.h"
+#include "system_pack.h"
+
+#define PACK_MAGIC		"CSPK"
+#define PACK_VERSION	1
+#define PACK_ALIGN		4096
+
+typedef struct
+{
+	char			magic[4];
+	unsigned int	version;
+	unsigned int	numEntries;
+	unsigned int	hashSize;
+	unsigned int	stringsSize;
+	unsigned int	dataStart;
+}
+pack_header_t;
+
+typedef struct
+{
+	unsigned int	hash;
+	unsigned int	nameOffset;
+	unsigned int	offset;
+	unsigned int	size;
+}
+pack_entry_t;
+
+static byte					*packBase = NULL;
+static size_t				packSize = 0;
+static char					packName[256];
+
+static const pack_header_t	*packHeader = NULL;
+static const pack_entry_t	*packEntries = NULL;
+static const unsigned int	*packSlots = NULL;
+static const char			*packStrings = NULL;
+
+//Bumped from the world loader thread as well
+static unsigned int			statHits = 0, statMisses = 0;
+
+static unsigned int pack_hash(const char *name)
+{
+	unsigned int h = 2166136261u;
+
+	while(*name)
+	{
+		h ^= (byte)*name++;
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+static unsigned int pack_align(unsigned int offset)
+{
+	return (offset + PACK_ALIGN - 1) & ~(PACK_ALIGN - 1);
+}
+
+/*
+ * pack_build
+ * Writes files into a new pack, each stored under the name it was given
+ * on the command line. Duplicate names keep the first file.
+ */
+eboolean pack_build(char *name, char **files, int numFiles)
+{
+	FILE			*out, *in;
+	struct stat		st;
+	pack_header_t	header;
+	pack_entry_t	*entries;
+	unsigned int	*slots, hashSize, stringsSize, offset, slot;
+	byte			*data, zeros[PACK_ALIGN];
+	int				i, j, count;
+
+	entries = (pack_entry_t *)memory_calloc(MEMORY_TAG_PACK, numFiles ? numFiles : 1, sizeof(pack_entry_t));
+
+	for(hashSize = 16; hashSize < (unsigned int)numFiles * 2; hashSize *= 2)
+		;
+	slots = (unsigned int *)memory_calloc(MEMORY_TAG_PACK, hashSize, sizeof(unsigned int));
+
+	//Index every readable file and place the names
+	for(i = 0, count = 0, stringsSize = 0; i < numFiles; i++)
+	{
+		if(stat(files[i], &st) || !S_ISREG(st.st_mode))
+		{
+			printf("Pack: skipping %s, not a readable file.\n", files[i]);
+			files[i] = NULL;
+			continue;
+		}
+
+		for(j = 0; j < i; j++)
+			if(files[j] != NULL && !strcmp(files[j], files[i]))
+				break;
+
+		if(j < i)
+		{
+			files[i] = NULL;
+			continue;
+		}
+
+		entries[count].hash		  = pack_hash(files[i]);
+		entries[count].nameOffset = stringsSize;
+		entries[count].size		  = st.st_size;
+
+		for(slot = entries[count].hash & (hashSize - 1); slots[slot]; slot = (slot + 1) & (hashSize - 1))
+			;
+		slots[slot] = count + 1;
+
+		stringsSize += strlen(files[i]) + 1;
+		count++;
+	}
+
+	memcpy(header.magic, PACK_MAGIC, 4);
+	header.version	   = PACK_VERSION;
+	header.numEntries  = count;
+	header.hashSize	   = hashSize;
+	header.stringsSize = stringsSize;
+	header.dataStart   = pack_align(sizeof(pack_header_t) + count * sizeof(pack_entry_t) +
+						 hashSize * sizeof(unsigned int) + stringsSize);
+
+	for(i = 0, offset = header.dataStart; i < count; i++)
+	{
+		entries[i].offset = offset;
+		offset = pack_align(offset + entries[i].size + 1);
+	}
+
+	if((out = fopen(name, "wb")) == NULL)
+	{
+		printf("Pack: could not create %s.\n", name);
+		memory_free(entries);
+		memory_free(slots);
+		return efalse;
+	}
+
+	memset(zeros, 0, sizeof(zeros));
+
+	fwrite(&header, sizeof(pack_header_t), 1, out);
+	fwrite(entries, sizeof(pack_entry_t), count, out);
+	fwrite(slots, sizeof(unsigned int), hashSize, out);
+
+	for(i = 0; i < numFiles; i++)
+		if(files[i] != NULL)
+			fwrite(files[i], 1, strlen(files[i]) + 1, out);
+
+	for(i = 0, j = 0, offset = ftell(out); i < numFiles; i++)
+	{
+		if(files[i] == NULL)
+			continue;
+
+		fwrite(zeros, 1, entries[j].offset - offset, out);
+
+		data = (byte *)memory_alloc(MEMORY_TAG_PACK, entries[j].size ? entries[j].size : 1);
+
+		if((in = fopen(files[i], "rb")) == NULL || fread(data, 1, entries[j].size, in) != entries[j].size)
+		{
+			printf("Pack: failed reading %s.\n", files[i]);
+			memset(data, 0, entries[j].size);
+		}
+
+		if(in != NULL)
+			fclose(in);
+
+		fwrite(data, 1, entries[j].size, out);
+		memory_free(data);
+
+		offset = entries[j].offset + entries[j].size;
+		j++;
+	}
+
+	//Terminate the last entry and round the file off
+	fwrite(zeros, 1, pack_align(offset + 1) - offset, out);
+
+	if(fclose(out))
+	{
+		printf("Pack: failed writing %s.\n", name);
+		memory_free(entries);
+		memory_free(slots);
+		return efalse;
+	}
+
+	printf("Pack: wrote %s, %d files, %u bytes.\n", name, count, pack_align(offset + 1));
+
+	memory_free(entries);
+	memory_free(slots);
+	return etrue;
+}
+
+/*
+ * pack_validate
+ * Checks the mapped index against the file size, so a damaged pack can't
+ * hand out pointers past the end of the mapping.
+ */
+static eboolean pack_validate()
+{
+	unsigned int	i;
+	size_t			indexEnd;
+
+	if(packSize < sizeof(pack_header_t) || memcmp(packHeader->magic, PACK_MAGIC, 4) ||
+	   packHeader->version != PACK_VERSION)
+		return efalse;
+
+	if(packHeader->hashSize == 0 || (packHeader->hashSize & (packHeader->hashSize - 1)) ||
+	   packHeader->numEntries >= packHeader->hashSize)
+		return efalse;
+
+	indexEnd = sizeof(pack_header_t) + (size_t)packHeader->numEntries * sizeof(pack_entry_t) +
+			   (size_t)packHeader->hashSize * sizeof(unsigned int);
+
+	if(packHeader->dataStart > packSize || indexEnd + packHeader->stringsSize > packHeader->dataStart)
+		return efalse;
+
+	if(packHeader->stringsSize && packStrings[packHeader->stringsSize - 1] != '\0')
+		return efalse;
+
+	for(i = 0; i < packHeader->numEntries; i++)
+	{
+		if(packEntries[i].nameOffset >= packHeader->stringsSize)
+			return efalse;
+
+		if(packEntries[i].offset < packHeader->dataStart ||
+		   (size_t)packEntries[i].offset + packEntries[i].size + 1 > packSize)
+			return efalse;
+	}
+
+	for(i = 0; i < packHeader->hashSize; i++)
+		if(packSlots[i] > packHeader->numEntries)
+			return efalse;
+
+	return etrue;
+}
+
+/*
+ * pack_open
+ * Maps a pack for pack_find. A missing pack is not an error, everything
+ * just comes from loose files.
+ */
+eboolean pack_open(char *name)
+{
+	struct stat	st;
+	void		*base;
+	int			fd;
+
+	pack_close();
+
+	if((fd = open(name, O_RDONLY)) < 0)
+		return efalse;
+
+	if(fstat(fd, &st) || st.st_size == 0)
+	{
+		printf("Pack: %s, failed. Could not determine file size.\n", name);
+		close(fd);
+		return efalse;
+	}
+
+	base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if(base == MAP_FAILED)
+	{
+		printf("Pack: %s, failed. Could not map file.\n", name);
+		return efalse;
+	}
+
+	packBase	= (byte *)base;
+	packSize	= st.st_size;
+	packHeader	= (const pack_header_t *)packBase;
+	packEntries	= (const pack_entry_t *)(packHeader + 1);
+	packSlots	= (const unsigned int *)(packEntries + packHeader->numEntries);
+	packStrings	= (const char *)(packSlots + packHeader->hashSize);
+
+	if(!pack_validate())
+	{
+		printf("Pack: %s, failed. Bad header or index.\n", name);
+		pack_close();
+		return efalse;
+	}
+
+	//Everything in the pack is wanted during startup anyway
+	madvise(packBase, packSize, MADV_WILLNEED);
+
+	strncpy(packName, name, sizeof(packName)-1);
+	packName[sizeof(packName)-1] = '\0';
+
+	return etrue;
+}
+
+/*
+ * pack_find
+ * Returns a pointer to the named asset inside the mapping and its size, or
+ * NULL if it should be read from a loose file. The data is read-only, is
+ * followed by a zero byte and stays valid until pack_close. Safe from any
+ * thread once the pack is open.
+ */
+const byte * pack_find(const char *name, unsigned int *size)
+{
+	const pack_entry_t	*entry;
+	unsigned int		hash, slot, mask, probes;
+
+	if(packBase == NULL || name == NULL)
+		return NULL;
+
+	hash = pack_hash(name);
+	mask = packHeader->hashSize - 1;
+
+	for(slot = hash & mask, probes = 0; packSlots[slot] && probes <= mask; slot = (slot + 1) & mask, probes++)
+	{
+		entry = &packEntries[packSlots[slot] - 1];
+
+		if(entry->hash == hash && !strcmp(packStrings + entry->nameOffset, name))
+		{
+			__atomic_fetch_add(&statHits, 1, __ATOMIC_RELAXED);
+			*size = entry->size;
+			return packBase + entry->offset;
+		}
+	}
+
+	__atomic_fetch_add(&statMisses, 1, __ATOMIC_RELAXED);
+	return NULL;
+}
+
+/*
+ * pack_close
+ * Pointers returned by pack_find are invalid afterwards.
+ */
+void pack_close()
+{
+	if(packBase != NULL)
+		munmap(packBase, packSize);
+
+	packBase	= NULL;
+	packSize	= 0;
+	packHeader	= NULL;
+	packEntries	= NULL;
+	packSlots	= NULL;
+	packStrings	= NULL;
+}
+
+/*
+ * pack_printStats
+ */
+void pack_printStats()
+{
+	if(packBase == NULL)
+		return;
+
+	printf("Pack: %s, %u files, %u lookups served from the pack, %u from loose files.\n",
+			packName, packHeader->numEntries, statHits, statMisses);
+}
@@ -0,0 +1,22 @@
+/*
+===========================================================================
+File:		system_pack.h
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+===========================================================================
+*/
+
+#ifndef SYSTEM_PACK_H_
+#define SYSTEM_PACK_H_
+
+#include "common.h"
+
+#define PACK_DEFAULT_NAME	"assets.pak"
+
+eboolean     pack_build(char *packName, char **files, int numFiles);
+eboolean     pack_open(char *packName);
+const byte * pack_find(const char *name, unsigned int *size);
+void         pack_close();
+void         pack_printStats();
+
+#endif /* SYSTEM_PACK_H_ */
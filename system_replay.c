@@ -0,0 +1,234 @@
+/*
+===========================================================================
+File:		system_replay.c
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+Description:	Input recording for reproducible runs. A replay file is the
+				random seed followed by every input event, stamped with the
+				simulation tick it was applied on.
+
+				Layout, all integers little-endian:
+				  "CSRP"	magic
+				  u8		version
+				  u32		seed
+				  records:	varint tick delta, u8 type, then
+							KEYDOWN/KEYUP:	varint key
+							MOUSE:			varint x, varint y
+							END:			nothing, tick is the final tick
+===========================================================================
+*/
+
+#include <SDL/SDL.h>
+#include <string.h>
+
+#include "system_replay.h"
+
+#define REPLAY_MAGIC	"CSRP"
+#define REPLAY_VERSION	1
+
+static FILE			*recordFile = NULL, *playbackFile = NULL;
+static unsigned int	recordTick = 0, playbackTick = 0;
+
+static void replay_writeVarint(unsigned int v)
+{
+	while(v >= 0x80)
+	{
+		fputc((v & 0x7F) | 0x80, recordFile);
+		v >>= 7;
+	}
+
+	fputc(v, recordFile);
+}
+
+static eboolean replay_readVarint(unsigned int *v)
+{
+	int c, shift = 0;
+
+	*v = 0;
+
+	do
+	{
+		if((c = fgetc(playbackFile)) == EOF || shift > 28)
+			return efalse;
+
+		*v |= (unsigned int)(c & 0x7F) << shift;
+		shift += 7;
+	}
+	while(c & 0x80);
+
+	return etrue;
+}
+
+static void replay_writeHeader(unsigned int seed)
+{
+	byte header[9];
+
+	memcpy(header, REPLAY_MAGIC, 4);
+	header[4] = REPLAY_VERSION;
+	header[5] = seed & 0xFF;
+	header[6] = (seed >> 8) & 0xFF;
+	header[7] = (seed >> 16) & 0xFF;
+	header[8] = (seed >> 24) & 0xFF;
+
+	fwrite(header, 1, sizeof(header), recordFile);
+}
+
+/*
+ * replay_openRecord
+ */
+eboolean replay_openRecord(char *name, unsigned int seed)
+{
+	recordFile = fopen(name, "wb");
+
+	if(recordFile == NULL)
+	{
+		printf("Recording: unable to open %s.\n", name);
+		return efalse;
+	}
+
+	replay_writeHeader(seed);
+	recordTick = 0;
+
+	return etrue;
+}
+
+/*
+ * replay_writeEvent
+ * Events must be written in tick order.
+ */
+void replay_writeEvent(replay_event_t *ev)
+{
+	if(recordFile == NULL)
+		return;
+
+	replay_writeVarint(ev->tick - recordTick);
+	recordTick = ev->tick;
+
+	fputc(ev->type, recordFile);
+
+	switch(ev->type)
+	{
+	case REPLAY_KEYDOWN:
+	case REPLAY_KEYUP:
+		replay_writeVarint(ev->key);
+		break;
+	case REPLAY_MOUSE:
+		replay_writeVarint(ev->x);
+		replay_writeVarint(ev->y);
+		break;
+	}
+}
+
+/*
+ * replay_closeRecord
+ * Writes the END record so playback knows how long the session ran.
+ */
+void replay_closeRecord(unsigned int finalTick)
+{
+	replay_event_t end;
+
+	if(recordFile == NULL)
+		return;
+
+	memset(&end, 0, sizeof(end));
+	end.tick = finalTick;
+	end.type = REPLAY_END;
+	replay_writeEvent(&end);
+
+	fclose(recordFile);
+	recordFile = NULL;
+}
+
+/*
+ * replay_openPlayback
+ */
+eboolean replay_openPlayback(char *name, unsigned int *seed)
+{
+	byte header[9];
+
+	playbackFile = fopen(name, "rb");
+
+	if(playbackFile == NULL)
+	{
+		printf("Replay: unable to open %s.\n", name);
+		return efalse;
+	}
+
+	if(fread(header, 1, sizeof(header), playbackFile) != sizeof(header) ||
+	   memcmp(header, REPLAY_MAGIC, 4) || header[4] != REPLAY_VERSION)
+	{
+		printf("Replay: %s is not a version %d replay file.\n", name, REPLAY_VERSION);
+		fclose(playbackFile);
+		playbackFile = NULL;
+		return efalse;
+	}
+
+	*seed = header[5] | header[6] << 8 | header[7] << 16 | (unsigned int)header[8] << 24;
+	playbackTick = 0;
+
+	return etrue;
+}
+
+/*
+ * replay_readEvent
+ * A truncated or damaged file reads as an END record at the last good tick.
+ */
+eboolean replay_readEvent(replay_event_t *ev)
+{
+	unsigned int	delta, key, x, y;
+	int				type;
+
+	if(playbackFile == NULL)
+		return efalse;
+
+	memset(ev, 0, sizeof(*ev));
+	ev->tick = playbackTick;
+	ev->type = REPLAY_END;
+
+	if(!replay_readVarint(&delta) || (type = fgetc(playbackFile)) == EOF)
+		return etrue;
+
+	playbackTick += delta;
+	ev->tick = playbackTick;
+
+	switch(type)
+	{
+	case REPLAY_KEYDOWN:
+	case REPLAY_KEYUP:
+		if(!replay_readVarint(&key))
+			return etrue;
+		if(key >= SDLK_LAST)
+		{
+			printf("Replay: key %u out of range, stopping.\n", key);
+			return etrue;
+		}
+		ev->key = key;
+		break;
+	case REPLAY_MOUSE:
+		if(!replay_readVarint(&x) || !replay_readVarint(&y))
+			return etrue;
+		ev->x = x;
+		ev->y = y;
+		break;
+	case REPLAY_END:
+		break;
+	default:
+		printf("Replay: unknown record type %d, stopping.\n", type);
+		return etrue;
+	}
+
+	ev->type = type;
+
+	return etrue;
+}
+
+/*
+ * replay_closePlayback
+ */
+void replay_closePlayback()
+{
+	if(playbackFile)
+		fclose(playbackFile);
+
+	playbackFile = NULL;
+}
@@ -0,0 +1,36 @@
+/*
+===========================================================================
+File:		system_replay.h
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+===========================================================================
+*/
+
+#ifndef SYSTEM_REPLAY_H_
+#define SYSTEM_REPLAY_H_
+
+#include "common.h"
+
+#define REPLAY_KEYDOWN	1
+#define REPLAY_KEYUP	2
+#define REPLAY_MOUSE	3
+#define REPLAY_END		4
+
+typedef struct
+{
+	unsigned int	tick;
+	int				type;
+	int				key;
+	int				x, y;
+}
+replay_event_t;
+
+eboolean replay_openRecord(char *name, unsigned int seed);
+void     replay_writeEvent(replay_event_t *ev);
+void     replay_closeRecord(unsigned int finalTick);
+
+eboolean replay_openPlayback(char *name, unsigned int *seed);
+eboolean replay_readEvent(replay_event_t *ev);
+void     replay_closePlayback();
+
+#endif /* SYSTEM_REPLAY_H_ */
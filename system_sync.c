@@ -0,0 +1,119 @@
+/*
+===========================================================================
+File:		system_sync.c
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+Description:	Lock-free hand-off between the simulation and render threads.
+===========================================================================
+*/
+
+#include <string.h>
+
+#include "system_memory.h"
+#include "system_sync.h"
+
+#define SYNC_FRESH 4
+
+/*
+ * sync_tripleInit
+ * All three slots start zeroed, and slot 0 is readable straight away.
+ */
+void sync_tripleInit(sync_tripleBuffer_t *tb, int slotSize)
+{
+	tb->slots	 = (byte *)memory_calloc(MEMORY_TAG_MISC, 3, slotSize);
+	tb->slotSize = slotSize;
+	tb->front	 = 0;
+	tb->middle	 = 1;
+	tb->back	 = 2;
+}
+
+/*
+ * sync_tripleWriteSlot
+ * Writer only. The returned slot belongs to the writer until published.
+ */
+void * sync_tripleWriteSlot(sync_tripleBuffer_t *tb)
+{
+	return tb->slots + tb->back * tb->slotSize;
+}
+
+/*
+ * sync_triplePublish
+ * Writer only. Swaps the finished slot into the middle and takes back
+ * whatever was there, read or not.
+ */
+void sync_triplePublish(sync_tripleBuffer_t *tb)
+{
+	int old;
+
+	old = __atomic_exchange_n(&tb->middle, tb->back | SYNC_FRESH, __ATOMIC_ACQ_REL);
+	tb->back = old & ~SYNC_FRESH;
+}
+
+/*
+ * sync_tripleRead
+ * Reader only. Picks up the middle slot if something new was published,
+ * otherwise keeps returning the last one.
+ */
+void * sync_tripleRead(sync_tripleBuffer_t *tb)
+{
+	int old;
+
+	if(__atomic_load_n(&tb->middle, __ATOMIC_ACQUIRE) & SYNC_FRESH)
+	{
+		old = __atomic_exchange_n(&tb->middle, tb->front, __ATOMIC_ACQ_REL);
+		tb->front = old & ~SYNC_FRESH;
+	}
+
+	return tb->slots + tb->front * tb->slotSize;
+}
+
+/*
+ * sync_queueInit
+ */
+void sync_queueInit(sync_spscQueue_t *q, int elemSize, int capacity)
+{
+	q->data		= (byte *)memory_alloc(MEMORY_TAG_MISC, elemSize * capacity);
+	q->elemSize	= elemSize;
+	q->mask		= capacity - 1;
+	q->head		= q->tail = 0;
+}
+
+/*
+ * sync_queuePush
+ * Producer only. Returns efalse and drops the element if the ring is full.
+ */
+eboolean sync_queuePush(sync_spscQueue_t *q, const void *elem)
+{
+	unsigned int tail, head;
+
+	tail = q->tail;
+	head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+
+	if(tail - head > q->mask)
+		return efalse;
+
+	memcpy(q->data + (tail & q->mask) * q->elemSize, elem, q->elemSize);
+	__atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+
+	return etrue;
+}
+
+/*
+ * sync_queuePop
+ * Consumer only. Returns efalse if there was nothing to pop.
+ */
+eboolean sync_queuePop(sync_spscQueue_t *q, void *elem)
+{
+	unsigned int tail, head;
+
+	head = q->head;
+	tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+
+	if(head == tail)
+		return efalse;
+
+	memcpy(elem, q->data + (head & q->mask) * q->elemSize, q->elemSize);
+	__atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+
+	return etrue;
+}
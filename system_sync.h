@@ -0,0 +1,53 @@
+/*
+===========================================================================
+File:		system_sync.h
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+===========================================================================
+*/
+
+#ifndef SYSTEM_SYNC_H_
+#define SYSTEM_SYNC_H_
+
+#include "common.h"
+
+//Plain shared flags/counters between threads
+#define sync_load(p)		__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define sync_store(p, v)	__atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+/*
+ * Triple buffer: one writer, one reader, neither ever waits. The reader
+ * always gets the most recently published slot.
+ */
+typedef struct
+{
+	byte	*slots;
+	int		slotSize;
+	int		back, front;
+	int		middle;			//slot index, plus SYNC_FRESH when unread
+}
+sync_tripleBuffer_t;
+
+void   sync_tripleInit(sync_tripleBuffer_t *tb, int slotSize);
+void * sync_tripleWriteSlot(sync_tripleBuffer_t *tb);
+void   sync_triplePublish(sync_tripleBuffer_t *tb);
+void * sync_tripleRead(sync_tripleBuffer_t *tb);
+
+/*
+ * Single-producer/single-consumer ring of fixed size elements.
+ * capacity must be a power of two.
+ */
+typedef struct
+{
+	byte			*data;
+	int				elemSize;
+	unsigned int	mask;
+	unsigned int	head, tail;
+}
+sync_spscQueue_t;
+
+void     sync_queueInit(sync_spscQueue_t *q, int elemSize, int capacity);
+eboolean sync_queuePush(sync_spscQueue_t *q, const void *elem);
+eboolean sync_queuePop(sync_spscQueue_t *q, void *elem);
+
+#endif /* SYSTEM_SYNC_H_ */
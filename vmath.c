@@ -0,0 +1,463 @@
+/*
+===========================================================================
+File:		vmath.c
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+Description:	Matrix and batch routines for vmath.h. Every matrix is
+				column-major, matching what GL hands back from glGetFloatv.
+===========================================================================
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "system_memory.h"
+#include "vmath.h"
+
+/*
+ * mat4_identity
+ */
+void mat4_identity(mat4_t m)
+{
+	static const mat4_t identity =
+	{1.0, 0.0, 0.0, 0.0,
+	 0.0, 1.0, 0.0, 0.0,
+	 0.0, 0.0, 1.0, 0.0,
+	 0.0, 0.0, 0.0, 1.0};
+
+	memcpy(m, identity, sizeof(mat4_t));
+}
+
+/*
+ * mat4_multiply
+ * out = a * b, the same product glMultMatrixf(b) produces on top of a.
+ * out may alias either input.
+ */
+void mat4_multiply(const mat4_t a, const mat4_t b, mat4_t out)
+{
+	mat4_t	result;
+	int		j;
+
+#ifdef VMATH_SSE
+	__m128 a0, a1, a2, a3, col;
+
+	a0 = _mm_loadu_ps(&a[0]);
+	a1 = _mm_loadu_ps(&a[4]);
+	a2 = _mm_loadu_ps(&a[8]);
+	a3 = _mm_loadu_ps(&a[12]);
+
+	for(j = 0; j < 4; j++)
+	{
+		col = _mm_mul_ps(a0, _mm_set1_ps(b[j*4+0]));
+		col = _mm_add_ps(col, _mm_mul_ps(a1, _mm_set1_ps(b[j*4+1])));
+		col = _mm_add_ps(col, _mm_mul_ps(a2, _mm_set1_ps(b[j*4+2])));
+		col = _mm_add_ps(col, _mm_mul_ps(a3, _mm_set1_ps(b[j*4+3])));
+
+		_mm_storeu_ps(&result[j*4], col);
+	}
+#else
+	int i;
+
+	for(j = 0; j < 4; j++)
+		for(i = 0; i < 4; i++)
+			result[j*4+i] = a[0*4+i] * b[j*4+0] + a[1*4+i] * b[j*4+1] +
+							a[2*4+i] * b[j*4+2] + a[3*4+i] * b[j*4+3];
+#endif
+
+	memcpy(out, result, sizeof(mat4_t));
+}
+
+/*
+ * mat4_transformPoints
+ * Transforms count packed xyz points by m with an implied w of 1. The
+ * projective row is ignored, so m should be affine. in and out may be the
+ * same array.
+ */
+void mat4_transformPoints(const mat4_t m, const vec_t *in, vec_t *out, int count)
+{
+	int i;
+
+#ifdef VMATH_SSE
+	__m128 c0, c1, c2, c3, p;
+
+	c0 = _mm_loadu_ps(&m[0]);
+	c1 = _mm_loadu_ps(&m[4]);
+	c2 = _mm_loadu_ps(&m[8]);
+	c3 = _mm_loadu_ps(&m[12]);
+
+	for(i = 0; i < count; i++, in += 3, out += 3)
+	{
+		p = _mm_add_ps(c3, _mm_mul_ps(c0, _mm_set1_ps(in[0])));
+		p = _mm_add_ps(p,  _mm_mul_ps(c1, _mm_set1_ps(in[1])));
+		p = _mm_add_ps(p,  _mm_mul_ps(c2, _mm_set1_ps(in[2])));
+
+		//Store xy as a pair and z on its own, never touching out[3]
+		_mm_storel_pi((__m64 *)out, p);
+		_mm_store_ss(&out[2], _mm_movehl_ps(p, p));
+	}
+#else
+	vec_t x, y, z;
+
+	for(i = 0; i < count; i++, in += 3, out += 3)
+	{
+		x = in[0]; y = in[1]; z = in[2];
+
+		out[0] = m[0]*x + m[4]*y + m[8]*z  + m[12];
+		out[1] = m[1]*x + m[5]*y + m[9]*z  + m[13];
+		out[2] = m[2]*x + m[6]*y + m[10]*z + m[14];
+	}
+#endif
+}
+
+/*
+ * mat4_transformVec4s
+ * Full 4x4 transform of count packed xyzw vectors. in and out may be the
+ * same array.
+ */
+void mat4_transformVec4s(const mat4_t m, const vec_t *in, vec_t *out, int count)
+{
+	int i;
+
+#ifdef VMATH_SSE
+	__m128 c0, c1, c2, c3, p;
+
+	c0 = _mm_loadu_ps(&m[0]);
+	c1 = _mm_loadu_ps(&m[4]);
+	c2 = _mm_loadu_ps(&m[8]);
+	c3 = _mm_loadu_ps(&m[12]);
+
+	for(i = 0; i < count; i++, in += 4, out += 4)
+	{
+		p = _mm_mul_ps(c0, _mm_set1_ps(in[0]));
+		p = _mm_add_ps(p, _mm_mul_ps(c1, _mm_set1_ps(in[1])));
+		p = _mm_add_ps(p, _mm_mul_ps(c2, _mm_set1_ps(in[2])));
+		p = _mm_add_ps(p, _mm_mul_ps(c3, _mm_set1_ps(in[3])));
+
+		_mm_storeu_ps(out, p);
+	}
+#else
+	vec_t x, y, z, w;
+
+	for(i = 0; i < count; i++, in += 4, out += 4)
+	{
+		x = in[0]; y = in[1]; z = in[2]; w = in[3];
+
+		out[0] = m[0]*x + m[4]*y + m[8]*z  + m[12]*w;
+		out[1] = m[1]*x + m[5]*y + m[9]*z  + m[13]*w;
+		out[2] = m[2]*x + m[6]*y + m[10]*z + m[14]*w;
+		out[3] = m[3]*x + m[7]*y + m[11]*z + m[15]*w;
+	}
+#endif
+}
+
+/*
+===========================================================================
+	TESTS
+
+	vmath_test checks the routines above against plain scalar versions
+	(and double precision where there is a right answer), then times them
+	against the macros vmath.h used to define. Run with -vmathtest.
+===========================================================================
+*/
+
+#define TEST_VECTORS	(1 << 16)
+#define TEST_RUNS		20
+
+//Bounds: rsqrt after one Newton step, and the SSE transforms, which add in
+//a different order from the scalar loops
+#define TEST_RSQRT_ERROR		5e-7
+#define TEST_TRANSFORM_ERROR	1e-6
+
+#ifdef VMATH_SSE
+	#define TEST_PATH	"SSE"
+#else
+	#define TEST_PATH	"scalar"
+#endif
+
+//The old macros, kept here only to time against. VectorMagnitude read an
+//uninitialized seed, it starts from the truncated square instead, and its
+//Newton loop can cycle forever in float (|v| = 6.92 does), so it is capped.
+#define OLD_VectorMagnitude(v,out) { \
+		float orig = v[0]*v[0]+v[1]*v[1]+v[2]*v[2]; \
+		int init = (int) orig, fin = (int) orig, steps = 0; \
+		char it = 1; \
+		while ((fin=fin>>1)>1) if ((it=!it)) init = (init>>1); \
+		out = (float) init; \
+		while (out*out/orig-1>0 && steps++ < 64) out=0.5*(out+orig/out); \
+}
+
+#define OLD_VectorNormalize(v,mag,out) { \
+		out[0] = v[0]/mag; \
+		out[1] = v[1]/mag; \
+		out[2] = v[2]/mag; \
+}
+
+#define OLD_MatrixIdentity(m) { \
+	int i; \
+	for(i = 0; i < 16; i++) \
+		if(i%5 == 0) m[i] = 1.0; \
+		else m[i] = 0.0; \
+}
+
+static unsigned int testSeed = 2463534242u;
+static volatile vec_t testSink;
+
+static double vmath_msec()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+//xorshift, so every run tests the same numbers
+static vec_t vmath_random(vec_t lo, vec_t hi)
+{
+	testSeed ^= testSeed << 13;
+	testSeed ^= testSeed >> 17;
+	testSeed ^= testSeed << 5;
+
+	return lo + (hi - lo) * (testSeed / 4294967296.0f);
+}
+
+static void vmath_refMultiply(const mat4_t a, const mat4_t b, mat4_t out)
+{
+	int i, j;
+
+	for(j = 0; j < 4; j++)
+		for(i = 0; i < 4; i++)
+			out[j*4+i] = a[0*4+i] * b[j*4+0] + a[1*4+i] * b[j*4+1] +
+						 a[2*4+i] * b[j*4+2] + a[3*4+i] * b[j*4+3];
+}
+
+static void vmath_refTransform(const mat4_t m, const vec_t *in, vec_t *out, int count, int stride)
+{
+	vec_t	x, y, z, w;
+	int		i;
+
+	for(i = 0; i < count; i++, in += stride, out += stride)
+	{
+		x = in[0]; y = in[1]; z = in[2]; w = stride == 4 ? in[3] : 1.0f;
+
+		out[0] = m[0]*x + m[4]*y + m[8]*z  + m[12]*w;
+		out[1] = m[1]*x + m[5]*y + m[9]*z  + m[13]*w;
+		out[2] = m[2]*x + m[6]*y + m[10]*z + m[14]*w;
+		if(stride == 4)
+			out[3] = m[3]*x + m[7]*y + m[11]*z + m[15]*w;
+	}
+}
+
+static void vmath_randomMatrix(mat4_t m)
+{
+	int i;
+
+	for(i = 0; i < 16; i++)
+		m[i] = vmath_random(-4.0f, 4.0f);
+}
+
+/*
+ * vmath_compare
+ * Largest difference between two arrays, relative to the largest reference
+ * value. A result near zero is a sum of terms that cancelled, it can't be
+ * held to its own size.
+ */
+static double vmath_compare(const vec_t *got, const vec_t *want, int count)
+{
+	double	scale = 1.0, worst = 0.0;
+	int		i;
+
+	for(i = 0; i < count; i++)
+		scale = fmax(scale, fabs(want[i]));
+
+	for(i = 0; i < count; i++)
+		worst = fmax(worst, fabs((double)got[i] - want[i]));
+
+	return worst / scale;
+}
+
+static int vmath_report(const char *name, double error, double bound)
+{
+	printf("  %-34s %10.3g %s\n", name, error, error <= bound ? "ok" : "FAILED");
+	return error <= bound ? 0 : 1;
+}
+
+/*
+ * vmath_testAccuracy
+ * Returns the number of failed checks.
+ */
+static int vmath_testAccuracy(vec_t *in, vec_t *out, vec_t *ref)
+{
+	mat4_t	a, b, c, want, got;
+	vec3_t	v, n;
+	double	len, err, worstNorm = 0.0, worstRsqrt = 0.0, worstMul = 0.0;
+	vec_t	x;
+	int		i, j, failed = 0;
+
+	printf("vmath accuracy, %s paths:\n", TEST_PATH);
+
+	//Magnitudes from 1e-15 to 1e15, the range normalize is used over
+	for(i = 0; i < TEST_VECTORS; i++)
+	{
+		x = powf(10.0f, vmath_random(-15.0f, 15.0f));
+		for(j = 0; j < 3; j++)
+			v[j] = vmath_random(-x, x);
+
+		len = sqrt((double)v[0]*v[0] + (double)v[1]*v[1] + (double)v[2]*v[2]);
+		if(len == 0.0)
+			continue;
+
+		vec3_normalize(v, n);
+		for(j = 0; j < 3; j++)
+			if((err = fabs(n[j] - v[j] / len)) > worstNorm)
+				worstNorm = err;
+
+		x = vmath_random(1e-6f, 1e6f);
+		if((err = fabs(vec3_rsqrt(x) * sqrt((double)x) - 1.0)) > worstRsqrt)
+			worstRsqrt = err;
+	}
+
+	failed += vmath_report("vec3_normalize, per component", worstNorm, TEST_RSQRT_ERROR);
+	failed += vmath_report("vec3_rsqrt, relative", worstRsqrt, TEST_RSQRT_ERROR);
+
+	//out may alias either input, or both
+	for(i = 0; i < 1000; i++)
+	{
+		vmath_randomMatrix(a);
+		vmath_randomMatrix(b);
+		vmath_refMultiply(a, b, want);
+
+		mat4_multiply(a, b, got);
+		if((err = vmath_compare(got, want, 16)) > worstMul) worstMul = err;
+
+		memcpy(c, a, sizeof(mat4_t));
+		mat4_multiply(c, b, c);
+		if((err = vmath_compare(c, got, 16)) > worstMul) worstMul = err;
+
+		memcpy(c, b, sizeof(mat4_t));
+		mat4_multiply(a, c, c);
+		if((err = vmath_compare(c, got, 16)) > worstMul) worstMul = err;
+
+		vmath_refMultiply(a, a, want);
+		memcpy(c, a, sizeof(mat4_t));
+		mat4_multiply(c, c, c);
+		if((err = vmath_compare(c, want, 16)) > worstMul) worstMul = err;
+	}
+
+	failed += vmath_report("mat4_multiply, aliased", worstMul, TEST_TRANSFORM_ERROR);
+
+	//Points are checked in place, with a guard after the last one, since
+	//the SSE path stores xy and z separately to stay inside the array
+	vmath_randomMatrix(a);
+	for(i = 0; i < TEST_VECTORS * 4; i++)
+		in[i] = vmath_random(-100.0f, 100.0f);
+
+	vmath_refTransform(a, in, ref, TEST_VECTORS, 3);
+	memcpy(out, in, sizeof(vec_t) * TEST_VECTORS * 4);
+	out[TEST_VECTORS * 3] = 12345.0f;
+	mat4_transformPoints(a, out, out, TEST_VECTORS);
+	err = vmath_compare(out, ref, TEST_VECTORS * 3);
+	if(out[TEST_VECTORS * 3] != 12345.0f)
+		err = 1.0;
+	failed += vmath_report("mat4_transformPoints vs scalar", err, TEST_TRANSFORM_ERROR);
+
+	vmath_refTransform(a, in, ref, TEST_VECTORS, 4);
+	mat4_transformVec4s(a, in, out, TEST_VECTORS);
+	failed += vmath_report("mat4_transformVec4s vs scalar", vmath_compare(out, ref, TEST_VECTORS * 4), TEST_TRANSFORM_ERROR);
+
+	return failed;
+}
+
+/*
+ * vmath_testSpeed
+ * Best of TEST_RUNS for each pair, old macro or scalar loop first.
+ */
+static void vmath_testSpeed(vec_t *in, vec_t *out)
+{
+	mat4_t	a, b, m;
+	double	start, oldBest, newBest, t;
+	vec_t	mag, sum;
+	vec_t	*v;
+	int		test, run, i;
+
+	static const char *names[] =
+	{
+		"VectorMagnitude -> vec3_length",
+		"VectorNormalize -> vec3_normalize",
+		"MatrixIdentity -> mat4_identity",
+		"scalar multiply -> mat4_multiply",
+		"scalar points -> transformPoints",
+		"scalar vec4s -> transformVec4s"
+	};
+
+	printf("vmath speed, %d vectors or matrices, ms:\n", TEST_VECTORS);
+	printf("  %-34s %8s %8s %8s\n", "", "old", "new", "speedup");
+
+	for(i = 0; i < TEST_VECTORS * 4; i++)
+		in[i] = vmath_random(1.0f, 100.0f);
+
+	vmath_randomMatrix(a);
+	vmath_randomMatrix(b);
+
+	for(test = 0; test < 6; test++)
+	{
+		oldBest = newBest = 1e9;
+
+		for(run = 0; run < TEST_RUNS * 2; run++)
+		{
+			start = vmath_msec();
+			sum = 0.0f;
+
+			for(i = 0, v = in; i < TEST_VECTORS && test < 4; i++, v += 3)
+			{
+				switch(test * 2 + (run & 1))
+				{
+				case 0:	OLD_VectorMagnitude(v, mag); sum += mag; break;
+				case 1:	sum += vec3_length(v); break;
+				case 2:	OLD_VectorMagnitude(v, mag); OLD_VectorNormalize(v, mag, (&out[i*3])); break;
+				case 3:	vec3_normalize(v, &out[i*3]); break;
+				case 4:	OLD_MatrixIdentity(m); testSink = m[i & 15]; break;
+				case 5:	mat4_identity(m); testSink = m[i & 15]; break;
+				case 6:	vmath_refMultiply(a, b, m); testSink = m[i & 15]; break;
+				case 7:	mat4_multiply(a, b, m); testSink = m[i & 15]; break;
+				}
+			}
+
+			if(test == 4)
+				(run & 1) ? mat4_transformPoints(a, in, out, TEST_VECTORS) : vmath_refTransform(a, in, out, TEST_VECTORS, 3);
+			if(test == 5)
+				(run & 1) ? mat4_transformVec4s(a, in, out, TEST_VECTORS) : vmath_refTransform(a, in, out, TEST_VECTORS, 4);
+
+			testSink = sum + out[run];
+			t = vmath_msec() - start;
+
+			if(run & 1)
+				newBest = t < newBest ? t : newBest;
+			else
+				oldBest = t < oldBest ? t : oldBest;
+		}
+
+		printf("  %-34s %8.3f %8.3f %8.2f\n", names[test], oldBest, newBest, oldBest / newBest);
+	}
+}
+
+/*
+ * vmath_test
+ * Prints the accuracy checks and timings, returns the number of failed
+ * checks.
+ */
+int vmath_test()
+{
+	vec_t	*in, *out, *ref;
+	int		failed;
+
+	in	= (vec_t *)memory_alloc(MEMORY_TAG_MISC, sizeof(vec_t) * TEST_VECTORS * 4 * 3);
+	out	= in + TEST_VECTORS * 4;
+	ref	= out + TEST_VECTORS * 4;
+
+	failed = vmath_testAccuracy(in, out, ref);
+	vmath_testSpeed(in, out);
+
+	memory_free(in);
+	return failed;
+}
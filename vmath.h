@@ -1,6 +1,13 @@
 #ifndef VMATH_H
 #define VMATH_H
 
+#include <math.h>
+
+#if defined(__SSE__) && !defined(VMATH_NO_SIMD)
+	#define VMATH_SSE
+	#include <xmmintrin.h>
+#endif
+
 // Vector typedefs
 typedef float vec_t;
 typedef vec_t vec2_t[2];
@@ -8,6 +15,9 @@ typedef vec_t vec3_t[3];
 typedef vec_t vec4_t[4];
 typedef vec_t vec5_t[5];
 
+// Column-major, same layout glLoadMatrixf/glMultMatrixf expect
+typedef vec_t mat4_t[16];
+
 #define M_PI_DIV180 0.01745329251994329576
 #define SQRT_2 1.41421356237
 
@@ -15,17 +25,117 @@ typedef vec_t vec5_t[5];
 #define _Y 1
 #define _Z 2
 
+/*
+===========================================================================
+	vec3 / vec4 / mat4
+
+	Small operations are inlined here, the batch and matrix routines live
+	in vmath.c. Defining VMATH_NO_SIMD forces the scalar paths everywhere.
+===========================================================================
+*/
+
+void mat4_identity(mat4_t m);
+void mat4_multiply(const mat4_t a, const mat4_t b, mat4_t out);
+void mat4_transformPoints(const mat4_t m, const vec_t *in, vec_t *out, int count);
+void mat4_transformVec4s(const mat4_t m, const vec_t *in, vec_t *out, int count);
+int  vmath_test();
+
+static inline vec_t vec3_dot(const vec3_t a, const vec3_t b)
+{
+	return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+static inline vec_t vec4_dot(const vec4_t a, const vec4_t b)
+{
+#ifdef VMATH_SSE
+	__m128 m = _mm_mul_ps(_mm_loadu_ps(a), _mm_loadu_ps(b));
+
+	m = _mm_add_ps(m, _mm_movehl_ps(m, m));
+	m = _mm_add_ss(m, _mm_shuffle_ps(m, m, 1));
+
+	return _mm_cvtss_f32(m);
+#else
+	return a[0]*b[0] + a[1]*b[1] + a[2]*b[2] + a[3]*b[3];
+#endif
+}
+
+static inline void vec3_cross(const vec3_t a, const vec3_t b, vec3_t out)
+{
+	vec_t x, y, z;
+
+	//Temporaries so out may alias a or b
+	x = a[1]*b[2] - a[2]*b[1];
+	y = a[2]*b[0] - a[0]*b[2];
+	z = a[0]*b[1] - a[1]*b[0];
+
+	out[0] = x; out[1] = y; out[2] = z;
+}
+
+static inline void vec3_scale(const vec3_t v, vec_t s, vec3_t out)
+{
+	out[0] = s*v[0];
+	out[1] = s*v[1];
+	out[2] = s*v[2];
+}
+
+static inline vec_t vec3_length(const vec3_t v)
+{
+	return sqrtf(vec3_dot(v, v));
+}
+
+/*
+ * vec3_rsqrt
+ * Reciprocal square root. The SSE estimate is only good to ~12 bits, one
+ * Newton-Raphson step brings it to within a couple ulps of 1/sqrtf.
+ */
+static inline vec_t vec3_rsqrt(vec_t x)
+{
+#ifdef VMATH_SSE
+	vec_t r = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(x)));
+
+	return r * (1.5f - 0.5f * x * r * r);
+#else
+	return 1.0f / sqrtf(x);
+#endif
+}
+
+/*
+ * vec3_normalize
+ * Writes the unit length version of v to out (out may be v) and returns
+ * the original length. Zero vectors are passed through unchanged.
+ */
+static inline vec_t vec3_normalize(const vec3_t v, vec3_t out)
+{
+	vec_t lenSq, inv;
+
+	lenSq = vec3_dot(v, v);
+
+	if(lenSq <= 0.0f)
+	{
+		out[0] = v[0]; out[1] = v[1]; out[2] = v[2];
+		return 0.0f;
+	}
+
+	inv = vec3_rsqrt(lenSq);
+	vec3_scale(v, inv, out);
+
+	return lenSq * inv;
+}
+
+/*
+===========================================================================
+	Legacy macros, kept for existing callers
+===========================================================================
+*/
 
 // DotProduct(input vector 1, input vector 2, output float)
 #define DotProduct(v1,v2,out) { \
-		out = v1[0]*v2[0]+v1[1]*v2[1]+v1[2]*v2[2]; \
+		out = vec3_dot(v1, v2); \
 }
 
 // CrossProduct(input vector 1, input vector 2, output vector)
 #define CrossProduct(v1,v2,out) { \
-		out[0] = v1[1]*v2[2]-v1[2]*v2[1]; \
-		out[1] = v1[2]*v2[0]-v1[0]*v2[2]; \
-		out[2] = v1[0]*v2[1]-v1[1]*v2[0]; \
+		vec3_cross(v1, v2, out); \
 }
 
 // VectorAdd(input vector 1, input vector 2, output vector)
@@ -45,9 +155,7 @@ typedef vec_t vec5_t[5];
 
 // VectorScale(input vector, input scalar, output vector
 #define VectorScale(v,s,out) { \
-		out[0] = s*v[0]; \
-		out[1] = s*v[1]; \
-		out[2] = s*v[2]; \
+		vec3_scale(v, s, out); \
 }
 
 // VectorCopy(input vector, output vector)
@@ -73,19 +181,12 @@ typedef vec_t vec5_t[5];
 
 // VectorMagnitude(input vector, output float)
 #define VectorMagnitude(v,out) { \
-		float orig = v[0]*v[0]+v[1]*v[1]+v[2]*v[2]; \
-		int init,fin = (int) orig; \
-		char it = 1; \
-		while ((fin=fin>>1)>1) if (it=!it) init = (init>>1); \
-		out = (float) init; \
-		while (out*out/orig-1>0) out=0.5*(out+orig/out); \
+		out = vec3_length(v); \
 }
 
 // VectorNormalize(input vector, input magnitude(calculated previously), output vector)
 #define VectorNormalize(v,mag,out) { \
-		out[0] = v[0]/mag; \
-		out[1] = v[1]/mag; \
-		out[2] = v[2]/mag; \
+		vec3_scale(v, 1.0f/(mag), out); \
 }
 
 /*
@@ -93,10 +194,7 @@ typedef vec_t vec5_t[5];
  * Sets input matrix to the identity.
  */
 #define MatrixIdentity(m) { \
-	int i; \
-	for(i = 0; i < 16; i++) \
-		if(i%5 == 0) m[i] = 1.0; \
-		else m[i] = 0.0; \
+	mat4_identity(m); \
 }
 
 #endif
@@ -0,0 +1,764 @@
+/*
+===========================================================================
+File:		world.c
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+Description:	Chunked world streaming. The world is a grid of square
+				chunks, each with an optional model (authored in world
+				space), a ground texture and the model's collision
+				triangles. Chunks within WORLD_RADIUS of the camera are
+				read and decoded on a loader thread, uploaded to GL a few
+				per frame, and evicted once they fall a full ring outside
+				the radius. The slot array is fixed, so memory stays
+				bounded however large the world is.
+
+				Collision triangles belong to the chunk definition and
+				are reference counted, so a streamed chunk and the
+				simulation share one copy, which is freed once neither
+				holds it.
+
+				Manifest format (see world.txt):
+				  *WORLD_CHUNKSIZE <units>
+				  *WORLD_RADIUS <chunks>
+				  *WORLD_GROUND <y>
+				  *WORLD_DEFAULT_TEXTURE "<tga>"
+				  *WORLD_TERRAIN "<heightmap tga>" <spacing> <height scale>
+				  *WORLD_EMBERS <x> <y> <z> <half width> <per second>
+				  *CHUNK <cx> <cz> "<ase or ->" "<tga or ->"
+				Chunks that are not listed get bare ground. With a terrain,
+				the heightfield (based at WORLD_GROUND, centred on the
+				origin) replaces the flat per chunk ground.
+===========================================================================
+*/
+
+#include <SDL/SDL.h>
+#include <SDL/SDL_opengl.h>
+#include <math.h>
+#include <string.h>
+
+#include "files.h"
+#include "renderer_materials.h"
+#include "renderer_models.h"
+#include "renderer_particles.h"
+#include "renderer_profile.h"
+#include "renderer_queue.h"
+#include "renderer_terrain.h"
+#include "system_memory.h"
+#include "system_sync.h"
+#include "world.h"
+
+//One ring of hysteresis past the load radius
+#define WORLD_MAX_CHUNKS		((2*WORLD_MAX_RADIUS+3) * (2*WORLD_MAX_RADIUS+3))
+#define WORLD_QUEUE_SIZE		128
+#define WORLD_UPLOADS_PER_FRAME	1
+
+//Chunks the simulation holds collision for, the square of the radius
+#define WORLD_SIM_CHUNKS		((2*WORLD_MAX_RADIUS+1) * (2*WORLD_MAX_RADIUS+1))
+
+//Estimate for a ground display list, four vertices with texcoords
+#define WORLD_GROUND_LIST_BYTES	(4 * 5 * (int)sizeof(float))
+
+typedef enum
+{
+	CHUNK_FREE,
+	CHUNK_LOADING,		//owned by the loader thread
+	CHUNK_READY,		//decoded, waiting for a GL upload
+	CHUNK_RESIDENT
+}
+world_chunkState_t;
+
+typedef struct
+{
+	int		cx, cz;
+	char	model[MAX_FILEPATH];
+	char	texture[MAX_FILEPATH];
+
+	//Packed 9 floats each, only while collisionRefs > 0. Guarded by
+	//collisionLock.
+	vec_t	*collisionTris;
+	int		numCollisionTris, collisionRefs;
+}
+world_chunkDef_t;
+
+typedef struct
+{
+	world_chunkState_t		state;
+	int						cx, cz;
+	eboolean				evict;
+	world_chunkDef_t		*def;
+	eboolean				holdsCollision;
+
+	//Loader output
+	ase_model_t				*parsed;
+	byte					*pixels;
+	int						width, height, bpp;
+
+	//GL side
+	int						modelIndex;
+	int						groundTex;
+	eboolean				ownsTexture;
+	int						groundList;
+	vec3_t					center;
+}
+world_chunk_t;
+
+static world_chunkDef_t	*defList = NULL;
+static int				numDefs = 0;
+
+static world_chunk_t	chunkList[WORLD_MAX_CHUNKS];
+
+static float			chunkSize = 400.0f, groundY = -201.0f;
+static int				loadRadius = 1;
+static int				defaultTexture = 0;
+
+static eboolean			useTerrain = efalse;
+static char				terrainName[MAX_FILEPATH];
+static float			terrainSpacing = 1.0f, terrainScale = 1.0f;
+static vec3_t			eyePosition;
+
+static vec3_t			emberOrigin;
+static float			emberRadius = 0.0f, emberRate = 0.0f;
+
+static int				lastCX = 0x7FFFFFFF, lastCZ = 0x7FFFFFFF;
+static eboolean			rescan = etrue;
+
+//Loader thread plumbing, both queues carry chunk slot indices
+static SDL_Thread		*loaderThread = NULL;
+static SDL_sem			*loaderSem = NULL;
+static sync_spscQueue_t	requestQueue, doneQueue;
+static int				loaderQuit = 0;
+
+static SDL_mutex		*collisionLock = NULL;
+static int				numHeldCollision = 0;
+
+//Owned by the simulation thread, see world_updateCollision
+static world_chunkDef_t	*simHeld[WORLD_SIM_CHUNKS];
+static int				numSimHeld = 0;
+static int				simCX = 0x7FFFFFFF, simCZ = 0x7FFFFFFF;
+
+static unsigned int		statLoads = 0, statEvictions = 0, statPeakResident = 0;
+static unsigned int		statCollisionLoads = 0, statPeakCollision = 0;
+
+static int world_loaderThread(void *data);
+
+/*
+===========================================================================
+	Manifest
+===========================================================================
+*/
+
+static int world_compareDefs(const void *a, const void *b)
+{
+	const world_chunkDef_t *da = (const world_chunkDef_t *)a, *db = (const world_chunkDef_t *)b;
+
+	if(da->cz != db->cz)
+		return da->cz < db->cz ? -1 : 1;
+	if(da->cx != db->cx)
+		return da->cx < db->cx ? -1 : 1;
+	return 0;
+}
+
+static world_chunkDef_t * world_findDef(int cx, int cz)
+{
+	world_chunkDef_t key;
+
+	key.cx = cx;
+	key.cz = cz;
+
+	return (world_chunkDef_t *)bsearch(&key, defList, numDefs, sizeof(world_chunkDef_t), world_compareDefs);
+}
+
+static void world_copyName(char *dst, const char *src)
+{
+	if(!strcmp(src, "-"))
+		src = "";
+
+	strncpy(dst, src, MAX_FILEPATH-1);
+	dst[MAX_FILEPATH-1] = '\0';
+}
+
+static void world_parseManifest(char *manifest)
+{
+	char	*text, **tokens;
+	int		numTokens, i, w, h, bpp;
+
+	text = files_readTextFile(manifest);
+	if(text == NULL)
+		return;
+
+	numTokens = files_tokenizeStr(text, " \t\n\r", &tokens);
+	memory_free(text);
+
+	for(i = 0; i < numTokens; i++)
+	{
+		if(!strcmp(tokens[i], "*WORLD_CHUNKSIZE") && i+1 < numTokens)
+			chunkSize = atof(tokens[++i]);
+		else if(!strcmp(tokens[i], "*WORLD_RADIUS") && i+1 < numTokens)
+			loadRadius = atoi(tokens[++i]);
+		else if(!strcmp(tokens[i], "*WORLD_GROUND") && i+1 < numTokens)
+			groundY = atof(tokens[++i]);
+		else if(!strcmp(tokens[i], "*WORLD_DEFAULT_TEXTURE") && i+1 < numTokens)
+			renderer_img_loadTGA(tokens[++i], &defaultTexture, &w, &h, &bpp);
+		else if(!strcmp(tokens[i], "*WORLD_TERRAIN") && i+3 < numTokens)
+		{
+			world_copyName(terrainName, tokens[++i]);
+			terrainSpacing = atof(tokens[++i]);
+			terrainScale   = atof(tokens[++i]);
+		}
+		else if(!strcmp(tokens[i], "*WORLD_EMBERS") && i+5 < numTokens)
+		{
+			emberOrigin[_X] = atof(tokens[++i]);
+			emberOrigin[_Y] = atof(tokens[++i]);
+			emberOrigin[_Z] = atof(tokens[++i]);
+			emberRadius		= atof(tokens[++i]);
+			emberRate		= atof(tokens[++i]);
+		}
+		else if(!strcmp(tokens[i], "*CHUNK") && i+4 < numTokens)
+		{
+			defList = (world_chunkDef_t *)memory_realloc(MEMORY_TAG_WORLD, defList, sizeof(world_chunkDef_t) * (numDefs+1));
+			memset(&defList[numDefs], 0, sizeof(world_chunkDef_t));
+			defList[numDefs].cx = atoi(tokens[++i]);
+			defList[numDefs].cz = atoi(tokens[++i]);
+			world_copyName(defList[numDefs].model,   tokens[++i]);
+			world_copyName(defList[numDefs].texture, tokens[++i]);
+			numDefs++;
+		}
+	}
+
+	for(i = 0; i < numTokens; i++)
+		memory_free(tokens[i]);
+	memory_free(tokens);
+
+	if(loadRadius < 0)
+		loadRadius = 0;
+	if(loadRadius > WORLD_MAX_RADIUS)
+	{
+		printf("World: radius %d clamped to %d.\n", loadRadius, WORLD_MAX_RADIUS);
+		loadRadius = WORLD_MAX_RADIUS;
+	}
+
+	qsort(defList, numDefs, sizeof(world_chunkDef_t), world_compareDefs);
+}
+
+/*
+===========================================================================
+	Collision, any thread
+===========================================================================
+*/
+
+/*
+ * world_tryHoldCollision
+ * Takes another reference on a definition's triangles if someone already
+ * holds them. Returns efalse if nobody does, the caller then reads them
+ * and passes them to world_holdCollision.
+ */
+static eboolean world_tryHoldCollision(world_chunkDef_t *def)
+{
+	eboolean held;
+
+	SDL_LockMutex(collisionLock);
+	held = def->collisionRefs > 0;
+	if(held)
+		def->collisionRefs++;
+	SDL_UnlockMutex(collisionLock);
+
+	return held;
+}
+
+/*
+ * world_holdCollision
+ * Takes a reference on a definition's triangles, with tris (may be NULL)
+ * becoming them if nobody holds any. Otherwise another thread got there
+ * first, and tris is freed.
+ */
+static void world_holdCollision(world_chunkDef_t *def, vec_t *tris, int numTris)
+{
+	SDL_LockMutex(collisionLock);
+
+	if(def->collisionRefs == 0)
+	{
+		def->collisionTris	  = tris;
+		def->numCollisionTris = numTris;
+		tris = NULL;
+
+		statCollisionLoads++;
+		if((unsigned int)++numHeldCollision > statPeakCollision)
+			statPeakCollision = numHeldCollision;
+	}
+
+	def->collisionRefs++;
+
+	SDL_UnlockMutex(collisionLock);
+
+	memory_free(tris);
+}
+
+static void world_dropCollision(world_chunkDef_t *def)
+{
+	vec_t *tris = NULL;
+
+	SDL_LockMutex(collisionLock);
+
+	if(--def->collisionRefs == 0)
+	{
+		tris = def->collisionTris;
+		def->collisionTris	  = NULL;
+		def->numCollisionTris = 0;
+		numHeldCollision--;
+	}
+
+	SDL_UnlockMutex(collisionLock);
+
+	memory_free(tris);
+}
+
+/*
+===========================================================================
+	Loader thread
+===========================================================================
+*/
+
+/*
+ * world_loaderThread
+ * Does all the file reading, parsing and decoding for a chunk. Nothing here
+ * touches GL; the chunk slot belongs to this thread until it is handed back
+ * through doneQueue.
+ */
+static int world_loaderThread(void *data)
+{
+	world_chunk_t	*chunk;
+	vec_t			*tris;
+	int				slot, numTris;
+	eboolean		held;
+
+	while(1)
+	{
+		SDL_SemWait(loaderSem);
+
+		if(sync_load(&loaderQuit))
+			break;
+
+		if(!sync_queuePop(&requestQueue, &slot))
+			continue;
+
+		chunk = &chunkList[slot];
+
+		//Triangles are only packed if the simulation doesn't already hold
+		//this chunk's
+		if(chunk->def && chunk->def->model[0])
+		{
+			held = world_tryHoldCollision(chunk->def);
+			chunk->parsed = renderer_model_parseASE(chunk->def->model, !held);
+
+			if(!held)
+			{
+				tris = renderer_model_takeCollisionASE(chunk->parsed, &numTris);
+				world_holdCollision(chunk->def, tris, numTris);
+			}
+
+			chunk->holdsCollision = etrue;
+		}
+
+		if(chunk->def && chunk->def->texture[0] && !useTerrain)
+			chunk->pixels = renderer_img_decodeTGA((char *)chunk->def->texture,
+					&chunk->width, &chunk->height, &chunk->bpp);
+
+		sync_queuePush(&doneQueue, &slot);
+	}
+
+	return 0;
+}
+
+/*
+===========================================================================
+	Chunk management (GL thread)
+===========================================================================
+*/
+
+static void world_releaseChunk(world_chunk_t *chunk)
+{
+	renderer_model_discardASE(chunk->parsed);
+	memory_free(chunk->pixels);
+
+	if(chunk->state == CHUNK_RESIDENT)
+	{
+		renderer_model_freeASE(chunk->modelIndex);
+		if(chunk->groundList)
+		{
+			glDeleteLists(chunk->groundList, 1);
+			memory_trackGPU(MEMORY_TAG_WORLD, -WORLD_GROUND_LIST_BYTES, -1);
+		}
+
+		if(chunk->ownsTexture)
+			renderer_img_deleteTexture(chunk->groundTex);
+	}
+
+	if(chunk->holdsCollision)
+		world_dropCollision(chunk->def);
+
+	memset(chunk, 0, sizeof(world_chunk_t));
+	chunk->state = CHUNK_FREE;
+	statEvictions++;
+}
+
+static void world_uploadChunk(world_chunk_t *chunk)
+{
+	float x0, x1, z0, z1;
+
+	chunk->modelIndex = -1;
+	if(chunk->parsed)
+		chunk->modelIndex = renderer_model_uploadASE(chunk->parsed);
+	chunk->parsed = NULL;
+
+	chunk->groundTex   = defaultTexture;
+	chunk->ownsTexture = efalse;
+	if(chunk->pixels)
+	{
+		chunk->groundTex   = renderer_img_uploadImage(chunk->pixels, chunk->width, chunk->height, chunk->bpp);
+		renderer_img_trackTexture(chunk->groundTex, (char *)chunk->def->texture,
+				chunk->pixels, chunk->width, chunk->height, chunk->bpp);
+		chunk->ownsTexture = etrue;
+		memory_free(chunk->pixels);
+		chunk->pixels = NULL;
+	}
+
+	x0 = (chunk->cx - 0.5f) * chunkSize; x1 = x0 + chunkSize;
+	z0 = (chunk->cz - 0.5f) * chunkSize; z1 = z0 + chunkSize;
+
+	chunk->center[_X] = chunk->cx * chunkSize;
+	chunk->center[_Y] = groundY;
+	chunk->center[_Z] = chunk->cz * chunkSize;
+
+	if(useTerrain)
+	{
+		chunk->state = CHUNK_RESIDENT;
+		statLoads++;
+		return;
+	}
+
+	chunk->groundList = glGenLists(1);
+	memory_trackGPU(MEMORY_TAG_WORLD, WORLD_GROUND_LIST_BYTES, 1);
+	glNewList(chunk->groundList, GL_COMPILE);
+		glBegin(GL_QUADS);
+		glTexCoord2f(0,0); glVertex3f(x1, groundY, z1);
+		glTexCoord2f(1,0); glVertex3f(x1, groundY, z0);
+		glTexCoord2f(1,1); glVertex3f(x0, groundY, z0);
+		glTexCoord2f(0,1); glVertex3f(x0, groundY, z1);
+		glEnd();
+	glEndList();
+
+	chunk->state = CHUNK_RESIDENT;
+	statLoads++;
+}
+
+static world_chunk_t * world_findChunk(int cx, int cz)
+{
+	int i;
+
+	for(i = 0; i < WORLD_MAX_CHUNKS; i++)
+		if(chunkList[i].state != CHUNK_FREE && chunkList[i].cx == cx && chunkList[i].cz == cz)
+			return &chunkList[i];
+
+	return NULL;
+}
+
+/*
+ * world_requestChunk
+ * Returns efalse if there was no free slot, the caller should retry later.
+ */
+static eboolean world_requestChunk(int cx, int cz)
+{
+	int i;
+
+	for(i = 0; i < WORLD_MAX_CHUNKS; i++)
+		if(chunkList[i].state == CHUNK_FREE)
+			break;
+
+	if(i == WORLD_MAX_CHUNKS)
+		return efalse;
+
+	memset(&chunkList[i], 0, sizeof(world_chunk_t));
+	chunkList[i].cx    = cx;
+	chunkList[i].cz    = cz;
+	chunkList[i].def   = world_findDef(cx, cz);
+	chunkList[i].state = CHUNK_LOADING;
+
+	sync_queuePush(&requestQueue, &i);
+	SDL_SemPost(loaderSem);
+
+	return etrue;
+}
+
+/*
+ * world_init
+ * GL thread, once at startup.
+ */
+void world_init(char *manifest)
+{
+	vec3_t origin = {0, 0, 0};
+
+	world_parseManifest(manifest);
+
+	if(emberRate > 0.0f)
+		renderer_particles_setEmitter(emberOrigin, emberRadius, emberRate);
+
+	if(terrainName[0])
+	{
+		origin[_Y] = groundY;
+		useTerrain = renderer_terrain_init(terrainName, defaultTexture, origin, terrainSpacing, terrainScale);
+	}
+
+	sync_queueInit(&requestQueue, sizeof(int), WORLD_QUEUE_SIZE);
+	sync_queueInit(&doneQueue,    sizeof(int), WORLD_QUEUE_SIZE);
+
+	collisionLock = SDL_CreateMutex();
+
+	loaderSem	 = SDL_CreateSemaphore(0);
+	loaderThread = SDL_CreateThread(world_loaderThread, NULL);
+}
+
+/*
+ * world_update
+ * GL thread, once per frame. Collects finished loads, uploads a bounded
+ * number of them, and re-evaluates the wanted set when the camera crosses
+ * into another chunk.
+ */
+void world_update(const vec3_t position)
+{
+	world_chunk_t	*chunk;
+	int				slot, i, cx, cz, r, dx, dz, uploads, resident;
+
+	while(sync_queuePop(&doneQueue, &slot))
+	{
+		chunk = &chunkList[slot];
+
+		if(chunk->evict)
+			world_releaseChunk(chunk);
+		else
+			chunk->state = CHUNK_READY;
+	}
+
+	VectorCopy(position, eyePosition);
+
+	cx = (int)floorf(position[_X] / chunkSize + 0.5f);
+	cz = (int)floorf(position[_Z] / chunkSize + 0.5f);
+
+	if(cx != lastCX || cz != lastCZ || rescan)
+	{
+		lastCX = cx;
+		lastCZ = cz;
+		rescan = efalse;
+
+		//Evict a full ring past the radius, so walking along a border
+		//doesn't thrash
+		for(i = 0; i < WORLD_MAX_CHUNKS; i++)
+		{
+			chunk = &chunkList[i];
+
+			if(chunk->state == CHUNK_FREE)
+				continue;
+			if(abs(chunk->cx - cx) <= loadRadius+1 && abs(chunk->cz - cz) <= loadRadius+1)
+				continue;
+
+			if(chunk->state == CHUNK_LOADING)
+				chunk->evict = etrue;
+			else
+				world_releaseChunk(chunk);
+		}
+
+		//Request nearest rings first
+		for(r = 0; r <= loadRadius; r++)
+			for(dz = -r; dz <= r; dz++)
+				for(dx = -r; dx <= r; dx++)
+				{
+					if(abs(dx) != r && abs(dz) != r)
+						continue;
+
+					chunk = world_findChunk(cx+dx, cz+dz);
+
+					if(chunk && chunk->evict)
+						chunk->evict = efalse;
+					else if(!chunk && !world_requestChunk(cx+dx, cz+dz))
+						rescan = etrue;
+				}
+	}
+
+	//Spread GL uploads out so crossing a border never costs a big frame
+	for(i = 0, uploads = 0, resident = 0; i < WORLD_MAX_CHUNKS; i++)
+	{
+		if(chunkList[i].state == CHUNK_READY && uploads < WORLD_UPLOADS_PER_FRAME)
+		{
+			world_uploadChunk(&chunkList[i]);
+			uploads++;
+		}
+
+		if(chunkList[i].state == CHUNK_RESIDENT)
+			resident++;
+	}
+
+	if((unsigned int)resident > statPeakResident)
+		statPeakResident = resident;
+}
+
+static void world_drawGround(int slot)
+{
+	glCallList(chunkList[slot].groundList);
+}
+
+/*
+ * world_queue
+ * Submits the terrain and every resident chunk to the render queue.
+ */
+void world_queue(const mat4_t viewMatrix)
+{
+	int		i;
+	float	seconds = SDL_GetTicks() / 1000.0f;
+
+	if(useTerrain)
+	{
+		renderer_queue_setPass(PROFILE_PASS_TERRAIN);
+		renderer_terrain_queue(viewMatrix, eyePosition);
+	}
+
+	for(i = 0; i < WORLD_MAX_CHUNKS; i++)
+	{
+		if(chunkList[i].state != CHUNK_RESIDENT)
+			continue;
+
+		renderer_queue_setPass(PROFILE_PASS_STATIC);
+		if(chunkList[i].groundList)
+			renderer_queue_add(QUEUE_LAYER_WORLD, efalse, chunkList[i].groundTex, chunkList[i].center,
+					QUEUE_SOURCE_NONE, world_drawGround, i);
+
+		renderer_queue_setPass(PROFILE_PASS_MODELS);
+		if(chunkList[i].modelIndex >= 0)
+		{
+			renderer_model_animateASE(chunkList[i].modelIndex, seconds);
+			renderer_model_queueASE(chunkList[i].modelIndex);
+		}
+	}
+}
+
+/*
+ * world_shutdown
+ */
+void world_shutdown()
+{
+	int i;
+
+	if(loaderThread)
+	{
+		sync_store(&loaderQuit, 1);
+		SDL_SemPost(loaderSem);
+		SDL_WaitThread(loaderThread, NULL);
+		SDL_DestroySemaphore(loaderSem);
+		loaderThread = NULL;
+	}
+
+	for(i = 0; i < WORLD_MAX_CHUNKS; i++)
+		if(chunkList[i].state != CHUNK_FREE)
+			world_releaseChunk(&chunkList[i]);
+
+	//Whatever the simulation still holds, it has stopped by now
+	for(i = 0; i < numDefs; i++)
+		memory_free(defList[i].collisionTris);
+	numHeldCollision = numSimHeld = 0;
+	simCX = simCZ = 0x7FFFFFFF;
+
+	if(collisionLock)
+		SDL_DestroyMutex(collisionLock);
+	collisionLock = NULL;
+
+	memory_free(defList);
+	defList = NULL;
+	numDefs = 0;
+
+	renderer_terrain_free();
+	useTerrain = efalse;
+}
+
+/*
+ * world_updateCollision
+ * Simulation thread. Holds the collision of every chunk definition within
+ * the radius (at least one, models overhang their cells) of the chunk
+ * containing position, reading any that nobody holds yet, and drops the
+ * rest. Only position and the manifest matter, never what has streamed
+ * in. Returns etrue if the held set changed; the caller then rebuilds from
+ * world_getCollision.
+ */
+eboolean world_updateCollision(const vec3_t position)
+{
+	world_chunkDef_t	*def, *held[WORLD_SIM_CHUNKS];
+	vec_t				*tris;
+	int					cx, cz, dx, dz, r, i, n, numTris;
+	eboolean			changed;
+
+	cx = (int)floorf(position[_X] / chunkSize + 0.5f);
+	cz = (int)floorf(position[_Z] / chunkSize + 0.5f);
+
+	if(cx == simCX && cz == simCZ)
+		return efalse;
+
+	simCX = cx;
+	simCZ = cz;
+	r = loadRadius > 0 ? loadRadius : 1;
+
+	//The new set is held before the old one is dropped, so chunks in both
+	//are never read again
+	for(n = 0, dz = -r; dz <= r; dz++)
+		for(dx = -r; dx <= r; dx++)
+		{
+			def = world_findDef(cx+dx, cz+dz);
+			if(def == NULL || !def->model[0])
+				continue;
+
+			if(!world_tryHoldCollision(def))
+			{
+				tris = renderer_model_loadCollisionASE(def->model, &numTris);
+				world_holdCollision(def, tris, numTris);
+			}
+
+			held[n++] = def;
+		}
+
+	changed = (n != numSimHeld || memcmp(held, simHeld, sizeof(world_chunkDef_t *) * n) != 0);
+
+	for(i = 0; i < numSimHeld; i++)
+		world_dropCollision(simHeld[i]);
+
+	memcpy(simHeld, held, sizeof(world_chunkDef_t *) * n);
+	numSimHeld = n;
+
+	return changed;
+}
+
+/*
+ * world_getCollision
+ * Simulation thread. Triangles of the index'th chunk held by
+ * world_updateCollision, packed 9 floats each. Returns efalse past the
+ * last. Nothing else frees or replaces them while they are held.
+ */
+eboolean world_getCollision(int index, const vec_t **tris, int *numTris)
+{
+	if(index < 0 || index >= numSimHeld)
+		return efalse;
+
+	*tris = simHeld[index]->collisionTris;
+	*numTris = simHeld[index]->numCollisionTris;
+
+	return etrue;
+}
+
+/*
+ * world_printStats
+ */
+void world_printStats()
+{
+	printf("World: %u chunk loads, %u evictions, peak %u resident of %d slots.\n",
+			statLoads, statEvictions, statPeakResident, WORLD_MAX_CHUNKS);
+	printf("World collision: %u chunk triangle sets read, peak %u held at once.\n",
+			statCollisionLoads, statPeakCollision);
+
+	if(useTerrain)
+		renderer_terrain_printStats();
+}
@@ -0,0 +1,27 @@
+/*
+===========================================================================
+File:		world.h
+Author: 	Clinton Freeman
+Created on: Oct 18, 2026
+===========================================================================
+*/
+
+#ifndef WORLD_H_
+#define WORLD_H_
+
+#include "common.h"
+#include "vmath.h"
+
+#define WORLD_MAX_RADIUS 4
+
+void world_init(char *manifest);
+void world_update(const vec3_t position);
+void world_queue(const mat4_t viewMatrix);
+void world_shutdown();
+
+eboolean world_updateCollision(const vec3_t position);
+eboolean world_getCollision(int index, const vec_t **tris, int *numTris);
+
+void world_printStats();
+
+#endif /* WORLD_H_ */